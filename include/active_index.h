@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// обратный индекс документов, ещё не попавших в сегменты. Один поток дописывает вхождения новых документов,
+// пока другие обходят списки терминов через View. Список термина - цепочка узлов по NODE_SIZE вхождений
+// от последнего узла к первому, начало цепочки хранится в хэш-таблице блока. Узлы лежат в блоках
+// фиксированного размера: заполненный блок больше не меняется, а следующий блок вдвое больше
+// и ссылается на предыдущий
+class ActiveIndex {
+private:
+    static constexpr size_t NODE_SIZE = 16; // кол-во вхождений в узле: соседние вхождения термина читаются подряд
+    static constexpr uint32_t NO_NODE = std::numeric_limits<uint32_t>::max();
+
+    // узел списка термина и позиция предыдущего узла того же термина в блоке. Вхождения дописываются,
+    // пока узел читают, поэтому их кол-во атомарно
+    struct Node {
+        std::atomic<uint32_t> size{0};
+        uint32_t next = NO_NODE;
+        uint32_t documents[NODE_SIZE];
+        uint32_t counts[NODE_SIZE];
+    };
+    struct Block {
+        size_t capacity = 0; // кол-во узлов
+        size_t size = 0; // меняется только пишущим потоком
+        std::unique_ptr<Node[]> nodes;
+        // хэш-таблица на 2 * capacity ячеек: id термина в старших 32 битах и позиция его последнего узла
+        // в младших. Ячейки атомарны, так как их читают во время записи
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        std::shared_ptr<const Block> previous;
+
+        explicit Block(size_t block_capacity);
+    };
+
+public:
+    // индекс в момент получения View; остаётся действительным и после изменения или разрушения индекса
+    class View {
+    public:
+        View() = default;
+
+        // вызывает visitor(document, count) для вхождений термина в документы с внутренними id меньше document_end
+        template <class Visitor>
+        void ForEachPosting(uint32_t term_id, uint32_t document_end, Visitor visitor) const;
+
+    private:
+        friend class ActiveIndex;
+
+        std::shared_ptr<const Block> block_;
+    };
+
+    ActiveIndex() = default;
+    ActiveIndex(const ActiveIndex &other);
+    ActiveIndex(ActiveIndex &&other) noexcept = default;
+    ActiveIndex& operator=(const ActiveIndex &other);
+    ActiveIndex& operator=(ActiveIndex &&other) noexcept = default;
+
+    // добавляет вхождение термина в документ; документы добавляются по возрастанию внутренних id
+    void Add(uint32_t document, uint32_t term_id, uint32_t count);
+    // удаляет все вхождения; View, полученные раньше, их по-прежнему видят
+    void Clear(uint32_t end_document);
+    // возвращает id, следующий за последним добавленным документом
+    uint32_t GetEndDocument() const;
+    // возвращает индекс в его текущем состоянии для чтения из других потоков
+    View GetView() const;
+
+private:
+    static constexpr size_t INITIAL_CAPACITY = 1024; // кол-во узлов в первом блоке
+    static constexpr uint64_t EMPTY_SLOT = std::numeric_limits<uint64_t>::max(); // пустая ячейка хэш-таблицы
+
+    std::shared_ptr<Block> block_; // последний блок
+    uint32_t end_document_ = 0;
+
+    // возвращает индекс ячейки термина либо первой пустой ячейки на его пути, а в value - её содержимое.
+    // Узлы, записанные до публикации начала цепочки, видны вместе с ним
+    static size_t FindSlot(const Block &block, uint32_t term_id, uint64_t &value);
+};
+
+template <class Visitor>
+void ActiveIndex::View::ForEachPosting(uint32_t term_id, uint32_t document_end, Visitor visitor) const {
+    for (const Block *block = block_.get(); block != nullptr; block = block->previous.get()) {
+        uint64_t value = EMPTY_SLOT;
+        FindSlot(*block, term_id, value);
+        if (value == EMPTY_SLOT) {
+            continue;
+        }
+        for (uint32_t position = static_cast<uint32_t>(value); position != NO_NODE;) {
+            const Node &node = block->nodes[position];
+            const uint32_t size = node.size.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < size; ++i) {
+                if (node.documents[i] < document_end) {
+                    visitor(node.documents[i], node.counts[i]);
+                }
+            }
+            position = node.next;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#define ALLOCATIONS_CONCAT_INTERNAL(X, Y) X ## Y
+#define ALLOCATIONS_CONCAT(X, Y) ALLOCATIONS_CONCAT_INTERNAL(X, Y)
+#define LOG_ALLOCATIONS(x) LogAllocations ALLOCATIONS_CONCAT(allocationsGuard, __LINE__)(x)
+
+// возвращает кол-во выделений динамической памяти во всех потоках с начала работы программы:
+// глобальные operator new заменены в allocation_counter.cpp и считают каждое выделение
+size_t GetAllocationCount();
+
+// выводит кол-во выделений памяти за время жизни объекта, как LogDuration - время
+class LogAllocations {
+public:
+    explicit LogAllocations(std::string_view log, std::ostream &out = std::cerr)
+        : output_log_(log), out_(&out) {}
+
+    ~LogAllocations() {
+        using namespace std::literals;
+        (*out_) << output_log_ << ": "s << Count() << " allocations"s << std::endl;
+    }
+
+    // возвращает кол-во выделений памяти с создания объекта
+    size_t Count() const {
+        return GetAllocationCount() - start_count_;
+    }
+
+private:
+    const size_t start_count_ = GetAllocationCount();
+    std::string output_log_;
+    std::ostream *out_;
+};
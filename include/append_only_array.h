@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+
+// массив, в конец которого один поток дописывает элементы, пока другие читают уже записанные.
+// При нехватке места элементы копируются в новый буфер вдвое большего размера, а старый буфер живёт, пока
+// им владеют выданные ранее копии (GetBuffer). Дописывание не трогает первые size() элементов, поэтому
+// буфер, полученный через GetBuffer, можно читать в пределах size() на момент получения без блокировок.
+// Элементы, которые меняются на месте во время чтения, должны быть атомарными. Копия массива независима
+template <typename T>
+class AppendOnlyArray {
+public:
+    AppendOnlyArray() = default;
+    AppendOnlyArray(std::initializer_list<T> values);
+    // массив из size элементов, уже лежащих в чужом буфере (например, в отображённом в память файле):
+    // элементы не копируются, а первое дописывание переносит их в новый буфер
+    AppendOnlyArray(std::shared_ptr<T[]> buffer, size_t size);
+    AppendOnlyArray(const AppendOnlyArray &other);
+    AppendOnlyArray(AppendOnlyArray &&other) noexcept = default;
+    AppendOnlyArray& operator=(const AppendOnlyArray &other);
+    AppendOnlyArray& operator=(AppendOnlyArray &&other) noexcept = default;
+
+    void push_back(const T &value);
+    // увеличивает размер массива до size, новые элементы value-инициализируются
+    void resize(size_t size);
+
+    T& operator[](size_t index);
+    const T& operator[](size_t index) const;
+    const T& back() const;
+    T* begin();
+    T* end();
+    const T* begin() const;
+    const T* end() const;
+    size_t size() const;
+    bool empty() const;
+
+    // возвращает текущий буфер во владение
+    std::shared_ptr<const T[]> GetBuffer() const;
+
+private:
+    std::shared_ptr<T[]> buffer_;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+
+    void Reserve(size_t capacity);
+};
+
+template <typename T>
+AppendOnlyArray<T>::AppendOnlyArray(std::initializer_list<T> values) {
+    Reserve(values.size());
+    for (const T &value : values) {
+        push_back(value);
+    }
+}
+
+template <typename T>
+AppendOnlyArray<T>::AppendOnlyArray(std::shared_ptr<T[]> buffer, size_t size)
+    : buffer_(std::move(buffer)), size_(size), capacity_(size) {}
+
+template <typename T>
+AppendOnlyArray<T>::AppendOnlyArray(const AppendOnlyArray &other) {
+    Reserve(other.size_);
+    std::copy(other.begin(), other.end(), buffer_.get());
+    size_ = other.size_;
+}
+
+template <typename T>
+AppendOnlyArray<T>& AppendOnlyArray<T>::operator=(const AppendOnlyArray &other) {
+    if (this != &other) {
+        AppendOnlyArray copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename T>
+void AppendOnlyArray<T>::push_back(const T &value) {
+    if (size_ == capacity_) {
+        Reserve(std::max<size_t>(capacity_ * 2, 8));
+    }
+    buffer_.get()[size_++] = value;
+}
+
+template <typename T>
+void AppendOnlyArray<T>::resize(size_t size) {
+    if (size <= size_) {
+        return;
+    }
+    if (size > capacity_) {
+        Reserve(std::max(capacity_ * 2, size));
+    }
+    std::fill(buffer_.get() + size_, buffer_.get() + size, T{});
+    size_ = size;
+}
+
+template <typename T>
+T& AppendOnlyArray<T>::operator[](size_t index) {
+    return buffer_.get()[index];
+}
+
+template <typename T>
+const T& AppendOnlyArray<T>::operator[](size_t index) const {
+    return buffer_.get()[index];
+}
+
+template <typename T>
+const T& AppendOnlyArray<T>::back() const {
+    return buffer_.get()[size_ - 1];
+}
+
+template <typename T>
+T* AppendOnlyArray<T>::begin() {
+    return buffer_.get();
+}
+
+template <typename T>
+T* AppendOnlyArray<T>::end() {
+    return buffer_.get() + size_;
+}
+
+template <typename T>
+const T* AppendOnlyArray<T>::begin() const {
+    return buffer_.get();
+}
+
+template <typename T>
+const T* AppendOnlyArray<T>::end() const {
+    return buffer_.get() + size_;
+}
+
+template <typename T>
+size_t AppendOnlyArray<T>::size() const {
+    return size_;
+}
+
+template <typename T>
+bool AppendOnlyArray<T>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T>
+std::shared_ptr<const T[]> AppendOnlyArray<T>::GetBuffer() const {
+    return buffer_;
+}
+
+template <typename T>
+void AppendOnlyArray<T>::Reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+        return;
+    }
+    // старый буфер не меняется: его могут читать другие потоки
+    std::shared_ptr<T[]> buffer(new T[capacity]);
+    std::copy(begin(), end(), buffer.get());
+    buffer_ = std::move(buffer);
+    capacity_ = capacity;
+}
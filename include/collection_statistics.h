@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "append_only_array.h"
+
+// статистика коллекции документов: кол-во и длины документов, кол-во документов с каждым термином.
+// Поддерживается сервером при добавлении и удалении документов. Логарифмы кол-ва документов и частот
+// терминов хранятся готовыми, поэтому IDF термина получается одним вычитанием.
+// Частоты терминов публикуются вместе с версиями индекса (View): у каждого термина хранятся два последних
+// значения частоты с номерами версий, с которых они действуют. Сервер переписывает на месте более старое из них,
+// поэтому версия читает свою частоту термина, пока термин не изменился дважды после её публикации,
+// и считает сама только частоты таких терминов. Копия статистики независима
+class CollectionStatistics {
+private:
+    static constexpr uint64_t CHANGING = std::numeric_limits<uint64_t>::max();
+
+    // значение частоты термина: кол-во документов с термином, его логарифм (0 для терминов без документов)
+    // и первая версия индекса, к которой оно относится, или CHANGING, пока значение меняется и не опубликовано
+    struct TermValue {
+        std::atomic<uint64_t> first_version{0};
+        std::atomic<uint32_t> document_freq{0};
+        std::atomic<double> log_document_freq{0};
+    };
+    // два последних значения частоты термина. Меняются, пока их читают, поэтому атомарные; копируются,
+    // когда столбец переезжает в новый буфер
+    struct TermStatistics {
+        TermValue values[2];
+
+        TermStatistics() = default;
+        TermStatistics(const TermStatistics &other);
+        TermStatistics& operator=(const TermStatistics &other);
+
+        // значение с более новой версией (изменяемое, если оно есть)
+        TermValue& Current();
+        const TermValue& Current() const;
+    };
+
+public:
+    // статистика в момент получения View: кол-во и длины документов копируются, а частоты терминов читаются
+    // из общего столбца. Методы можно вызывать из любого числа потоков
+    class View {
+    public:
+        View() = default;
+
+        // возвращает кол-во документов, их суммарную и среднюю длину
+        int GetDocumentCount() const;
+        uint64_t GetTotalLength() const;
+        double GetAverageDocumentLength() const;
+
+        // читает кол-во документов с термином в версии индекса version и его логарифм. Возвращает false,
+        // если значение этой версии уже переписано (термин менялся дважды после её публикации): тогда версия
+        // считает частоту по своим спискам вхождений
+        bool ReadTerm(uint64_t version, uint32_t term_id, uint32_t &document_freq, double &log_document_freq) const;
+
+    private:
+        friend class CollectionStatistics;
+
+        int document_count_ = 0;
+        uint64_t total_length_ = 0;
+        std::shared_ptr<const TermStatistics[]> terms_;
+        size_t term_count_ = 0;
+    };
+
+    CollectionStatistics() = default;
+    CollectionStatistics(const CollectionStatistics &other);
+    CollectionStatistics(CollectionStatistics &&other) noexcept;
+    CollectionStatistics& operator=(const CollectionStatistics &other);
+    CollectionStatistics& operator=(CollectionStatistics &&other) noexcept;
+
+    // возвращает кол-во документов
+    int GetDocumentCount() const;
+    // возвращает суммарную и среднюю длину документов (кол-во слов без стоп-слов)
+    uint64_t GetTotalLength() const;
+    double GetAverageDocumentLength() const;
+    // возвращает кол-во терминов, для которых ведётся статистика
+    size_t GetTermCount() const;
+    // возвращает кол-во документов, содержащих термин
+    uint32_t GetDocumentFreq(uint32_t term_id) const;
+    // возвращает IDF термина: log(кол-во документов / кол-во документов с термином), 0 если таких документов нет
+    double GetInverseDocumentFreq(uint32_t term_id) const;
+
+    // учитывает добавление и удаление документа заданной длины
+    void AddDocument(uint32_t length);
+    void RemoveDocument(uint32_t length);
+    // учитывает добавление document_count документов суммарной длины total_length
+    void AddDocuments(uint32_t document_count, uint64_t total_length);
+    // расширяет статистику до term_count терминов
+    void ResizeTerms(size_t term_count);
+    // учитывает появление термина в документе (или в document_count документах) и исчезновение из
+    // document_count документов; для разных терминов можно вызывать одновременно из разных потоков
+    void AddTermDocument(uint32_t term_id);
+    void AddTermDocuments(uint32_t term_id, uint32_t document_count);
+    void RemoveTermDocuments(uint32_t term_id, uint32_t document_count);
+
+    // отмечает, что частоты терминов, изменённые после прошлой публикации, относятся к версии индекса version
+    // и всем следующим до их изменения
+    void Publish(uint64_t version);
+    View GetView() const;
+
+private:
+    int document_count_ = 0;
+    uint64_t total_length_ = 0;
+    double log_document_count_ = 0;
+    AppendOnlyArray<TermStatistics> terms_; // частоты по id термина
+    // термины, изменённые после прошлой публикации: первые changed_count_ элементов. Термин попадает сюда
+    // один раз до публикации, поэтому места хватает на все термины
+    std::vector<uint32_t> changed_terms_;
+    std::atomic<size_t> changed_count_{0};
+
+    // записывает кол-во документов с термином и его логарифм
+    void SetDocumentFreq(uint32_t term_id, uint32_t document_freq);
+};
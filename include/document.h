@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 struct Document {
     Document() = default;
@@ -23,3 +25,11 @@ enum class DocumentStatus {
     BANNED,
     REMOVED
 };
+
+// документ для пакетного добавления на сервер (SearchServer::AddDocuments)
+struct DocumentInput {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
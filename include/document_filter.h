@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+#include "document.h"
+
+// декларативный фильтр документов для FindTopDocuments: набор статусов, диапазоны рейтинга и id,
+// список разрешённых id. В отличие от произвольного предиката сервер знает, что проверяет фильтр,
+// и отбрасывает документы до подсчёта релевантности, не распаковывая блоки вхождений документов
+// с неподходящими статусами. Фильтр без ограничений пропускает все документы.
+class DocumentFilter {
+public:
+    DocumentFilter() = default;
+    // фильтр по одному статусу
+    explicit DocumentFilter(DocumentStatus status);
+
+    // оставляет документы с одним из статусов
+    DocumentFilter& SetStatuses(std::initializer_list<DocumentStatus> statuses);
+    // оставляет документы с рейтингом из [min_rating, max_rating]
+    DocumentFilter& SetRatingRange(int min_rating, int max_rating);
+    // оставляет документы с id из [min_id, max_id]
+    DocumentFilter& SetIdRange(int min_id, int max_id);
+    // оставляет только документы с перечисленными id
+    DocumentFilter& SetIds(std::vector<int> ids);
+
+    // маска допустимых статусов: бит 1 << status
+    uint32_t GetStatusMask() const;
+    int GetMinRating() const;
+    int GetMaxRating() const;
+    int GetMinId() const;
+    int GetMaxId() const;
+    // true, если задан список разрешённых id
+    bool HasIds() const;
+    // разрешённые id по возрастанию
+    const std::vector<int>& GetIds() const;
+
+    // проверяет документ целиком, позволяет использовать фильтр как обычный предикат
+    bool operator()(int document_id, DocumentStatus status, int rating) const;
+
+private:
+    static constexpr uint32_t ALL_STATUSES = ~0u;
+
+    uint32_t status_mask_ = ALL_STATUSES;
+    int min_rating_ = std::numeric_limits<int>::min();
+    int max_rating_ = std::numeric_limits<int>::max();
+    int min_id_ = std::numeric_limits<int>::min();
+    int max_id_ = std::numeric_limits<int>::max();
+    bool has_ids_ = false;
+    std::vector<int> ids_;
+};
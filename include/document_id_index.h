@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// индекс внешних id документов: сопоставляет document_id внутренний id документа.
+// Записи только добавляются: документ, добавленный повторно после удаления, получает новую запись, а старая
+// остаётся для тех, кто читает индекс в состоянии до удаления. Пока один поток добавляет записи, другие
+// могут искать документы через View
+class DocumentIdIndex {
+private:
+    // хэш-таблица с открытой адресацией, ячейка - document_id в старших 32 битах и внутренний id в младших.
+    // Ячейки атомарны, так как их читают во время записи
+    using Slots = std::shared_ptr<std::atomic<uint64_t>[]>;
+
+public:
+    static constexpr uint32_t NO_DOCUMENT = std::numeric_limits<uint32_t>::max(); // внутренний id отсутствующего документа
+
+    // индекс в момент получения View; остаётся действительным и после изменения или разрушения индекса
+    class View {
+    public:
+        View() = default;
+
+        // возвращает последний внутренний id документа среди меньших document_end или NO_DOCUMENT
+        uint32_t Find(int document_id, uint32_t document_end) const;
+
+    private:
+        friend class DocumentIdIndex;
+
+        std::shared_ptr<const std::atomic<uint64_t>[]> slots_;
+        size_t slot_count_ = 0;
+    };
+
+    DocumentIdIndex();
+    DocumentIdIndex(const DocumentIdIndex &other);
+    DocumentIdIndex(DocumentIdIndex &&other) noexcept = default;
+    DocumentIdIndex& operator=(const DocumentIdIndex &other);
+    DocumentIdIndex& operator=(DocumentIdIndex &&other) noexcept = default;
+
+    // добавляет запись <document_id, internal_id>; internal_id должен быть больше всех добавленных
+    void Add(int document_id, uint32_t internal_id);
+    // возвращает последний внутренний id документа или NO_DOCUMENT
+    uint32_t Find(int document_id) const;
+    // возвращает индекс в его текущем состоянии для чтения из других потоков
+    View GetView() const;
+
+private:
+    static constexpr size_t INITIAL_SLOT_COUNT = 1024; // начальный размер хэш-таблицы (степень двойки)
+    static constexpr uint64_t EMPTY_SLOT = NO_DOCUMENT; // пустая ячейка хэш-таблицы
+
+    Slots slots_;
+    size_t slot_count_ = 0;
+    size_t size_ = 0; // кол-во записей
+
+    static size_t Hash(uint32_t document_id);
+    static uint32_t Find(const std::atomic<uint64_t> *slots, size_t slot_count, int document_id,
+                         uint32_t document_end);
+    // создаёт хэш-таблицу из slot_count пустых ячеек
+    static Slots MakeSlots(size_t slot_count);
+    // кладёт запись в первую пустую ячейку на её пути
+    static void Insert(const Slots &slots, size_t slot_count, uint64_t value);
+};
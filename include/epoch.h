@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// освобождение памяти, которую читают без блокировок, по эпохам (epoch-based reclamation).
+// Читатель на время чтения создаёт EpochGuard и тем закрепляет текущую эпоху. Писатель, убрав объект
+// из общего доступа, начинает новую эпоху и освобождает объект, только когда все закреплённые эпохи новее неё:
+// читатели, пришедшие после этого, убранный объект уже не увидят
+class EpochGuard {
+public:
+    EpochGuard();
+    ~EpochGuard();
+    EpochGuard(const EpochGuard &) = delete;
+    EpochGuard& operator=(const EpochGuard &) = delete;
+
+    struct ThreadRecord;
+
+private:
+    ThreadRecord &record_;
+};
+
+// начинает новую эпоху и возвращает её номер
+uint64_t AdvanceEpoch();
+// возвращает наименьшую эпоху, закреплённую читателями, или UINT64_MAX, если читателей нет
+uint64_t GetOldestPinnedEpoch();
+
+// указатель на неизменяемый объект, который один писатель заменяет, пока другие потоки его читают.
+// Читатель получает объект через Load() под EpochGuard без блокировок и счётчиков ссылок; писатель публикует
+// новый объект через Store(), а старый держит, пока его могут читать. Копия указателя разделяет текущий объект
+template <typename T>
+class EpochPointer {
+public:
+    EpochPointer() = default;
+    explicit EpochPointer(std::shared_ptr<const T> value);
+    EpochPointer(const EpochPointer &other);
+    EpochPointer& operator=(const EpochPointer &other);
+
+    // возвращает текущий объект; указатель действителен, пока жив EpochGuard читающего потока
+    const T* Load() const;
+    // возвращает текущий объект во владение (только для писателя)
+    const std::shared_ptr<const T>& GetShared() const;
+    // публикует новый объект и освобождает заменённые, которые уже никто не читает
+    void Store(std::shared_ptr<const T> value);
+
+private:
+    // заменённый объект и эпоха, после которой его уже не могут прочитать
+    struct Retired {
+        uint64_t epoch;
+        std::shared_ptr<const T> value;
+    };
+
+    std::atomic<const T*> pointer_{nullptr};
+    std::shared_ptr<const T> current_;
+    std::vector<Retired> retired_;
+
+    void Reclaim();
+};
+
+template <typename T>
+EpochPointer<T>::EpochPointer(std::shared_ptr<const T> value) : pointer_(value.get()), current_(std::move(value)) {}
+
+template <typename T>
+EpochPointer<T>::EpochPointer(const EpochPointer &other) : EpochPointer(other.current_) {}
+
+template <typename T>
+EpochPointer<T>& EpochPointer<T>::operator=(const EpochPointer &other) {
+    if (this != &other) {
+        Store(other.current_);
+    }
+    return *this;
+}
+
+template <typename T>
+const T* EpochPointer<T>::Load() const {
+    return pointer_.load();
+}
+
+template <typename T>
+const std::shared_ptr<const T>& EpochPointer<T>::GetShared() const {
+    return current_;
+}
+
+template <typename T>
+void EpochPointer<T>::Store(std::shared_ptr<const T> value) {
+    pointer_.store(value.get());
+    std::swap(current_, value);
+    if (value) {
+        // читатели, закрепившие эпоху после AdvanceEpoch, загрузят уже новый объект
+        retired_.push_back(Retired{AdvanceEpoch(), std::move(value)});
+    }
+    Reclaim();
+}
+
+template <typename T>
+void EpochPointer<T>::Reclaim() {
+    if (retired_.empty()) {
+        return;
+    }
+    const uint64_t oldest = GetOldestPinnedEpoch();
+    size_t kept = 0;
+    for (Retired &retired : retired_) {
+        if (retired.epoch > oldest) {
+            retired_[kept++] = std::move(retired);
+        }
+    }
+    retired_.resize(kept);
+}
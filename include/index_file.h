@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// файл индекса сервера: заголовок с сигнатурой и версией формата, разделы - массивы значений простых типов,
+// каждый с начала, выровненного по SECTION_ALIGNMENT байт, и таблица разделов в конце файла.
+// Файл пишется последовательно через IndexFileWriter, а читается через IndexFile отображением в память:
+// массивы разделов читаются на месте без копирования, страницы файла подгружаются при первом обращении
+// и разделяются между процессами через страничный кэш. Значения хранятся в представлении платформы,
+// поэтому заголовок фиксирует порядок байт и размер size_t, и файл другой платформы не откроется
+
+// разделы файла индекса
+enum class IndexSection : uint32_t {
+    STOP_WORDS, // char: стоп-слова через пробел
+    TERM_WORDS, // char: слова словаря подряд в порядке id
+    TERM_WORD_ENDS, // uint64_t: конец слова с id i в TERM_WORDS
+    TERM_DOCUMENT_FREQS, // uint32_t: кол-во неудалённых документов с термином
+    DOCUMENT_IDS, // int: document_id по внутреннему id
+    DOCUMENT_RATINGS, // int: средний рейтинг
+    DOCUMENT_STATUSES, // DocumentStatus: статус
+    DOCUMENT_LENGTHS, // uint32_t: кол-во слов документа без стоп-слов
+    DOCUMENT_TERM_OFFSETS, // size_t: начало терминов документа в DOCUMENT_TERMS, на один элемент больше документов
+    DOCUMENT_TERMS, // {uint32_t id термина, uint32_t кол-во вхождений}: прямой индекс
+    DOCUMENT_TOMBSTONES, // uint64_t: битовая карта удалённых документов
+    SEGMENTS, // SegmentRecord: сегменты по возрастанию id документов
+    SEGMENT_TERMS, // SegmentTermRecord: списки вхождений сегментов по возрастанию id термина
+    POSTINGS, // упакованные списки вхождений (см. PostingList::Write)
+    REMOVED_DOCUMENTS, // uint32_t: удалённые документы сегментов, вхождения которых ещё лежат в сегментах
+    REMOVED_TERMS, // {uint32_t id термина, uint32_t кол-во}: кол-во таких документов сегментов по терминам
+    PENDING_REMOVALS, // uint32_t: удалённые документы сегментов, ещё не учтённые в REMOVED_TERMS
+    SERVER, // ServerRecord
+    COUNT
+};
+
+// размещение упакованного списка вхождений в разделе POSTINGS
+struct PostingsRecord {
+    uint64_t block_offset = 0; // смещение заголовков блоков в байтах
+    uint64_t data_offset = 0; // смещение упакованных данных в байтах
+    uint32_t block_count = 0;
+    uint32_t data_size = 0; // кол-во слов упакованных данных
+    uint32_t size = 0; // кол-во вхождений
+    float max_term_freq = 0;
+};
+
+// список вхождений термина в сегменте
+struct SegmentTermRecord {
+    uint32_t term_id = 0;
+    uint32_t reserved = 0;
+    PostingsRecord postings;
+};
+
+// замороженный сегмент: диапазон внутренних id, кол-во документов и диапазоны его записей в разделах
+// SEGMENT_TERMS, REMOVED_DOCUMENTS и REMOVED_TERMS
+struct SegmentRecord {
+    uint32_t first_document = 0;
+    uint32_t end_document = 0;
+    uint32_t document_count = 0;
+    uint32_t reserved = 0;
+    uint64_t term_begin = 0;
+    uint64_t term_count = 0;
+    uint64_t removed_document_begin = 0;
+    uint64_t removed_document_count = 0;
+    uint64_t removed_term_begin = 0;
+    uint64_t removed_term_count = 0;
+};
+
+// состояние сервера, не относящееся к отдельным документам и терминам
+struct ServerRecord {
+    uint32_t active_begin = 0; // документы с id от active_begin в сегменты ещё не попали
+    uint32_t segment_document_count = 0;
+    uint64_t log_sequence = 0; // номер последнего изменения сервера, вошедшего в индекс (см. SearchServer::AttachLog)
+};
+
+// запись таблицы разделов файла индекса
+struct IndexSectionEntry {
+    uint32_t id = 0;
+    uint32_t reserved = 0;
+    uint64_t offset = 0; // смещение раздела от начала файла
+    uint64_t size = 0; // размер раздела в байтах
+};
+
+// последовательная запись файла индекса. Разделы пишутся по одному: BeginSection, Write, EndSection.
+// Файл пишется под временным именем и заменяет файл path только в Finish, уже сброшенным на диск
+class IndexFileWriter {
+public:
+    // открывает временный файл рядом с path на запись, выбрасывает исключение, если это не удалось
+    explicit IndexFileWriter(const std::string &path);
+
+    // начинает раздел; каждый раздел пишется один раз
+    void BeginSection(IndexSection section);
+    // дописывает значения в текущий раздел, выравнивая их начало по alignof(T);
+    // возвращает смещение первого значения от начала раздела в байтах
+    template <typename T>
+    uint64_t Write(const T *values, size_t count);
+    void EndSection();
+    // пишет раздел из одного массива
+    template <typename T>
+    void WriteSection(IndexSection section, const T *values, size_t count);
+    // дописывает таблицу разделов и заголовок и переименовывает файл в path
+    void Finish();
+
+private:
+    static constexpr size_t SECTION_ALIGNMENT = 64; // выравнивание начала раздела в файле
+
+    std::string path_;
+    std::ofstream out_;
+    uint64_t position_ = 0; // текущая позиция в файле
+    bool in_section_ = false;
+    std::vector<IndexSectionEntry> sections_;
+
+    // дописывает байты, выравнивая их начало по alignment от начала файла
+    uint64_t WriteBytes(const void *data, size_t size, size_t alignment);
+    void Check();
+};
+
+// файл индекса, отображённый в память только для чтения. Страницы отображения приватны: запись в них
+// не попадает в файл, а копирует страницу. Массивы разделов разделяют владение отображением
+// и остаются действительными после разрушения объекта
+class IndexFile {
+public:
+    // массив значений раздела в отображённой памяти
+    template <typename T>
+    struct Array {
+        std::shared_ptr<T[]> data;
+        size_t size = 0;
+    };
+
+    // открывает и отображает файл; выбрасывает исключение, если файл не читается или не является файлом индекса
+    // этой версии формата для этой платформы
+    explicit IndexFile(const std::string &path);
+
+    // возвращает раздел как массив значений T; выбрасывает исключение, если раздела нет или его размер
+    // и выравнивание не подходят для T
+    template <typename T>
+    Array<T> GetArray(IndexSection section) const;
+    // возвращает раздел как массив байт; выбрасывает исключение, если раздела нет
+    const char* GetSection(IndexSection section, size_t &size) const;
+    // возвращает владение отображением для объектов, читающих его память
+    std::shared_ptr<const void> GetStorage() const;
+
+private:
+    std::shared_ptr<char> storage_;
+    size_t size_ = 0;
+    std::vector<const char*> section_data_; // начало раздела по id, nullptr - раздела нет
+    std::vector<size_t> section_sizes_;
+};
+
+// выбрасывает исключение о повреждённом файле индекса, если condition ложно
+void CheckIndexFile(bool condition);
+
+template <typename T>
+uint64_t IndexFileWriter::Write(const T *values, size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>, "Index file stores trivially copyable values only");
+    return WriteBytes(values, count * sizeof(T), alignof(T));
+}
+
+template <typename T>
+void IndexFileWriter::WriteSection(IndexSection section, const T *values, size_t count) {
+    BeginSection(section);
+    Write(values, count);
+    EndSection();
+}
+
+template <typename T>
+IndexFile::Array<T> IndexFile::GetArray(IndexSection section) const {
+    static_assert(std::is_trivially_copyable_v<T>, "Index file stores trivially copyable values only");
+    size_t size = 0;
+    const char *data = GetSection(section, size);
+    CheckIndexFile(size % sizeof(T) == 0 && reinterpret_cast<uintptr_t>(data) % alignof(T) == 0);
+    // разделы лежат в приватном отображении, которое можно менять, поэтому const снимается без риска
+    char *const begin = storage_.get() + (data - storage_.get());
+    return {std::shared_ptr<T[]>(storage_, reinterpret_cast<T*>(begin)), size / sizeof(T)};
+}
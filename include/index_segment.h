@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "index_file.h"
+#include "posting_list.h"
+
+// сегмент обратного индекса: списки вхождений терминов для документов с внутренними id из
+// [GetFirstDocument(), GetEndDocument()). Сегменты сервера покрывают идущие подряд диапазоны id,
+// поэтому список термина во всём индексе - это его списки в сегментах по порядку.
+// Сегмент строится из набравшихся новых документов и замораживается (Seal), после чего только читается
+// и разделяется между версиями индекса, а соседние замороженные сегменты сливаются в один (Merge)
+class IndexSegment {
+public:
+    explicit IndexSegment(uint32_t first_document = 0);
+
+    // возвращает границы диапазона внутренних id документов сегмента и его размер
+    uint32_t GetFirstDocument() const;
+    uint32_t GetEndDocument() const;
+    uint32_t GetDocumentCount() const;
+    // включает в сегмент документы с внутренними id меньше end_document
+    void ExtendTo(uint32_t end_document);
+
+    // возвращает список вхождений термина или nullptr, если термина в сегменте нет
+    const PostingList* FindPostings(uint32_t term_id) const;
+    PostingList* FindPostings(uint32_t term_id);
+    // возвращает список вхождений термина, создавая пустой при первом обращении
+    PostingList& GetPostings(uint32_t term_id);
+    // вызывает func(term_id, postings) для каждого термина сегмента
+    template <class Func>
+    void ForEachTerm(Func func) const;
+
+    // упаковывает недописанные блоки всех списков, убирает пустые списки и освобождает неиспользуемую память
+    void Seal();
+    // возвращает объём памяти, занимаемой сегментом, в байтах
+    size_t MemoryUsage() const;
+
+    // сливает соседние сегменты, перечисленные по возрастанию id документов, в один замороженный сегмент;
+    // упакованные блоки списков копируются без перепаковки. Вхождения документов, отмеченных в битовой карте
+    // removed (бит i - документ с id первого сегмента + i), в слитый сегмент не попадают
+    static IndexSegment Merge(const std::vector<const IndexSegment*> &segments,
+                              const std::vector<uint64_t> &removed = {});
+
+    // дописывает списки сегмента в текущий раздел writer (раздел POSTINGS) и возвращает их записи
+    std::vector<SegmentTermRecord> Write(IndexFileWriter &writer) const;
+    // создаёт сегмент по записи файла индекса; списки сегмента читают упакованные блоки из отображённого файла
+    // на месте, а сегмент держит отображение. Выбрасывает исключение, если записи сегмента повреждены
+    // или id их терминов не меньше term_count
+    static IndexSegment Map(const SegmentRecord &record, const IndexFile &file, size_t term_count);
+
+private:
+    static constexpr uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+    uint32_t first_document_;
+    uint32_t end_document_;
+    std::vector<uint32_t> term_slots_; // по id термина: позиция его списка в postings_ или NO_SLOT
+    std::vector<uint32_t> slot_terms_; // id термина по позиции списка
+    std::vector<PostingList> postings_;
+    std::shared_ptr<const void> storage_; // отображённый файл индекса, из которого списки читают блоки
+};
+
+// слияние соседних сегментов в фоновом потоке. Входные сегменты только читаются, а результат забирает
+// владелец сегментов и сам решает, можно ли им заменить входные. Копия объекта незавершённого слияния не наследует
+class SegmentMerger {
+public:
+    // результат слияния: входные сегменты, сегмент, который их заменяет, и выброшенные при слиянии документы
+    struct Result {
+        std::vector<std::shared_ptr<const IndexSegment>> inputs;
+        std::shared_ptr<IndexSegment> segment;
+        std::vector<uint64_t> removed;
+    };
+
+    SegmentMerger() = default;
+    SegmentMerger(const SegmentMerger &other);
+    SegmentMerger& operator=(const SegmentMerger &other);
+
+    // true, если слияние запущено и его результат ещё не забран
+    bool IsRunning() const;
+    // запускает слияние сегментов в фоновом потоке, если другое слияние не запущено;
+    // документы из битовой карты removed выбрасываются (см. IndexSegment::Merge)
+    void Start(std::vector<std::shared_ptr<const IndexSegment>> inputs, std::vector<uint64_t> removed = {});
+    // возвращает результат законченного слияния; если wait == true, дожидается окончания запущенного слияния
+    std::optional<Result> Finish(bool wait);
+
+private:
+    std::vector<std::shared_ptr<const IndexSegment>> inputs_;
+    std::vector<uint64_t> removed_;
+    std::future<std::shared_ptr<IndexSegment>> result_;
+};
+
+template <class Func>
+void IndexSegment::ForEachTerm(Func func) const {
+    for (size_t slot = 0; slot < postings_.size(); ++slot) {
+        func(slot_terms_[slot], postings_[slot]);
+    }
+}
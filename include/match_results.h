@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// результаты MatchDocuments в плоских буферах вместо кортежа <слова, статус> на каждый документ:
+// у i-го документа id document_ids[i], статус statuses[i] и слова запроса из документа в алфавитном порядке
+// words[word_offsets[i], word_offsets[i + 1]). string_view слов действительны, пока жив снимок (сервер)
+struct MatchResults {
+    // слова одного документа из общего буфера
+    class Words {
+    public:
+        Words(const std::string_view *begin, const std::string_view *end);
+
+        const std::string_view* begin() const;
+        const std::string_view* end() const;
+        size_t size() const;
+        bool empty() const;
+        std::string_view operator[](size_t i) const;
+
+    private:
+        const std::string_view *begin_;
+        const std::string_view *end_;
+    };
+
+    std::vector<int> document_ids;
+    std::vector<DocumentStatus> statuses;
+    std::vector<size_t> word_offsets = {0};
+    std::vector<std::string_view> words;
+
+    // кол-во документов
+    size_t size() const;
+    bool empty() const;
+    // слова i-го документа
+    Words GetWords(size_t i) const;
+};
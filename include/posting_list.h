@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "index_file.h"
+
+// сжатый список вхождений термина: возрастающие внутренние id документов, кол-во вхождений термина в документ
+// и метка документа - небольшое число (статус документа), по которому фильтруют документы, не обращаясь к ним.
+// Вхождения хранятся блоками по BLOCK_SIZE: id документов в виде разностей соседних id, упакованных
+// минимально необходимым числом бит, кол-ва вхождений и метки упакованы так же (одинаковые метки места не занимают).
+// Последний незаполненный блок хранится в распакованном виде, пока в него дописываются вхождения.
+// Для каждого блока хранится верхняя оценка term_freq его документов и маска встречающихся в нём меток,
+// что позволяет при поиске пропускать блоки, документы из которых не могут попасть в выдачу.
+// Упакованные блоки списка, открытого из файла индекса (Map), читаются на месте из отображённой памяти
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128; // кол-во вхождений в блоке
+    static constexpr uint32_t TAG_COUNT = 8; // метки документов меньше этого значения
+    static constexpr uint32_t ALL_TAGS = (1u << TAG_COUNT) - 1; // маска, пропускающая любые метки
+
+    struct Posting {
+        uint32_t document = 0; // внутренний id документа
+        uint32_t count = 0; // кол-во вхождений термина в документ
+        uint32_t tag = 0; // метка документа
+    };
+
+    // курсор для обхода списка по возрастанию id документов с пропуском блоков без их распаковки.
+    // Курсор видит только вхождения с метками из tag_mask (бит 1 << tag), блоки без таких меток не распаковываются
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList &postings, uint32_t tag_mask = ALL_TAGS);
+
+        // true, если вхождения закончились
+        bool AtEnd() const;
+        // id документа и кол-во вхождений в текущей позиции (курсор не должен быть в конце)
+        uint32_t Document() const;
+        uint32_t Count() const;
+        uint32_t Tag() const;
+        // переходит к следующему вхождению
+        void Next();
+        // переходит к первому вхождению с id документа не меньше document
+        void NextGeq(uint32_t document);
+        // верхняя оценка term_freq в блоке, где мог бы лежать document (не меньше текущего), без распаковки
+        float BlockMaxTermFreq(uint32_t document) const;
+
+    private:
+        const PostingList *postings_;
+        uint32_t tag_mask_;
+        size_t block_ = 0; // текущий блок, blocks_.size() означает недописанный блок
+        size_t position_ = 0; // позиция в текущем блоке
+        size_t size_ = 0; // кол-во вхождений в текущем блоке
+        bool buffered_ = false; // текущий блок лежит в buffer_, а не читается из недописанного блока списка
+        Posting buffer_[BLOCK_SIZE]; // распакованный текущий блок
+
+        const Posting* Data() const;
+        // загружает первый блок, начиная с block, в котором есть вхождения с нужными метками
+        void LoadBlock(size_t block);
+        // оставляет в buffer_ только вхождения с нужными метками
+        void FilterBuffer();
+        // первый блок, начиная с текущего, в котором мог бы лежать document
+        size_t FindBlock(uint32_t document) const;
+    };
+
+    // добавляет вхождение в конец списка, id документа должен быть больше всех уже добавленных
+    void Append(uint32_t document, uint32_t count, uint32_t document_length, uint32_t tag = 0);
+    // дописывает в конец все вхождения other, id документов которого должны быть больше всех уже добавленных.
+    // Полные упакованные блоки other копируются без перепаковки вместе с их оценками term_freq.
+    // Вхождения документов, отмеченных в битовой карте removed (бит i - документ first_document + i),
+    // пропускаются, а блоки с такими документами перепаковываются
+    void Extend(const PostingList &other, const std::vector<uint64_t> &removed = {}, uint32_t first_document = 0);
+    // упаковывает недописанный блок и освобождает неиспользуемую память; в список можно дописывать и дальше
+    void Seal();
+
+    // дописывает упакованные блоки списка в текущий раздел writer (недописанный блок упаковывается в копии)
+    // и возвращает их размещение в разделе
+    PostingsRecord Write(IndexFileWriter &writer) const;
+    // создаёт список, который читает упакованные блоки из раздела section файла индекса на месте, не копируя их;
+    // память раздела должна жить, пока жив список. Изменение списка сначала копирует блоки в его собственную
+    // память. Выбрасывает исключение, если блоки выходят за пределы раздела, их заголовки повреждены или
+    // id документов не возрастают или выходят за пределы [first_document, end_document)
+    static PostingList Map(const PostingsRecord &record, const char *section, size_t section_size,
+                           uint32_t first_document, uint32_t end_document);
+
+    // вызывает func(document, count, tag) для каждого вхождения с меткой из tag_mask, распаковывая по блоку за раз
+    template <typename Func>
+    void ForEach(Func func, uint32_t tag_mask = ALL_TAGS) const;
+
+    // возвращает верхнюю оценку term_freq по всем документам списка
+    float MaxTermFreq() const;
+    // возвращает кол-во документов в списке
+    size_t size() const;
+    bool empty() const;
+    // возвращает кол-во занимаемой списком памяти в байтах (отображённые из файла блоки не считаются)
+    size_t MemoryUsage() const;
+
+private:
+    struct BlockHeader {
+        uint32_t first_document; // id первого документа блока хранится целиком
+        uint32_t last_document; // id последнего документа блока, для поиска нужного блока
+        uint32_t offset; // смещение упакованных данных блока в data_
+        float max_term_freq; // верхняя оценка term_freq документов блока
+        uint8_t size; // кол-во вхождений в блоке
+        uint8_t delta_bits; // бит на разность соседних id
+        uint8_t count_bits; // бит на кол-во вхождений
+        uint8_t tag_bits; // бит на метку
+        uint8_t tag_mask; // маска меток документов блока
+    };
+
+    std::vector<BlockHeader> blocks_; // заголовки упакованных блоков
+    std::vector<uint32_t> data_; // упакованные блоки подряд
+    // заголовки и данные упакованных блоков в отображённом файле индекса; пока они заданы, blocks_ и data_ пусты
+    const BlockHeader *mapped_blocks_ = nullptr;
+    size_t mapped_block_count_ = 0;
+    const uint32_t *mapped_data_ = nullptr;
+    size_t mapped_data_size_ = 0;
+    std::vector<Posting> tail_; // недописанный последний блок
+    float tail_max_term_freq_ = 0; // верхняя оценка term_freq недописанного блока
+    uint32_t tail_tag_mask_ = 0; // маска меток недописанного блока
+    float max_term_freq_ = 0; // верхняя оценка term_freq всего списка
+    size_t size_ = 0;
+
+    // упакованные блоки и их данные, собственные или отображённые
+    const BlockHeader* Blocks() const;
+    size_t BlockCount() const;
+    const uint32_t* PackedData() const;
+    size_t PackedSize() const;
+    // копирует отображённые блоки в собственную память перед изменением списка
+    void Detach();
+    // дописывает вхождение в недописанный блок с заданной верхней оценкой term_freq
+    void AppendPosting(const Posting &posting, float term_freq_bound);
+    // упаковывает недописанный блок в конец data_
+    void PackTail();
+    // упаковывает вхождения в конец out и возвращает заголовок блока
+    static BlockHeader PackBlock(const Posting *postings, size_t size, float max_term_freq,
+                                 std::vector<uint32_t> &out);
+    // распаковывает блок в out (не меньше BLOCK_SIZE элементов), возвращает кол-во вхождений в блоке
+    size_t DecodeBlock(const BlockHeader &header, Posting *out) const;
+    // возвращает кол-во слов data_, занимаемых блоком
+    static size_t PackedWords(const BlockHeader &header);
+    // true, если документ отмечен в битовой карте removed, или хотя бы один документ из [first, last]
+    static bool IsMarked(const std::vector<uint64_t> &removed, uint32_t first_document, uint32_t document);
+    static bool HasMarked(const std::vector<uint64_t> &removed, uint32_t first_document, uint32_t first,
+                          uint32_t last);
+};
+
+template <typename Func>
+void PostingList::ForEach(Func func, uint32_t tag_mask) const {
+    Posting postings[BLOCK_SIZE];
+    const BlockHeader *const blocks = Blocks();
+    for (size_t block = 0; block < BlockCount(); ++block) {
+        const BlockHeader &header = blocks[block];
+        if ((header.tag_mask & tag_mask) == 0) {
+            continue;
+        }
+        const size_t size = DecodeBlock(header, postings);
+        for (size_t i = 0; i < size; ++i) {
+            if ((tag_mask >> postings[i].tag) & 1) {
+                func(postings[i].document, postings[i].count, postings[i].tag);
+            }
+        }
+    }
+    if ((tail_tag_mask_ & tag_mask) != 0) {
+        for (const Posting &posting : tail_) {
+            if ((tag_mask >> posting.tag) & 1) {
+                func(posting.document, posting.count, posting.tag);
+            }
+        }
+    }
+}
@@ -5,6 +5,8 @@
 
 #include "search_server.h"
 
+// выдачи пакета запросов, склеенные в одну последовательность документов без копирования:
+// итератор ходит по выдачам и пропускает пустые
 class VectorWrapper {
 private:
     class BasicIterator {
@@ -14,22 +16,26 @@ private:
         using iterator_category = std::forward_iterator_tag;
         using value_type = Document;
         using difference_type = std::ptrdiff_t;
-        using pointer = value_type*;
-        using reference = value_type&;
+        using pointer = const value_type*;
+        using reference = const value_type&;
 
-        BasicIterator() = delete;
-        BasicIterator(const std::vector<std::vector<Document>> &c);
-        BasicIterator(const std::vector<std::vector<Document>> &c, size_t segment, size_t offset);
+        BasicIterator() = default;
         [[nodiscard]] bool operator==(const BasicIterator& rhs) const noexcept;
         [[nodiscard]] bool operator!=(const BasicIterator& rhs) const noexcept;
-        [[nodiscard]] Document operator*() const noexcept;
+        [[nodiscard]] reference operator*() const noexcept;
+        [[nodiscard]] pointer operator->() const noexcept;
         BasicIterator& operator++() noexcept;
         BasicIterator operator++(int) noexcept;
     private:
+        // указывает на документ offset выдачи segment или, если segment == data->size(), на конец
+        BasicIterator(const std::vector<std::vector<Document>> *data, size_t segment, size_t offset) noexcept;
+
+        // переходит к первой непустой выдаче, начиная с текущей
+        void SkipEmpty() noexcept;
+
+        const std::vector<std::vector<Document>> *data_ = nullptr;
         size_t segment_ = 0;
         size_t offset_ = 0;
-        size_t size_ = 0;
-        const std::vector<std::vector<Document>> &data_;
     };
 public:
     using value_type = Document;
@@ -39,17 +45,26 @@ public:
 
     VectorWrapper(std::vector<std::vector<Document>> &&data);
 
-    [[nodiscard]] Iterator begin() noexcept {
-        return Iterator(data_);
+    [[nodiscard]] Iterator begin() const noexcept {
+        return Iterator(&data_, 0, 0);
     }
-    [[nodiscard]] Iterator end() noexcept {
-        return Iterator(data_, data_.size() - 1, data_.at(data_.size() - 1).size() );
+    [[nodiscard]] Iterator end() const noexcept {
+        return Iterator(&data_, data_.size(), 0);
     }
+    // кол-во документов во всех выдачах
     size_t size() const noexcept {
-        return data_.size();
+        return size_;
+    }
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+    // выдачи по запросам в порядке запросов
+    const std::vector<std::vector<Document>>& GetResults() const noexcept {
+        return data_;
     }
 private:
     std::vector<std::vector<Document>> data_;
+    size_t size_ = 0;
 };
 
 std::vector<std::vector<Document>> ProcessQueries(
@@ -59,3 +74,13 @@ std::vector<std::vector<Document>> ProcessQueries(
 VectorWrapper ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
+
+// ищет документы по пакету запросов и отдаёт выдачу каждого запроса consumer(индекс запроса, std::vector<Document>)
+// по мере готовности, не дожидаясь остальных; consumer не вызывается из нескольких потоков одновременно
+template <class Consumer>
+void ProcessQueriesStreaming(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    Consumer consumer) {
+    search_server.FindTopDocumentsStream(adaptive_execution, queries, std::move(consumer));
+}
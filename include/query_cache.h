@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// кэш разобранных запросов: строка запроса -> отсортированные уникальные id терминов плюс- и минус-слов.
+// Разбор зависит только от стоп-слов, которые у сервера не меняются, и от словаря терминов, который только
+// растёт, поэтому запись хранит размер словаря, по которому запрос разобран, и при другом размере считается
+// устаревшей. Вытесняются давно не использованные запросы (LRU). Кэш разбит на SHARD_COUNT частей
+// со своими блокировками, чтобы потоки, ищущие одновременно, реже ждали друг друга.
+// Копия кэша пуста и не разделяет записи с оригиналом: у копии сервера свой словарь
+class QueryCache {
+private:
+    struct Storage;
+
+public:
+    static constexpr size_t SHARD_COUNT = 16;
+    static constexpr size_t MAX_QUERY_SIZE = 1024; // более длинные запросы не кэшируются
+
+    // кол-во обращений к кэшу, нашедших и не нашедших запрос
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // кэш в момент получения View: видит последующие изменения записей и остаётся действительным
+    // и после разрушения кэша. Методы можно вызывать из любого числа потоков
+    class View {
+    public:
+        View() = default;
+
+        // копирует в plus_terms и minus_terms разбор запроса по словарю из term_count слов и возвращает true,
+        // если такой разбор есть в кэше
+        bool Find(std::string_view raw_query, size_t term_count, std::vector<uint32_t> &plus_terms,
+                  std::vector<uint32_t> &minus_terms) const;
+        // запоминает разбор запроса по словарю из term_count слов
+        void Insert(std::string_view raw_query, size_t term_count, const std::vector<uint32_t> &plus_terms,
+                    const std::vector<uint32_t> &minus_terms) const;
+
+    private:
+        friend class QueryCache;
+
+        std::shared_ptr<Storage> storage_;
+    };
+
+    // кэш на capacity запросов, 0 - кэш выключен
+    explicit QueryCache(size_t capacity);
+    QueryCache(const QueryCache &other);
+    QueryCache(QueryCache &&other) noexcept = default;
+    QueryCache& operator=(const QueryCache &other);
+    QueryCache& operator=(QueryCache &&other) noexcept = default;
+
+    // меняет кол-во хранимых запросов, лишние записи вытесняются
+    void SetCapacity(size_t capacity);
+    size_t GetCapacity() const;
+    // возвращает кол-во обращений к кэшу с его создания
+    Stats GetStats() const;
+    View GetView() const;
+
+private:
+    struct Entry {
+        std::string raw_query;
+        size_t term_count;
+        std::vector<uint32_t> plus_terms;
+        std::vector<uint32_t> minus_terms;
+    };
+    // записи в порядке от недавно использованных к давно не использованным и индекс по строке запроса,
+    // ключи индекса указывают в строки записей
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        Stats stats;
+    };
+    struct Storage {
+        std::array<Shard, SHARD_COUNT> shards;
+        std::atomic<size_t> shard_capacity{0}; // кол-во записей в одной части, меняется во время поиска
+    };
+
+    std::shared_ptr<Storage> storage_;
+    size_t capacity_ = 0;
+
+    static Shard& GetShard(Storage &storage, std::string_view raw_query);
+    // вытесняет из части давно не использованные записи сверх shard_capacity
+    static void Evict(Shard &shard, size_t shard_capacity);
+};
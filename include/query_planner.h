@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// политика выполнения, при которой сервер сам решает для каждого запроса и каждого его этапа, выполнять ли его
+// параллельно и на скольких потоках, по оценке стоимости запроса (QueryPlanner)
+struct AdaptiveExecutionPolicy {};
+inline constexpr AdaptiveExecutionPolicy adaptive_execution{};
+
+// план поиска по запросу с adaptive_execution
+struct QueryPlan {
+    uint64_t cost = 0; // оценка работы: кол-во вхождений слов запроса в сегментах, которые придётся обойти
+    size_t threads = 1; // потоки подсчёта релевантности; 1 - последовательный поиск с отсечением (MaxScore)
+};
+
+// выбирает план запроса по его стоимости: параллельный поиск обходит все вхождения слов, тогда как
+// последовательный отсекает заведомо не попадающие в выдачу документы, а раздача частей потокам стоит
+// десятки микросекунд, поэтому на каждый поток должно приходиться не меньше cost_per_thread вхождений.
+// Отбор лучших документов идёт параллельно, если найдено не меньше selection_size документов на поток.
+// Считает выбранные планы. Копия планировщика - новый планировщик с теми же порогами и пустыми счётчиками
+class QueryPlanner {
+private:
+    struct Storage;
+
+public:
+    static constexpr uint64_t DEFAULT_COST_PER_THREAD = 32768;
+    static constexpr size_t DEFAULT_SELECTION_SIZE = 65536;
+
+    // кол-во запросов, выполненных последовательно и параллельно, сумма потоков параллельных запросов
+    // и кол-во запросов с параллельным отбором лучших документов
+    struct Stats {
+        uint64_t sequential_queries = 0;
+        uint64_t parallel_queries = 0;
+        uint64_t parallel_threads = 0;
+        uint64_t parallel_selections = 0;
+    };
+
+    // планировщик в момент получения View: видит последующие изменения порогов и остаётся действительным
+    // и после разрушения планировщика. Методы можно вызывать из любого числа потоков
+    class View {
+    public:
+        View() = default;
+
+        // план запроса стоимостью cost, не больше чем на max_threads потоков
+        QueryPlan Plan(uint64_t cost, size_t max_threads) const;
+        // кол-во потоков отбора лучших из document_count документов, не больше max_threads
+        size_t PlanSelection(size_t document_count, size_t max_threads) const;
+        // учитывает выполненный план в счётчиках
+        void Record(const QueryPlan &plan, size_t selection_threads) const;
+
+    private:
+        friend class QueryPlanner;
+
+        std::shared_ptr<Storage> storage_;
+    };
+
+    QueryPlanner();
+    QueryPlanner(const QueryPlanner &other);
+    QueryPlanner(QueryPlanner &&other) noexcept = default;
+    QueryPlanner& operator=(const QueryPlanner &other);
+    QueryPlanner& operator=(QueryPlanner &&other) noexcept = default;
+
+    // задаёт пороги параллельного выполнения: вхождений на поток подсчёта и документов на поток отбора
+    void SetThresholds(uint64_t cost_per_thread, size_t selection_size);
+    // возвращает счётчики планов с создания планировщика
+    Stats GetStats() const;
+    View GetView() const;
+
+private:
+    struct Storage {
+        std::atomic<uint64_t> cost_per_thread{DEFAULT_COST_PER_THREAD};
+        std::atomic<size_t> selection_size{DEFAULT_SELECTION_SIZE};
+        std::atomic<uint64_t> sequential_queries{0};
+        std::atomic<uint64_t> parallel_queries{0};
+        std::atomic<uint64_t> parallel_threads{0};
+        std::atomic<uint64_t> parallel_selections{0};
+    };
+
+    std::shared_ptr<Storage> storage_;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "document_filter.h"
+
+// кэш выдачи FindTopDocuments: ключ - разобранный запрос (id терминов плюс- и минус-слов), декларативный фильтр
+// и кол-во документов в выдаче, запись помечена номером версии индекса, по которой посчитана, и в другой версии
+// не используется, поэтому любое изменение сервера делает выдачу устаревшей. Размер кэша ограничен в байтах.
+// Новая запись вытесняет давно не использованные (LRU), только если её ключ запрашивали чаще, чем их (TinyLFU):
+// частоты ключей приблизительно считает count-min sketch, который периодически уменьшает их вдвое, поэтому
+// поток однократных запросов не вымывает из кэша частые. Кэш разбит на SHARD_COUNT частей со своими блокировками.
+// Копия кэша пуста и не разделяет записи с оригиналом: версии копии сервера нумеруются независимо
+class ResultCache {
+private:
+    struct Storage;
+
+public:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    // кол-во обращений, нашедших и не нашедших выдачу, вытесненных записей и записей, не допущенных в кэш
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t rejections = 0;
+    };
+    // ключ выдачи, термины отсортированы
+    struct Key {
+        const std::vector<uint32_t> &plus_terms;
+        const std::vector<uint32_t> &minus_terms;
+        const DocumentFilter &filter;
+        size_t max_count;
+    };
+
+    // кэш в момент получения View: видит последующие изменения записей и остаётся действительным
+    // и после разрушения кэша. Методы можно вызывать из любого числа потоков
+    class View {
+    public:
+        View() = default;
+
+        // копирует в documents выдачу по ключу, посчитанную в версии индекса version, и возвращает true,
+        // если такая выдача есть в кэше
+        bool Find(uint64_t version, const Key &key, std::vector<Document> &documents) const;
+        // запоминает выдачу по ключу, посчитанную в версии индекса version
+        void Insert(uint64_t version, const Key &key, const std::vector<Document> &documents) const;
+
+    private:
+        friend class ResultCache;
+
+        std::shared_ptr<Storage> storage_;
+    };
+
+    // кэш на capacity байт, 0 - кэш выключен
+    explicit ResultCache(size_t capacity);
+    ResultCache(const ResultCache &other);
+    ResultCache(ResultCache &&other) noexcept = default;
+    ResultCache& operator=(const ResultCache &other);
+    ResultCache& operator=(ResultCache &&other) noexcept = default;
+
+    // меняет размер кэша в байтах, лишние записи вытесняются
+    void SetCapacity(size_t capacity);
+    size_t GetCapacity() const;
+    // возвращает счётчики кэша с его создания
+    Stats GetStats() const;
+    View GetView() const;
+
+private:
+    static constexpr size_t SKETCH_ROWS = 4;
+    static constexpr uint8_t SKETCH_MAX_COUNT = 15;
+
+    struct Entry {
+        uint64_t hash;
+        uint64_t version;
+        std::vector<uint32_t> plus_terms;
+        std::vector<uint32_t> minus_terms;
+        DocumentFilter filter;
+        size_t max_count;
+        std::vector<Document> documents;
+        size_t bytes; // память записи, учитываемая в размере кэша
+    };
+    // частоты ключей: SKETCH_ROWS строк по width счётчиков, частота ключа - минимум его счётчиков в строках.
+    // После sample_size увеличений все счётчики уменьшаются вдвое, и старые частоты постепенно забываются
+    struct Sketch {
+        std::vector<uint8_t> counters;
+        size_t width = 0; // степень двойки
+        size_t additions = 0;
+        size_t sample_size = 0;
+
+        void Reset(size_t width);
+        void Add(uint64_t hash);
+        uint8_t Estimate(uint64_t hash) const;
+    };
+    // записи в порядке от недавно использованных к давно не использованным и индекс по хэшу ключа
+    // (у записей с одинаковым хэшем остаётся последняя)
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+        Sketch sketch;
+        Stats stats;
+    };
+    struct Storage {
+        std::array<Shard, SHARD_COUNT> shards;
+        std::atomic<size_t> shard_capacity{0}; // размер одной части в байтах, меняется во время поиска
+    };
+
+    std::shared_ptr<Storage> storage_;
+    size_t capacity_ = 0;
+
+    static uint64_t Hash(const Key &key);
+    static bool IsSameKey(const Entry &entry, const Key &key);
+    static Shard& GetShard(Storage &storage, uint64_t hash);
+    // убирает запись из части
+    static void Erase(Shard &shard, std::list<Entry>::iterator it);
+};
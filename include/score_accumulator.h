@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "scratch_lease.h"
+
+// накапливает релевантность найденных документов по внутренним id документов.
+// Id разбиты на страницы фиксированного размера: страница выделяется при первой записи в неё
+// и остаётся за аккумулятором, поэтому повторные запросы памяти не выделяют.
+class ScoreAccumulator {
+public:
+    static constexpr size_t PAGE_BITS = 12;
+    static constexpr size_t PAGE_SIZE = size_t{1} << PAGE_BITS; // кол-во документов на странице
+
+    // очищает результаты прошлого запроса и готовит аккумулятор для документов с id меньше document_count
+    void Reset(size_t document_count);
+    // прибавляет релевантность документу и отмечает его найденным
+    void Add(uint32_t document, double score);
+    // убирает документ из найденных
+    void Exclude(uint32_t document);
+    // прибавляет накопленное в other на страницах [first_page, last_page); разные диапазоны страниц
+    // можно сливать одновременно из разных потоков
+    void Merge(const ScoreAccumulator &other, size_t first_page, size_t last_page);
+    // возвращает кол-во страниц
+    size_t PageCount() const;
+
+    // вызывает func(document, score) для найденных документов в порядке возрастания id
+    template <typename Func>
+    void ForEach(Func func) const;
+
+private:
+    struct Page {
+        std::array<double, PAGE_SIZE> scores{};
+        std::array<uint64_t, PAGE_SIZE / 64> found{}; // битовая маска найденных документов
+    };
+
+    std::vector<std::unique_ptr<Page>> pages_;
+    std::vector<uint8_t> active_; // страницы, в которые писали с последнего Reset
+
+    Page& Activate(size_t page);
+};
+
+// набор из count аккумуляторов, выдаваемый запросу из пула вызывающего потока (ScratchLease) и возвращаемый
+// в пул при разрушении. Если поток, ожидая свой запрос, начнёт выполнять другой, тот получит отдельный набор.
+class ScoreAccumulatorLease {
+public:
+    explicit ScoreAccumulatorLease(size_t count);
+
+    ScoreAccumulator& operator[](size_t index);
+    size_t size() const;
+
+private:
+    ScratchLease<std::vector<ScoreAccumulator>> accumulators_;
+    size_t count_;
+};
+
+template <typename Func>
+void ScoreAccumulator::ForEach(Func func) const {
+    for (size_t page = 0; page < active_.size(); ++page) {
+        if (!active_[page]) {
+            continue;
+        }
+        const Page &data = *pages_[page];
+        for (size_t word = 0; word < data.found.size(); ++word) {
+            uint64_t bits = data.found[word];
+            for (size_t offset = word * 64; bits != 0; ++offset, bits >>= 1) {
+                if (bits & 1) {
+                    func(static_cast<uint32_t>((page << PAGE_BITS) + offset), data.scores[offset]);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+
+// временный объект, выдаваемый из пула вызывающего потока и возвращаемый в пул при разрушении.
+// Объект не очищается: память, выделенная под его буферы прошлыми владельцами, переиспользуется, поэтому
+// повторные запросы потока памяти не выделяют. Если поток, ожидая свой запрос, начнёт выполнять другой,
+// тот получит из пула отдельный объект
+template <typename Scratch>
+class ScratchLease {
+public:
+    ScratchLease();
+    ~ScratchLease();
+    ScratchLease(const ScratchLease &) = delete;
+    ScratchLease& operator=(const ScratchLease &) = delete;
+
+    Scratch& operator*() const;
+    Scratch* operator->() const;
+
+private:
+    struct Pool {
+        std::deque<Scratch> objects; // deque не перемещает выданные объекты при добавлении новых
+        size_t depth = 0; // кол-во объектов, выданных сейчас
+    };
+    static Pool& ThreadLocalPool();
+
+    Pool &pool_;
+    Scratch &scratch_;
+};
+
+template <typename Scratch>
+ScratchLease<Scratch>::ScratchLease()
+    : pool_(ThreadLocalPool()),
+      scratch_(pool_.depth < pool_.objects.size() ? pool_.objects[pool_.depth] : pool_.objects.emplace_back()) {
+    ++pool_.depth;
+}
+
+template <typename Scratch>
+ScratchLease<Scratch>::~ScratchLease() {
+    --pool_.depth;
+}
+
+template <typename Scratch>
+Scratch& ScratchLease<Scratch>::operator*() const {
+    return scratch_;
+}
+
+template <typename Scratch>
+Scratch* ScratchLease<Scratch>::operator->() const {
+    return &scratch_;
+}
+
+template <typename Scratch>
+typename ScratchLease<Scratch>::Pool& ScratchLease<Scratch>::ThreadLocalPool() {
+    thread_local Pool pool;
+    return pool;
+}
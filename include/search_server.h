@@ -1,69 +1,327 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <exception>
 #include <execution>
+#include <limits>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <numeric>
 #include <set>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-#include "concurrent_map.h"
+#include "active_index.h"
+#include "append_only_array.h"
+#include "collection_statistics.h"
 #include "document.h"
+#include "document_filter.h"
+#include "document_id_index.h"
+#include "epoch.h"
+#include "index_file.h"
+#include "index_segment.h"
+#include "match_results.h"
+#include "posting_list.h"
+#include "query_cache.h"
+#include "query_planner.h"
+#include "result_cache.h"
+#include "score_accumulator.h"
+#include "scratch_lease.h"
+#include "stop_word_set.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
+#include "thread_pool.h"
+#include "write_ahead_log.h"
 
-const int MAX_RESULT_DOCUMENT_COUNT = 5; // кол-во выводимых документов в запросе
-const int MAX_COUNTS = 16; // максимальное кол-во потоков выполенения
+const int MAX_RESULT_DOCUMENT_COUNT = 5; // кол-во выводимых документов в запросе по умолчанию
+const double RELEVANCE_EPSILON = 1e-6; // релевантности, отличающиеся меньше чем на эту величину, считаются равными
+const uint32_t SEGMENT_DOCUMENT_COUNT = 16384; // кол-во документов вне сегментов, по достижении которого они замораживаются
+const size_t SEGMENT_MERGE_FACTOR = 4; // кол-во соседних сегментов одного уровня, которые сливаются в один
+const size_t REMOVAL_BATCH_SIZE = 64; // кол-во удалённых документов, которые учитываются в кол-вах по терминам разом
+const double COMPACTION_REMOVED_SHARE = 0.25; // доля удалённых документов, при которой сегмент перестраивается без них
+const size_t LOG_REPLAY_BATCH_SIZE = 4096; // наибольшее кол-во документов, добавляемых разом при проигрывании журнала
+const size_t QUERY_CACHE_CAPACITY = 4096; // кол-во разобранных запросов, которые сервер хранит по умолчанию
+const size_t BATCH_DECODED_BYTES = 64 << 20; // объём вхождений, распаковываемых пакетом запросов разом, по умолчанию
 
 
 class SearchServer {
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    // термин документа и кол-во его вхождений в документ
+    struct TermCount {
+        uint32_t term_id;
+        uint32_t count;
     };
+    // слова запроса в виде отсортированных уникальных id терминов, слов которых нет в словаре здесь нет
     struct Query {
-        std::set<std::string_view> plus_words;
-        std::set<std::string_view> minus_words;
+        std::vector<uint32_t> plus_terms;
+        std::vector<uint32_t> minus_terms;
+        std::vector<double> inverse_document_freqs; // IDF плюс-слов в версии индекса, по которой идёт поиск
+        // ещё не разложенные по сегментам документы с плюс-словами и без минус-слов и их релевантность
+        std::vector<std::pair<uint32_t, double>> active_documents;
+    };
+    // вхождение плюс-слова в документ вне сегментов: позиция слова в plus_terms
+    struct ActiveTerm {
+        uint32_t document;
+        uint32_t count;
+        size_t term;
+    };
+    // курсор по списку плюс-слова сегмента и максимальный вклад слова в релевантность
+    struct TermCursor {
+        PostingList::Cursor cursor;
+        double inverse_document_freq;
+        double max_score;
+    };
+    // список плюс-слова сегмента, который целиком обходит одна дорожка
+    struct TermPostings {
+        const PostingList *postings;
+        double inverse_document_freq;
+    };
+    // запрос и временные буферы его вычисления. Берётся из пула потока (ScratchLease), буферы только очищаются,
+    // поэтому запросы потока после первого выделяют память лишь под выдачу
+    struct QueryScratch {
+        Query query;
+        std::vector<std::string_view> words;
+        std::vector<uint32_t> document_freqs;
+        std::vector<double> log_document_freqs;
+        std::vector<uint8_t> published_terms; // кол-во документов со словом взято из статистики версии
+        std::vector<ActiveTerm> active_terms;
+        std::vector<uint64_t> allowed_documents; // битовая карта разрешённых фильтром документов
+        std::vector<uint32_t> excluded_documents;
+        std::vector<TermCursor> term_cursors;
+        std::vector<double> upper_bounds;
+        std::vector<TermPostings> term_postings;
+        std::vector<size_t> term_lanes;
+        std::vector<size_t> lane_loads;
+        std::vector<Document> documents;
+    };
+    static constexpr uint64_t NOT_REMOVED = std::numeric_limits<uint64_t>::max();
+    // номер версии индекса, начиная с которой документ удалён. Меняется, пока документ читают, поэтому атомарный;
+    // копируется, когда столбец переезжает в новый буфер
+    struct RemovalVersion {
+        std::atomic<uint64_t> version{NOT_REMOVED};
+
+        RemovalVersion() = default;
+        RemovalVersion(const RemovalVersion &other);
+        RemovalVersion& operator=(const RemovalVersion &other);
+    };
+    // слово битовой карты удалённых документов: бит ставится при удалении и больше не снимается.
+    // Меняется, пока карту читают, поэтому атомарное; копируется, когда карта переезжает в новый буфер
+    struct TombstoneWord {
+        std::atomic<uint64_t> bits{0};
+
+        TombstoneWord() = default;
+        TombstoneWord(const TombstoneWord &other);
+        TombstoneWord& operator=(const TombstoneWord &other);
+    };
+    // замороженный сегмент, кол-во документов в нём, удалённые документы, вхождения которых ещё лежат в сегменте
+    // (по возрастанию id), и кол-во таких документов по терминам (по возрастанию id термина); nullptr - таких нет.
+    // Удалённые документы пропускаются при поиске, пока сегмент не перестроят без них
+    struct SegmentState {
+        std::shared_ptr<const IndexSegment> index;
+        uint32_t document_count = 0;
+        std::shared_ptr<const std::vector<uint32_t>> removed_documents;
+        std::shared_ptr<const std::vector<TermCount>> removed_terms;
+
+        // возвращает кол-во удалённых документов сегмента с термином
+        uint32_t GetRemovedCount(uint32_t term_id) const;
+    };
+    // неизменяемая версия индекса, по которой идёт поиск. Сервер публикует новую версию после каждого изменения;
+    // столбцы документов и прямой индекс версия читает из общих с сервером буферов, в которые сервер только
+    // дописывает, поэтому версия собирается за O(кол-во сегментов)
+    struct IndexVersion : std::enable_shared_from_this<IndexVersion> {
+        uint64_t version = 0; // документы с RemovalVersion не больше version в версии удалены
+        std::shared_ptr<const StopWordSet> stop_words;
+        TermDictionary::View terms;
+        DocumentIdIndex::View internal_ids;
+        std::shared_ptr<const int[]> external_ids;
+        std::shared_ptr<const int[]> ratings;
+        std::shared_ptr<const DocumentStatus[]> statuses;
+        std::shared_ptr<const uint32_t[]> lengths;
+        std::shared_ptr<const RemovalVersion[]> removal_versions;
+        std::shared_ptr<const TombstoneWord[]> tombstones;
+        std::shared_ptr<const TermCount[]> document_terms;
+        std::shared_ptr<const size_t[]> document_term_offsets;
+        uint32_t document_end = 0; // документы версии имеют внутренние id меньше document_end
+        int document_count = 0; // кол-во неудалённых документов
+        double log_document_count = 0; // логарифм document_count для IDF
+        // кол-ва документов с терминами в версии, пока сервер не изменил термин дважды после её публикации
+        CollectionStatistics::View statistics;
+        std::vector<SegmentState> segments;
+        // удалённые документы, ещё не учтённые в статистике и в removed_terms своих сегментов, и кол-во таких
+        // документов по терминам (по возрастанию id термина), которое считается при первом обращении
+        std::vector<uint32_t> pending_removals;
+        mutable std::once_flag pending_terms_flag;
+        mutable std::vector<TermCount> pending_terms;
+        uint32_t active_begin = 0; // документы с id из [active_begin, document_end) ищутся по active_postings
+        ActiveIndex::View active_postings;
+        QueryCache::View query_cache;
+        ResultCache::View result_cache;
+        ThreadPool::View thread_pool;
+        QueryPlanner::View planner;
+        size_t batch_decoded_bytes = BATCH_DECODED_BYTES; // наибольший объём вхождений, распаковываемых пакетом разом
     };
 
-    std::set<std::string, std::less<>> stop_words_; // множество стоп слов
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_; // словарь слов : <слово, <document_id, term_freq>>
-    std::map<int, std::map<std::string_view, double>> document_to_word_;
-    std::map<int, DocumentData> documents_; // словарь документов <document_id, данные>
+    std::shared_ptr<const StopWordSet> stop_words_; // множество стоп слов
+    TermDictionary terms_; // словарь терминов <слово, id термина>
+    // внутренние id документов: документы нумеруются подряд в порядке добавления, id не переиспользуются
+    DocumentIdIndex document_internal_ids_; // <document_id, внутренний id>
+    // данные документов по столбцам, индекс - внутренний id документа (данные удалённых документов остаются)
+    AppendOnlyArray<int> document_external_ids_; // document_id
+    AppendOnlyArray<int> document_ratings_; // средний рейтинг
+    AppendOnlyArray<DocumentStatus> document_statuses_; // статус
+    AppendOnlyArray<uint32_t> document_lengths_; // кол-во слов документа без стоп-слов
+    AppendOnlyArray<RemovalVersion> document_removal_versions_; // версия индекса, в которой документ удалён
+    AppendOnlyArray<TombstoneWord> document_tombstones_; // битовая карта удалённых документов
+    // прямой индекс: термины документа с внутренним id i лежат в document_terms_ по возрастанию id термина
+    // с позиции document_term_offsets_[i] до document_term_offsets_[i + 1]
+    AppendOnlyArray<TermCount> document_terms_;
+    AppendOnlyArray<size_t> document_term_offsets_ = {0};
+    // обратный индекс <id термина : внутренний id документа, кол-во вхождений, статус документа>, разбитый на
+    // неизменяемые сегменты по подряд идущим диапазонам внутренних id. Сегменты разделяются между версиями индекса
+    // и копиями сервера, соседние сегменты одного уровня сливаются в фоне. Документы с id от active_begin_
+    // в сегменты ещё не попали: до заморозки в новый сегмент по набору segment_document_count_ документов
+    // они ищутся по обратному индексу active_postings_, в который только дописываются
+    std::vector<SegmentState> segments_;
+    uint32_t active_begin_ = 0;
+    ActiveIndex active_postings_;
+    // удалённые документы, которые ещё не учтены в кол-вах документов с терминами и в removed_terms своих
+    // сегментов: они учитываются пакетами по REMOVAL_BATCH_SIZE, поэтому удаление не обходит слова документа
+    std::vector<uint32_t> pending_removals_;
+    uint32_t segment_document_count_ = SEGMENT_DOCUMENT_COUNT;
+    double compaction_removed_share_ = COMPACTION_REMOVED_SHARE;
+    size_t batch_decoded_bytes_ = BATCH_DECODED_BYTES;
+    SegmentMerger merger_;
+    CollectionStatistics statistics_; // кол-во документов, их длины, частоты и IDF терминов
     std::set<int> document_ids_; // множество ids документов на сервере
+    uint64_t version_ = 0; // номер последней опубликованной версии индекса
+    EpochPointer<IndexVersion> current_version_; // последняя опубликованная версия индекса
+    // журнал изменений и номер последнего изменения сервера; номер растёт и без журнала и сохраняется в файл индекса,
+    // чтобы при восстановлении пропустить уже вошедшие в индекс записи журнала
+    WriteAheadLog log_;
+    uint64_t log_sequence_ = 0;
+    // буферы слов и терминов AddDocument, переиспользуемые между вызовами
+    std::vector<std::string_view> word_buffer_;
+    std::vector<uint32_t> term_buffer_;
+    QueryCache query_cache_{QUERY_CACHE_CAPACITY}; // разобранные запросы, общие для всех версий индекса сервера
+    ResultCache result_cache_{0}; // выдачи FindTopDocuments по версиям индекса, выключен, пока не задан размер
+    ThreadPool thread_pool_; // потоки параллельных версий методов
+    QueryPlanner planner_; // планы запросов с adaptive_execution
 
     // разбивает строку на слова, разделенные пробелами за вычетом стоп-слов
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
-    // выбрасывает исключение если в слове есть сервисные символы
-    static bool IsNotValidWord(std::string_view word);
+    static std::vector<std::string_view> SplitIntoWordsNoStop(const StopWordSet &stop_words, std::string_view text);
+    // то же, но складывает слова в words, переиспользуя его память
+    static void SplitIntoWordsNoStop(const StopWordSet &stop_words, std::string_view text,
+                                     std::vector<std::string_view> &words);
     // считает средний рейтинг по вектору рейтингов
     static int ComputeAverageRating(const std::vector<int> &ratings);
-    // разделяет строку запроса на плюс и минус слова, выбрасывет исключение если есть некорректные минус-слова
-    Query SplitQueryWords(std::string_view raw_query) const;
-    // находит и возвращает все документы по запросу, соответствующие предикату
-    template <class KeyMapper, class ExecutionPolicy>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy&& policy,
-                                           std::string_view raw_query,
-                                           KeyMapper key_mapper) const;
+    // возвращает внутренний id неудалённого документа или DocumentIdIndex::NO_DOCUMENT
+    uint32_t FindDocument(int document_id) const;
+    // складывает кол-ва документов по терминам из двух упорядоченных по id термина списков
+    static std::vector<TermCount> AddTermCounts(const std::vector<TermCount> &lhs, const std::vector<TermCount> &rhs);
+    // возвращает термины документа internal_id из прямого индекса длины document_terms_size; прямой индекс
+    // открытого файла при открытии проверяется только для документов вне сегментов (см. OpenIndex),
+    // поэтому границы документа проверяются при каждом чтении
+    static std::pair<const TermCount*, const TermCount*> GetDocumentTerms(const TermCount *document_terms,
+                                                                          const size_t *document_term_offsets,
+                                                                          size_t document_terms_size,
+                                                                          uint32_t internal_id);
+    // считает кол-во документов по терминам для списка документов по прямому индексу;
+    // id терминов проверяются по размеру словаря term_count
+    std::vector<TermCount> CountDocumentTerms(const std::vector<uint32_t> &documents) const;
+    static std::vector<TermCount> CountDocumentTerms(const std::vector<uint32_t> &documents,
+                                                     const TermCount *document_terms,
+                                                     const size_t *document_term_offsets,
+                                                     size_t document_terms_size, size_t term_count);
+    // учитывает удалённые документы из pending_removals_ в статистике и в состоянии их сегментов
+    void FoldRemovals();
+    // возвращает битовую карту удалённых документов сегментов [begin, end) от первого документа begin
+    static std::vector<uint64_t> CollectRemoved(std::vector<SegmentState>::const_iterator begin,
+                                                std::vector<SegmentState>::const_iterator end);
+    // возвращает состояние сегмента index, заменившего сегменты [begin, end) без документов из removed
+    SegmentState MakeMergedState(std::vector<SegmentState>::const_iterator begin,
+                                 std::vector<SegmentState>::const_iterator end,
+                                 std::shared_ptr<const IndexSegment> index, const std::vector<uint64_t> &removed) const;
+    // строит замороженный сегмент из неудалённых документов с внутренними id из [first_document, end_document)
+    template <class ExecutionPolicy>
+    std::shared_ptr<IndexSegment> BuildSegment(ExecutionPolicy&& policy, uint32_t first_document,
+                                               uint32_t end_document) const;
+    // замораживает документы, ещё не попавшие в сегменты, в новый сегмент, если их набралось
+    // segment_document_count_ (или если они есть и force == true), а иначе дописывает новые документы
+    // в active_postings_
+    template <class ExecutionPolicy>
+    void SealActiveDocuments(ExecutionPolicy&& policy, bool force = false);
+    // запускает фоновое слияние SEGMENT_MERGE_FACTOR соседних сегментов одного уровня, если такие есть,
+    // или перестройку сегмента, в котором удалено не меньше compaction_removed_share_ документов
+    void ScheduleMerge();
+    // заменяет слитые сегменты результатом фонового слияния, если он готов (или дождавшись его, если wait == true);
+    // результат отбрасывается, если входные сегменты за время слияния изменились
+    void ApplyMerge(bool wait);
+    // публикует текущее состояние сервера как новую версию индекса
+    void Publish();
+    // присваивает изменению следующий номер и дописывает его в журнал, если журнал подключён. Вызывается до
+    // применения изменения: если запись не удалась, исключение выходит из метода, а сервер и номер не меняются
+    void LogChange(LogRecord record);
+    // то же для пакета добавленных документов
+    void LogDocuments(const std::vector<DocumentInput> &documents);
+    // оставляет max_count самых релевантных документов и упорядочивает их, не сортируя весь вектор;
+    // параллельная версия отбирает лучшие документы в каждом из chunk_count кусков вектора (0 - по кол-ву
+    // потоков pool) на потоках pool, а затем лучшие из отобранных
+    template <class ExecutionPolicy>
+    static void SelectTopDocuments(ExecutionPolicy&& policy, const ThreadPool::View &pool,
+                                   std::vector<Document> &documents, size_t max_count, size_t chunk_count = 0);
+    // term_freq по кол-ву вхождений термина и длине документа
+    static double ComputeTermFreq(uint32_t count, uint32_t document_length);
+    // true, если lhs должен стоять в выдаче выше rhs: по убыванию релевантности, затем рейтинга, затем по id
+    static bool IsMoreRelevant(const Document &lhs, const Document &rhs);
 
 public:
+    class Snapshot;
+
     // конструкторы класса SearchServer
     template <class Сontainer>
     explicit SearchServer(const Сontainer &stop_words);
     explicit SearchServer(const std::string &stop_words);
     explicit SearchServer(std::string_view stop_words);
+    // стоп-слова из constexpr-набора: таблица стоп-слов построена при компиляции и не копируется
+    template <size_t N>
+    explicit SearchServer(const StaticStopWords<N> &stop_words);
+    // сервер ссылается на таблицу набора, поэтому временный набор не принимается
+    template <size_t N>
+    explicit SearchServer(const StaticStopWords<N> &&stop_words) = delete;
+
+    // Сервер меняет один поток, остальные потоки могут одновременно с ним искать: методы поиска
+    // (FindTopDocuments, MatchDocument, GetWordFrequencies, GetDocumentCount, GetStatistics, GetDocumentFreq,
+    // GetInverseDocumentFreq, GetSnapshot) без блокировок читают последнюю опубликованную версию индекса.
+    // Остальные методы обращаются к изменяемому состоянию сервера и вызываются только из пишущего потока
 
     // добавляет документ на сервер
     void AddDocument (int document_id, std::string_view document,
                       DocumentStatus status = DocumentStatus::ACTUAL, const std::vector<int> &ratings = {});
 
+    // добавляет пакет документов: документы разбиваются на слова параллельно, а вхождения раскладываются
+    // по терминам одним проходом сортировки подсчётом. Если хотя бы один документ некорректен,
+    // выбрасывается исключение и ни один документ не добавляется
+    template <class ExecutionPolicy>
+    void AddDocuments(ExecutionPolicy&& policy, const std::vector<DocumentInput> &documents);
+    void AddDocuments(const std::vector<DocumentInput> &documents);
+
     // возвращает слова документа и их term-frequency
     std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
 
-    // удаляет документ с заданным id
+    // удаляет документ с заданным id: документ отмечается в битовой карте удалённых, его вхождения остаются
+    // в сегментах и пропускаются при поиске, пока сегмент не перестроят без них (в фоне или методом Compact).
+    // Удаление не обходит слов документа, поэтому параллельная версия работает так же, как последовательная.
+    // Удаление отсутствующего документа ничего не меняет и не публикует новую версию индекса
     template<class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
     void RemoveDocument(int document_id);
@@ -71,203 +329,1481 @@ public:
     // возвращает кол-во документов на сервере
     int GetDocumentCount() const;
 
+    // задаёт кол-во документов, по достижении которого документы, ещё не попавшие в сегменты, замораживаются
+    void SetSegmentDocumentCount(uint32_t document_count);
+    // задаёт долю удалённых документов сегмента, при которой он перестраивается без них в фоне
+    // (по умолчанию COMPACTION_REMOVED_SHARE); при доле больше 1 сегменты перестраивает только Compact
+    void SetCompactionRemovedShare(double share);
+    // возвращает кол-во сегментов индекса, включая изменяемую часть
+    size_t GetSegmentCount() const;
+    // возвращает кол-во удалённых документов, вхождения которых ещё лежат в сегментах
+    size_t GetRemovedDocumentCount() const;
+    // замораживает документы, ещё не попавшие в сегменты, и дожидается окончания всех фоновых слияний
+    // и перестроек сегментов
+    void WaitForMerges();
+    // дожидается фоновых слияний и перестраивает все сегменты с удалёнными документами без их вхождений
+    void Compact();
+
+    // задаёт кол-во разобранных запросов, которые хранит кэш запросов (0 - кэш выключен): повторный запрос
+    // не разбирается заново, пока в словаре не появятся новые слова
+    void SetQueryCacheCapacity(size_t capacity);
+    // возвращает кол-во запросов, найденных и не найденных в кэше разобранных запросов
+    QueryCache::Stats GetQueryCacheStats() const;
+    // задаёт размер кэша выдачи FindTopDocuments в байтах (0 - кэш выключен, по умолчанию). Кэшируется выдача
+    // по статусу и по декларативному фильтру, но не по произвольному предикату; любое изменение сервера
+    // делает закэшированные выдачи устаревшими
+    void SetResultCacheCapacity(size_t capacity);
+    // возвращает кол-во попаданий, промахов, вытеснений и не допущенных в кэш выдач кэша выдачи
+    ResultCache::Stats GetResultCacheStats() const;
+    // задаёт пул потоков, на котором выполняются параллельные версии методов (с политикой, отличной
+    // от execution::seq) и ProcessQueries: кол-во потоков, их закрепление за ядрами и наибольшее кол-во потоков
+    // на один запрос. Вложенные параллельные вызовы делят потоки пула. Поиск, уже идущий на прежнем пуле,
+    // заканчивается на нём
+    void SetThreadPoolOptions(const ThreadPoolOptions &options);
+    const ThreadPoolOptions& GetThreadPoolOptions() const;
+    // задаёт пороги adaptive_execution: кол-во вхождений слов запроса на поток подсчёта релевантности
+    // и кол-во найденных документов на поток отбора лучших (см. QueryPlanner)
+    void SetAdaptiveThresholds(uint64_t cost_per_thread, size_t selection_size);
+    // возвращает кол-во запросов и пакетов запросов, выполненных с adaptive_execution последовательно
+    // и параллельно
+    QueryPlanner::Stats GetQueryPlannerStats() const;
+    // возвращает план, который adaptive_execution выберет для запроса
+    QueryPlan ExplainQuery(std::string_view raw_query) const;
+    // задаёт наибольший объём вхождений в байтах, которые пакетный поиск распаковывает разом (по умолчанию
+    // BATCH_DECODED_BYTES): пакет, общим словам которого нужно больше, ищется по частям
+    void SetBatchDecodedBytes(size_t bytes);
+
+    // сохраняет индекс сервера в файл (формат описан в index_file.h): стоп-слова, словарь, столбцы документов,
+    // прямой индекс и замороженные сегменты. Результат ещё не законченного фонового слияния в файл не попадает
+    void SaveIndex(const std::string &path) const;
+    // открывает индекс, сохранённый SaveIndex, не переиндексируя документы: файл отображается в память,
+    // а столбцы документов, прямой индекс и списки вхождений сегментов читаются из него на месте.
+    // Открытый сервер меняется как обычный: изменения копируют затронутые данные в память процесса,
+    // файл при этом не меняется. Выбрасывает исключение, если файл не читается или повреждён
+    static SearchServer OpenIndex(const std::string &path);
+
+    // подключает журнал изменений (формат описан в write_ahead_log.h): проигрывает записи журнала, ещё не вошедшие
+    // в индекс сервера, и дальше дописывает в журнал каждое изменение (AddDocument, AddDocuments, RemoveDocument,
+    // SetSegmentDocumentCount) до его применения: изменение, которое не удалось записать, не применяется, и метод
+    // выбрасывает исключение. Сервер восстанавливается после сбоя
+    // открытием последнего файла индекса и подключением журнала. Выбрасывает исключение, если журнал не читается
+    // или не продолжает состояние сервера
+    void AttachLog(const std::string &path, LogOptions options = {});
+    // сбрасывает на диск все изменения, записанные в журнал
+    void SyncLog();
+    // сохраняет индекс в файл, как SaveIndex, и очищает журнал: его изменения уже вошли в файл
+    void Checkpoint(const std::string &index_path);
+
+    // возвращает статистику коллекции в текущей версии индекса: кол-во документов и их длины не меняются
+    // с изменениями сервера, а кол-ва документов со словами дают GetDocumentFreq и GetInverseDocumentFreq
+    CollectionStatistics::View GetStatistics() const;
+    // возвращает кол-во документов, содержащих слово, и IDF слова (0, если таких документов нет)
+    int GetDocumentFreq(std::string_view word) const;
+    double GetInverseDocumentFreq(std::string_view word) const;
+
+    // возвращает снимок текущей версии индекса за O(1)
+    Snapshot GetSnapshot() const;
+
     // итераторы по id-s документов в сервере
     std::set<int>::iterator begin() const;
     std::set<int>::iterator end() const;
 
-    // возвращает отсортированный вектор документов по запросу
+    // возвращает отсортированный вектор из max_count самых релевантных документов по запросу. Кроме
+    // execution::seq и execution::par методы поиска принимают adaptive_execution: сервер оценивает стоимость
+    // запроса по кол-ву вхождений его слов и сам выбирает последовательный поиск или кол-во потоков
     template <class KeyMapper, class ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                                           KeyMapper key_mapper) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, KeyMapper key_mapper,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <class KeyMapper>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, KeyMapper key_mapper) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, KeyMapper key_mapper,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // перегружает FindTopDocuments для поиска по декларативному фильтру: фильтр применяется до подсчёта
+    // релевантности, а блоки вхождений документов с неподходящими статусами не распаковываются
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           const DocumentFilter &filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter &filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     // перегружает FindTopDocuments для поиска по статусу
     template <class ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                                            DocumentStatus document_status) const;
-    std::vector<Document> FindTopDocuments(std::string_view raw_query,
-                                            DocumentStatus document_status) const;
+                                            DocumentStatus document_status,
+                                            size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus document_status,
+                                            size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     // перегружает FindTopDocuments для поиска по статусу по умолчанию (ACTUAL)
     template <class ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    // ищет документы по пакету запросов с общим фильтром и возвращает выдачи в порядке запросов. Список вхождений
+    // слова, общего для нескольких запросов пакета, распаковывается один раз, а вклады его документов
+    // раскладываются по запросам с этим словом; запросы без общих слов ищутся по одному. Если хотя бы один запрос
+    // некорректен, исключение выбрасывается до поиска
+    template <class ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(
+            ExecutionPolicy&& policy, const std::vector<std::string> &raw_queries,
+            const DocumentFilter &filter = DocumentFilter(DocumentStatus::ACTUAL),
+            size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    // то же, но не собирает выдачи, а отдаёт выдачу каждого запроса consumer(индекс запроса, std::vector<Document>)
+    // в порядке готовности, как только она посчитана (выдачи из кэша - до начала поиска). consumer вызывается
+    // из потоков поиска, но не более чем одним потоком одновременно
+    template <class ExecutionPolicy, class Consumer>
+    void FindTopDocumentsStream(ExecutionPolicy&& policy, const std::vector<std::string> &raw_queries,
+                                Consumer consumer,
+                                const DocumentFilter &filter = DocumentFilter(DocumentStatus::ACTUAL),
+                                size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
     // возвращает кортеж из общих слов и статуса документа по запросу
     template<class ExecutionPolicy>
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy&& policy,
                                                 std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query,
                                                                             int document_id) const;
+    // то же для многих документов: запрос разбирается один раз, документы проверяются по прямому индексу
+    // параллельно, результаты в порядке document_ids складываются в плоские буферы. Если какого-то документа
+    // нет, исключение выбрасывается до проверки
+    template<class ExecutionPolicy>
+    MatchResults MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                const std::vector<int> &document_ids) const;
+    MatchResults MatchDocuments(std::string_view raw_query, const std::vector<int> &document_ids) const;
+    // то же для всех документов сервера по возрастанию id
+    template<class ExecutionPolicy>
+    MatchResults MatchAllDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
+    MatchResults MatchAllDocuments(std::string_view raw_query) const;
+};
+
+// снимок индекса сервера: видит документы, добавленные и удалённые до его получения, и не меняется вместе
+// с сервером. Снимок получается за O(1), может пережить сервер и читается из любого числа потоков без блокировок.
+// string_view в результатах действительны, пока жив снимок
+class SearchServer::Snapshot {
+public:
+    // то же, что одноимённые методы SearchServer, по версии индекса снимка
+    template <class KeyMapper, class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, KeyMapper key_mapper,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class KeyMapper>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, KeyMapper key_mapper,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           const DocumentFilter &filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter &filter,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           DocumentStatus document_status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus document_status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    template <class ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(
+            ExecutionPolicy&& policy, const std::vector<std::string> &raw_queries,
+            const DocumentFilter &filter = DocumentFilter(DocumentStatus::ACTUAL),
+            size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <class ExecutionPolicy, class Consumer>
+    void FindTopDocumentsStream(ExecutionPolicy&& policy, const std::vector<std::string> &raw_queries,
+                                Consumer consumer,
+                                const DocumentFilter &filter = DocumentFilter(DocumentStatus::ACTUAL),
+                                size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template<class ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy&& policy,
+                                                std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query,
+                                                                            int document_id) const;
+    template<class ExecutionPolicy>
+    MatchResults MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                const std::vector<int> &document_ids) const;
+    MatchResults MatchDocuments(std::string_view raw_query, const std::vector<int> &document_ids) const;
+    template<class ExecutionPolicy>
+    MatchResults MatchAllDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
+    MatchResults MatchAllDocuments(std::string_view raw_query) const;
+
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+    int GetDocumentCount() const;
+    CollectionStatistics::View GetStatistics() const;
+    int GetDocumentFreq(std::string_view word) const;
+    double GetInverseDocumentFreq(std::string_view word) const;
+    QueryPlan ExplainQuery(std::string_view raw_query) const;
+
+private:
+    friend class SearchServer;
+
+    std::shared_ptr<const IndexVersion> owner_; // пуст у снимков, которые сервер создаёт на время одного запроса
+    const IndexVersion *version_;
+
+    explicit Snapshot(std::shared_ptr<const IndexVersion> version);
+    explicit Snapshot(const IndexVersion *version);
+
+    // true, если документ удалён в версии снимка
+    bool IsRemoved(uint32_t internal_id) const;
+    // возвращает внутренний id документа версии снимка или DocumentIdIndex::NO_DOCUMENT
+    uint32_t FindDocument(int document_id) const;
+    // возвращает термин документа или nullptr, если термина в документе нет
+    const TermCount* FindDocumentTerm(uint32_t internal_id, uint32_t term_id) const;
+    // возвращает кол-во ещё не учтённых в сегментах удалённых документов сегментов с термином
+    uint32_t CountPendingRemovals(uint32_t term_id) const;
+    // возвращает кол-во ещё не учтённых в статистике удалённых документов с термином
+    uint32_t GetPendingRemovedCount(uint32_t term_id) const;
+    // возвращает кол-во документов с термином в версии снимка и IDF термина по кол-ву документов с ним
+    uint32_t CountDocumentFreq(uint32_t term_id) const;
+    double ComputeInverseDocumentFreq(uint32_t document_freq) const;
+    // возвращает кол-во документов с термином и его IDF: готовые из статистики версии, а если сервер уже
+    // изменил их, посчитанные по спискам вхождений
+    std::pair<uint32_t, double> GetTermStatistics(uint32_t term_id) const;
+    // разделяет строку запроса на плюс и минус слова в scratch.query,
+    // выбрасывет исключение если есть некорректные минус-слова
+    void SplitQueryWords(std::string_view raw_query, QueryScratch &scratch) const;
+    // считает IDF плюс-слов запроса и релевантность документов, ещё не попавших в сегменты
+    void PrepareQuery(QueryScratch &scratch) const;
+    // возвращает кол-во вхождений плюс- и минус-слов запроса в сегментах: столько обходит параллельный поиск
+    uint64_t EstimateQueryCost(const Query &query) const;
+    // проверяет по прямому индексу документы с внутренними id internal_ids на слова запроса
+    template <class ExecutionPolicy>
+    MatchResults MatchInternalDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                        const std::vector<uint32_t> &internal_ids) const;
+    // строит в bitmap битовую карту внутренних id документов из списка document_id (отсутствующие id пропускаются)
+    void BuildDocumentBitmap(const std::vector<int> &document_ids, std::vector<uint64_t> &bitmap) const;
+    // возвращает предикат (внутренний id, статус) декларативного фильтра без проверки статуса, которую делают
+    // метки вхождений: рейтинг и id проверяются по столбцам документов, список разрешённых id переводится
+    // в битовую карту allowed, которая должна жить, пока используется предикат
+    auto MakeFilterPredicate(const DocumentFilter &filter, std::vector<uint64_t> &allowed) const;
+    // выбирает max_count лучших документов по запросу среди документов со статусами из status_mask (бит 1 << status),
+    // для которых predicate(внутренний id, статус) вернул true; предикат проверяется до подсчёта релевантности
+    template <class DocumentPredicate, class ExecutionPolicy>
+    std::vector<Document> SearchTopDocuments(ExecutionPolicy&& policy, QueryScratch &scratch,
+                                             DocumentPredicate predicate, uint32_t status_mask,
+                                             size_t max_count) const;
+    // находит все документы по запросу, соответствующие предикату, и складывает их в scratch.documents;
+    // параллельная версия считает релевантность не больше чем на max_lanes потоках
+    template <class DocumentPredicate, class ExecutionPolicy>
+    void FindAllDocuments(ExecutionPolicy&& policy, QueryScratch &scratch, DocumentPredicate predicate,
+                          uint32_t status_mask, size_t max_lanes) const;
+    // находит лучшие документы по запросу, обходя документы по порядку и пропуская те,
+    // что по верхним оценкам релевантности уже не могут попасть в выдачу (MaxScore с оценками по блокам)
+    template <class DocumentPredicate>
+    std::vector<Document> FindTopDocumentsPruned(QueryScratch &scratch, DocumentPredicate predicate,
+                                                 uint32_t status_mask, size_t max_count) const;
+    // ищет подготовленные запросы queries[part] пакета, распаковывая списки слов, общих для нескольких из них,
+    // по сегменту за раз, и отдаёт выдачу каждого запроса finish(индекс запроса, std::vector<Document>)
+    template <class DocumentPredicate, class Finish, class ExecutionPolicy>
+    void FindTopDocumentsJointly(ExecutionPolicy&& policy, std::vector<Query> &queries,
+                                 const std::vector<size_t> &part, DocumentPredicate predicate,
+                                 uint32_t status_mask, size_t max_count, Finish finish) const;
 };
 
+inline bool SearchServer::Snapshot::IsRemoved(uint32_t internal_id) const {
+    // версию удаления смотрим, только если документ отмечен в карте: карта плотнее и почти всегда пуста
+    const uint64_t bits = version_->tombstones[internal_id / 64].bits.load(std::memory_order_relaxed);
+    return ((bits >> (internal_id % 64)) & 1) != 0 &&
+           version_->removal_versions[internal_id].version.load(std::memory_order_relaxed) <= version_->version;
+}
+
+inline auto SearchServer::Snapshot::MakeFilterPredicate(const DocumentFilter &filter,
+                                                       std::vector<uint64_t> &allowed) const {
+    const bool check_allowed = filter.HasIds();
+    if (check_allowed) {
+        BuildDocumentBitmap(filter.GetIds(), allowed);
+    }
+    const bool check_rating = filter.GetMinRating() != std::numeric_limits<int>::min() ||
+                              filter.GetMaxRating() != std::numeric_limits<int>::max();
+    const bool check_id = filter.GetMinId() != std::numeric_limits<int>::min() ||
+                          filter.GetMaxId() != std::numeric_limits<int>::max();
+    return [this, &filter, &allowed, check_allowed, check_rating, check_id](uint32_t internal_id, uint32_t) {
+        if (check_allowed && ((allowed[internal_id / 64] >> (internal_id % 64)) & 1) == 0) {
+            return false;
+        }
+        if (check_rating && (version_->ratings[internal_id] < filter.GetMinRating() ||
+                             version_->ratings[internal_id] > filter.GetMaxRating())) {
+            return false;
+        }
+        return !check_id || (version_->external_ids[internal_id] >= filter.GetMinId() &&
+                             version_->external_ids[internal_id] <= filter.GetMaxId());
+    };
+}
+
 void PrintMatchDocumentResult(int document_id, const std::vector<std::string> &words, DocumentStatus status);
 void PrintDocument(const Document &document);
 
-template <class KeyMapper, class ExecutionPolicy>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy,
-                                                     std::string_view raw_query,
-                                                     KeyMapper key_mapper) const {
+template <class DocumentPredicate, class ExecutionPolicy>
+void SearchServer::Snapshot::FindAllDocuments(ExecutionPolicy&& policy, QueryScratch &scratch,
+                                              DocumentPredicate predicate, uint32_t status_mask,
+                                              size_t max_lanes) const {
     using namespace std;
-    ConcurrentMap<int, double> document_to_relevance_par(MAX_COUNTS);
-    Query query = SplitQueryWords(raw_query);
-    const double documents_count = GetDocumentCount();
-
-    // собираем вектор плюс слов
-    std::vector<std::string_view> plus_words(query.plus_words.size());
-    std::transform(query.plus_words.begin(),query.plus_words.end(), plus_words.begin(), [](auto &word) {
-        return word;
+    const Query &query = scratch.query;
+    // слова раскладываются по дорожкам, каждая дорожка копит релевантность в собственный аккумулятор без блокировок;
+    // длинные списки достаются первыми наименее загруженной дорожке
+    // (список слова в каждом сегменте раскладывается отдельно)
+    vector<TermPostings> &records = scratch.term_postings;
+    records.clear();
+    for (const SegmentState &segment : version_->segments) {
+        for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+            const PostingList *postings = segment.index->FindPostings(query.plus_terms[i]);
+            if (postings != nullptr && !postings->empty()) {
+                records.push_back(TermPostings{postings, query.inverse_document_freqs[i]});
+            }
+        }
+    }
+    const ThreadPool::View &pool = version_->thread_pool;
+    size_t lane_count = 1;
+    if constexpr (!is_same_v<decay_t<ExecutionPolicy>, execution::sequenced_policy>) {
+        lane_count = max<size_t>(1, min(records.size(), max_lanes));
+    }
+    sort(records.begin(), records.end(), [](const TermPostings &lhs, const TermPostings &rhs) {
+        return lhs.postings->size() > rhs.postings->size();
     });
+    vector<size_t> &record_lanes = scratch.term_lanes;
+    record_lanes.assign(records.size(), 0);
+    vector<size_t> &lane_loads = scratch.lane_loads;
+    lane_loads.assign(lane_count, 0);
+    for (size_t i = 0; i < records.size(); ++i) {
+        record_lanes[i] = static_cast<size_t>(min_element(lane_loads.begin(), lane_loads.end()) - lane_loads.begin());
+        lane_loads[record_lanes[i]] += records[i].postings->size();
+    }
 
-    for_each(policy, plus_words.begin(), plus_words.end(),
-             [this, &document_to_relevance_par, documents_count, key_mapper](auto &word_view){
-        if (word_to_document_.count(word_view) != 0) { // проходим по всем документам содержащим плюс слова
-            // считаем IDF для слова из запроса
-            const auto &record = word_to_document_.find(word_view)->second;
-            const double inverse_document_freq = log(documents_count /
-                static_cast<double>(record.size()));
-            for (const auto& [document_id, term_freq] : record) { // считаем IDF-TF для документа
-                // добавляем только документы удовлетворяющие предикату
-                const auto &document = documents_.at(document_id);
-                if (key_mapper(document_id, document.status, document.rating)) {
-                    document_to_relevance_par[document_id].ref_to_value += term_freq * inverse_document_freq;
+    ScoreAccumulatorLease accumulators(lane_count);
+    pool.ForEachIndex(policy, lane_count,
+                      [this, &accumulators, &records, &record_lanes, &predicate, status_mask](size_t lane) {
+        ScoreAccumulator &accumulator = accumulators[lane];
+        accumulator.Reset(version_->document_end);
+        for (size_t i = 0; i < records.size(); ++i) {
+            // проходим по всем документам содержащим плюс слово
+            if (record_lanes[i] != lane) {
+                continue;
+            }
+            const double inverse_document_freq = records[i].inverse_document_freq;
+            records[i].postings->ForEach([this, &accumulator, inverse_document_freq, &predicate]
+                           (uint32_t internal_id, uint32_t count, uint32_t status) { // считаем IDF-TF для документа
+                // добавляем только неудалённые документы удовлетворяющие предикату, статус хранится прямо во вхождении
+                if (!IsRemoved(internal_id) && predicate(internal_id, status)) {
+                    accumulator.Add(internal_id, ComputeTermFreq(count, version_->lengths[internal_id]) *
+                                                 inverse_document_freq);
                 }
+            }, status_mask);
+        }
+    });
+
+    // сливаем дорожки в первую: каждая дорожка сливает свой диапазон страниц, поэтому гонки нет
+    ScoreAccumulator &document_to_relevance = accumulators[0];
+    if (lane_count > 1) {
+        const size_t page_count = document_to_relevance.PageCount();
+        const size_t lane_pages = (page_count + lane_count - 1) / lane_count;
+        pool.ForEachIndex(policy, lane_count,
+                          [&accumulators, &document_to_relevance, lane_count, page_count, lane_pages](size_t lane) {
+            const size_t first_page = min(lane * lane_pages, page_count);
+            const size_t last_page = min(first_page + lane_pages, page_count);
+            for (size_t other = 1; other < lane_count; ++other) {
+                document_to_relevance.Merge(accumulators[other], first_page, last_page);
+            }
+        });
+    }
+
+    for (const SegmentState &segment : version_->segments) {
+        for (const uint32_t term_id : query.minus_terms) {
+            // проходим по всем документам содержащим минус-слово и убираем их из выдачи
+            if (const PostingList *postings = segment.index->FindPostings(term_id)) {
+                postings->ForEach([&document_to_relevance](uint32_t internal_id, uint32_t, uint32_t) {
+                    document_to_relevance.Exclude(internal_id);
+                });
             }
         }
+    }
+    // документы вне сегментов уже проверены на минус-слова при подготовке запроса
+    for (const auto &[internal_id, relevance] : query.active_documents) {
+        const uint32_t status = static_cast<uint32_t>(version_->statuses[internal_id]);
+        if (((status_mask >> status) & 1) != 0 && predicate(internal_id, status)) {
+            document_to_relevance.Add(internal_id, relevance);
+        }
+    }
+
+    vector<Document> &matched_documents = scratch.documents;
+    matched_documents.clear();
+    document_to_relevance.ForEach([this, &matched_documents](uint32_t internal_id, double relevance) {
+        // формируем вектор документов на выдачу
+        matched_documents.push_back(Document{version_->external_ids[internal_id], relevance,
+                                             version_->ratings[internal_id]});
     });
+}
+
+template <class DocumentPredicate>
+std::vector<Document> SearchServer::Snapshot::FindTopDocumentsPruned(QueryScratch &scratch, DocumentPredicate predicate,
+                                                                     uint32_t status_mask, size_t max_count) const {
+    using namespace std;
+    const Query &query = scratch.query;
+    // документы сегментов с минус-словами по возрастанию внутреннего id
+    vector<uint32_t> &excluded = scratch.excluded_documents;
+    excluded.clear();
+    for (const SegmentState &segment : version_->segments) {
+        for (const uint32_t term_id : query.minus_terms) {
+            if (const PostingList *postings = segment.index->FindPostings(term_id)) {
+                postings->ForEach([&excluded](uint32_t internal_id, uint32_t, uint32_t) {
+                    excluded.push_back(internal_id);
+                });
+            }
+        }
+    }
+    sort(excluded.begin(), excluded.end());
+    auto next_excluded = excluded.begin();
+
+    // выдача хранится кучей, на вершине которой наименее релевантный документ
+    vector<Document> top_documents;
+    top_documents.reserve(max_count);
+    // пока выдача не заполнена, отсекать нечего; порог взят с запасом на погрешность сравнения релевантностей
+    double threshold = -numeric_limits<double>::infinity();
+    const auto add_document = [this, &top_documents, &threshold, max_count](uint32_t internal_id, double relevance) {
+        const Document result{version_->external_ids[internal_id], relevance, version_->ratings[internal_id]};
+        if (top_documents.size() < max_count) {
+            top_documents.push_back(result);
+            push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        } else if (IsMoreRelevant(result, top_documents.front())) {
+            pop_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+            top_documents.back() = result;
+            push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        }
+        if (top_documents.size() == max_count) {
+            threshold = top_documents.front().relevance - 2 * RELEVANCE_EPSILON;
+        }
+    };
+
+    // курсоры по спискам плюс-слов в порядке возрастания максимального вклада слова в релевантность
+    vector<TermCursor> &terms = scratch.term_cursors;
+    vector<double> &upper_bounds = scratch.upper_bounds;
+    // сегменты покрывают возрастающие диапазоны id, поэтому обходятся по очереди с общими выдачей и порогом,
+    // а максимальные вклады слов берутся по спискам сегмента
+    for (const SegmentState &segment : version_->segments) {
+        if (max_count == 0) {
+            break;
+        }
+        terms.clear();
+        for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+            const PostingList *postings = segment.index->FindPostings(query.plus_terms[i]);
+            if (postings != nullptr && !postings->empty()) {
+                const double inverse_document_freq = query.inverse_document_freqs[i];
+                terms.push_back(TermCursor{PostingList::Cursor(*postings, status_mask), inverse_document_freq,
+                                           inverse_document_freq * static_cast<double>(postings->MaxTermFreq())});
+            }
+        }
+        sort(terms.begin(), terms.end(), [](const TermCursor &lhs, const TermCursor &rhs) {
+            return lhs.max_score < rhs.max_score;
+        });
+        // upper_bounds[i] - сумма максимальных вкладов слов с 0 по i
+        upper_bounds.resize(terms.size());
+        transform_inclusive_scan(terms.begin(), terms.end(), upper_bounds.begin(), plus<>(),
+                                 [](const TermCursor &term) { return term.max_score; });
 
-    map<int, double> document_to_relevance = document_to_relevance_par.BuildOrdinaryMap();
+        size_t first_essential = 0;
+        while (true) {
+            // слова, суммарного вклада которых не хватит для попадания в выдачу, не порождают кандидатов,
+            // кандидаты берутся из остальных (существенных) слов
+            while (first_essential < terms.size() && upper_bounds[first_essential] < threshold) {
+                ++first_essential;
+            }
+            uint32_t candidate = numeric_limits<uint32_t>::max();
+            uint32_t status = 0;
+            bool found = false;
+            for (size_t i = first_essential; i < terms.size(); ++i) {
+                if (!terms[i].cursor.AtEnd() && terms[i].cursor.Document() <= candidate) {
+                    candidate = terms[i].cursor.Document();
+                    status = terms[i].cursor.Tag();
+                    found = true;
+                }
+            }
+            if (!found) {
+                break;
+            }
+
+            const uint32_t length = version_->lengths[candidate];
+            next_excluded = lower_bound(next_excluded, excluded.end(), candidate);
+            const bool accepted = (next_excluded == excluded.end() || *next_excluded != candidate) &&
+                                  !IsRemoved(candidate) && predicate(candidate, status);
 
-    // здесь не параллелим, чтобы не было гонки
-    for_each(query.minus_words.begin(), query.minus_words.end(),
-             [this, &document_to_relevance](auto &word_view){
-        if (word_to_document_.count(word_view) != 0) {
-            // проходим по всем документам содержащим минус-слово
-            for (const auto& [document_id, term_freq] : word_to_document_.find(word_view)->second) {
-                if (document_to_relevance.count(document_id)) {
-                    document_to_relevance.erase(document_id); // если докумет с таким id есть в выдаче - удаляем
+            // вклад существенных слов, курсоры сдвигаются с кандидата в любом случае
+            double relevance = 0;
+            for (size_t i = first_essential; i < terms.size(); ++i) {
+                PostingList::Cursor &cursor = terms[i].cursor;
+                if (!cursor.AtEnd() && cursor.Document() == candidate) {
+                    relevance += ComputeTermFreq(cursor.Count(), length) * terms[i].inverse_document_freq;
+                    cursor.Next();
                 }
             }
+            if (!accepted) {
+                continue;
+            }
+
+            // вклад остальных слов от больших к меньшим, пока документ ещё может попасть в выдачу
+            bool pruned = false;
+            for (size_t i = first_essential; i-- > 0;) {
+                TermCursor &term = terms[i];
+                const double rest_bound = i > 0 ? upper_bounds[i - 1] : 0.0;
+                const double block_bound = term.inverse_document_freq *
+                                           static_cast<double>(term.cursor.BlockMaxTermFreq(candidate));
+                if (relevance + block_bound + rest_bound < threshold) {
+                    pruned = true;
+                    break;
+                }
+                term.cursor.NextGeq(candidate);
+                if (!term.cursor.AtEnd() && term.cursor.Document() == candidate) {
+                    relevance += ComputeTermFreq(term.cursor.Count(), length) * term.inverse_document_freq;
+                }
+            }
+            if (!pruned) {
+                add_document(candidate, relevance);
+            }
         }
-    });
+    }
+    // документы вне сегментов идут после всех сегментов, их релевантность уже посчитана
+    for (const auto &[internal_id, relevance] : query.active_documents) {
+        const uint32_t status = static_cast<uint32_t>(version_->statuses[internal_id]);
+        if (max_count > 0 && relevance >= threshold && ((status_mask >> status) & 1) != 0 &&
+            predicate(internal_id, status)) {
+            add_document(internal_id, relevance);
+        }
+    }
 
-    vector<Document> matched_documents;
-    matched_documents.reserve(document_to_relevance.size());
-    for (const auto& [document_id, relevance] : document_to_relevance) {
-        // формируем вектор документов на выдачу
-        matched_documents.push_back(Document{document_id, relevance, documents_.at(document_id).rating});
+    sort(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    return top_documents;
+}
+
+template <class ExecutionPolicy>
+void SearchServer::SelectTopDocuments(ExecutionPolicy&& policy, const ThreadPool::View &pool,
+                                      std::vector<Document> &documents, size_t max_count, size_t chunk_count) {
+    using namespace std;
+    if constexpr (!is_same_v<decay_t<ExecutionPolicy>, execution::sequenced_policy>) {
+        if (chunk_count == 0) {
+            chunk_count = pool.GetParallelism();
+        }
+        const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+        // если куски не больше выдачи, отбирать в них нечего
+        if (chunk_count > 1 && chunk_size > max_count) {
+            auto chunk_begin = [&documents, chunk_size](size_t chunk) {
+                return documents.begin() + static_cast<ptrdiff_t>(min(chunk * chunk_size, documents.size()));
+            };
+            pool.ForEachIndex(policy, chunk_count, [&chunk_begin, max_count](size_t chunk) {
+                const auto begin = chunk_begin(chunk);
+                const auto end = chunk_begin(chunk + 1);
+                if (static_cast<size_t>(end - begin) > max_count) {
+                    nth_element(begin, begin + static_cast<ptrdiff_t>(max_count), end, IsMoreRelevant);
+                }
+            });
+            // сдвигаем отобранные документы кусков в начало вектора
+            auto selected_end = documents.begin();
+            for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                const auto begin = chunk_begin(chunk);
+                const size_t selected = min(static_cast<size_t>(chunk_begin(chunk + 1) - begin), max_count);
+                selected_end = move(begin, begin + static_cast<ptrdiff_t>(selected), selected_end);
+            }
+            documents.erase(selected_end, documents.end());
+        }
+    }
+    if (documents.size() > max_count) {
+        nth_element(documents.begin(), documents.begin() + static_cast<ptrdiff_t>(max_count), documents.end(),
+                    IsMoreRelevant);
+        documents.resize(max_count);
     }
-    return matched_documents;
+    sort(documents.begin(), documents.end(), IsMoreRelevant);
 }
 
-template <class Сontainer>
-SearchServer::SearchServer(const Сontainer &stop_words) {
+template <class DocumentPredicate, class ExecutionPolicy>
+std::vector<Document> SearchServer::Snapshot::SearchTopDocuments(ExecutionPolicy&& policy, QueryScratch &scratch,
+                                                                 DocumentPredicate predicate, uint32_t status_mask,
+                                                                 size_t max_count) const {
     using namespace std;
-    for (string_view stop_word: stop_words) {
-        if (IsNotValidWord(stop_word)) {
-            throw invalid_argument("Document contain service symbols");
+    PrepareQuery(scratch);
+    const ThreadPool::View &pool = version_->thread_pool;
+    vector<Document> &matched_documents = scratch.documents;
+    // последовательная версия обходит документы по порядку и отсекает заведомо не попадающие в выдачу,
+    // параллельная считает релевантность всех найденных документов
+    if constexpr (is_same_v<decay_t<ExecutionPolicy>, execution::sequenced_policy>) {
+        return FindTopDocumentsPruned(scratch, predicate, status_mask, max_count);
+    } else if constexpr (is_same_v<decay_t<ExecutionPolicy>, AdaptiveExecutionPolicy>) {
+        // план выбирается по стоимости запроса, а кол-во потоков отбора - по кол-ву найденных документов
+        const QueryPlan plan = version_->planner.Plan(EstimateQueryCost(scratch.query), pool.GetParallelism());
+        if (plan.threads == 1) {
+            version_->planner.Record(plan, 1);
+            return FindTopDocumentsPruned(scratch, predicate, status_mask, max_count);
         }
-        if (!stop_word.empty()) {
-            stop_words_.insert({stop_word.data(), stop_word.size()});
+        FindAllDocuments(execution::par, scratch, predicate, status_mask, plan.threads);
+        const size_t selection_threads = version_->planner.PlanSelection(matched_documents.size(),
+                                                                         pool.GetParallelism());
+        version_->planner.Record(plan, selection_threads);
+        if (selection_threads == 1) {
+            SelectTopDocuments(execution::seq, pool, matched_documents, max_count);
+        } else {
+            SelectTopDocuments(execution::par, pool, matched_documents, max_count, selection_threads);
         }
+        return vector<Document>(matched_documents.begin(), matched_documents.end());
+    } else {
+        FindAllDocuments(policy, scratch, predicate, status_mask, pool.GetParallelism());
+        //оставляем только max_count первых результатов
+        SelectTopDocuments(policy, pool, matched_documents, max_count);
+        return vector<Document>(matched_documents.begin(), matched_documents.end());
     }
 }
 
 template <class KeyMapper, class ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                                                     KeyMapper key_mapper) const {
-    using namespace std;
-    vector<Document> matched_documents = FindAllDocuments(policy, raw_query, key_mapper);
+std::vector<Document> SearchServer::Snapshot::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                               KeyMapper key_mapper, size_t max_count) const {
+    ScratchLease<QueryScratch> scratch;
+    SplitQueryWords(raw_query, *scratch);
+    // про произвольный предикат ничего не известно, поэтому он проверяется для документов с любым статусом
+    return SearchTopDocuments(policy, *scratch, [this, key_mapper](uint32_t internal_id, uint32_t status) {
+        return key_mapper(version_->external_ids[internal_id], static_cast<DocumentStatus>(status),
+                          version_->ratings[internal_id]);
+    }, PostingList::ALL_TAGS, max_count);
+}
 
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs) {
-        return rhs < lhs;});
-    //оставляем только MAX_RESULT_DOCUMENT_COUNT первых результатов
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::Snapshot::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                               const DocumentFilter &filter, size_t max_count) const {
+    ScratchLease<QueryScratch> scratch;
+    SplitQueryWords(raw_query, *scratch);
+    const uint32_t status_mask = filter.GetStatusMask() & PostingList::ALL_TAGS;
+    if (status_mask == 0 || filter.GetMinRating() > filter.GetMaxRating() || filter.GetMinId() > filter.GetMaxId()) {
+        return {};
     }
-    return matched_documents;
+    // выдача того же запроса с тем же фильтром берётся из кэша, пока не опубликована новая версия индекса
+    const ResultCache::Key key{scratch->query.plus_terms, scratch->query.minus_terms, filter, max_count};
+    std::vector<Document> documents;
+    if (version_->result_cache.Find(version_->version, key, documents)) {
+        return documents;
+    }
+    documents = SearchTopDocuments(policy, *scratch, MakeFilterPredicate(filter, scratch->allowed_documents),
+                                   status_mask, max_count);
+    version_->result_cache.Insert(version_->version, key, documents);
+    return documents;
 }
 
 template <class KeyMapper>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
-                                                     KeyMapper key_mapper) const {
-    return FindTopDocuments(std::execution::seq, raw_query, key_mapper);
+std::vector<Document> SearchServer::Snapshot::FindTopDocuments(std::string_view raw_query,
+                                                               KeyMapper key_mapper, size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, key_mapper, max_count);
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::Snapshot::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                               DocumentStatus document_status,
+                                                               size_t max_count) const {
+    return FindTopDocuments(policy, raw_query, DocumentFilter(document_status), max_count);
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::Snapshot::FindTopDocuments(ExecutionPolicy&& policy,
+                                                               std::string_view raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <class ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::Snapshot::FindTopDocumentsBatch(
+        ExecutionPolicy&& policy, const std::vector<std::string> &raw_queries, const DocumentFilter &filter,
+        size_t max_count) const {
+    std::vector<std::vector<Document>> results(raw_queries.size());
+    FindTopDocumentsStream(policy, raw_queries, [&results](size_t i, std::vector<Document> documents) {
+        results[i] = std::move(documents);
+    }, filter, max_count);
+    return results;
+}
+
+template <class ExecutionPolicy, class Consumer>
+void SearchServer::Snapshot::FindTopDocumentsStream(ExecutionPolicy&& policy,
+                                                    const std::vector<std::string> &raw_queries, Consumer consumer,
+                                                    const DocumentFilter &filter, size_t max_count) const {
+    using namespace std;
+    if constexpr (is_same_v<decay_t<ExecutionPolicy>, AdaptiveExecutionPolicy>) {
+        // стоимость пакета - сумма стоимостей его запросов, повторный разбор берётся из кэша запросов
+        uint64_t cost = 0;
+        {
+            ScratchLease<QueryScratch> scratch;
+            for (const string &raw_query : raw_queries) {
+                SplitQueryWords(raw_query, *scratch);
+                cost += EstimateQueryCost(scratch->query);
+            }
+        }
+        const QueryPlan plan = version_->planner.Plan(cost, version_->thread_pool.GetParallelism());
+        version_->planner.Record(plan, 1);
+        if (plan.threads == 1) {
+            FindTopDocumentsStream(execution::seq, raw_queries, consumer, filter, max_count);
+        } else {
+            FindTopDocumentsStream(execution::par, raw_queries, consumer, filter, max_count);
+        }
+        return;
+    }
+    // запросы разбираются по очереди, чтобы исключение некорректного запроса дошло до вызывающего
+    vector<Query> queries(raw_queries.size());
+    {
+        ScratchLease<QueryScratch> scratch;
+        for (size_t i = 0; i < raw_queries.size(); ++i) {
+            SplitQueryWords(raw_queries[i], *scratch);
+            queries[i] = scratch->query;
+        }
+    }
+    // выдачи отдаются по одной, одинаковые запросы получают копии выдачи
+    mutex consumer_mutex;
+    const auto deliver = [&consumer, &consumer_mutex](size_t i, vector<Document> documents) {
+        const lock_guard lock(consumer_mutex);
+        consumer(i, move(documents));
+    };
+    const uint32_t status_mask = filter.GetStatusMask() & PostingList::ALL_TAGS;
+    if (status_mask == 0 || filter.GetMinRating() > filter.GetMaxRating() || filter.GetMinId() > filter.GetMaxId()) {
+        for (size_t i = 0; i < raw_queries.size(); ++i) {
+            deliver(i, {});
+        }
+        return;
+    }
+    // одинаковые после разбора запросы ищутся один раз: первый такой же в порядке сортировки запоминает остальные
+    const auto is_less = [&queries](size_t lhs, size_t rhs) {
+        return tie(queries[lhs].plus_terms, queries[lhs].minus_terms) <
+               tie(queries[rhs].plus_terms, queries[rhs].minus_terms);
+    };
+    vector<size_t> order(queries.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), is_less);
+    vector<vector<size_t>> duplicates(queries.size());
+    const auto deliver_all = [&deliver, &duplicates](size_t i, vector<Document> documents) {
+        for (const size_t duplicate : duplicates[i]) {
+            deliver(duplicate, documents);
+        }
+        deliver(i, move(documents));
+    };
+    // ищутся только запросы, выдачи которых нет в кэше, выдачи из кэша отдаются сразу
+    vector<size_t> pending;
+    for (size_t k = 0, representative = 0; k < order.size(); ++k) {
+        const size_t i = order[k];
+        if (k > 0 && !is_less(order[k - 1], i)) {
+            duplicates[representative].push_back(i);
+            continue;
+        }
+        representative = i;
+        pending.push_back(i);
+    }
+    pending.erase(remove_if(pending.begin(), pending.end(), [this, &queries, &filter, max_count,
+                                                             &deliver_all](size_t i) {
+        const ResultCache::Key key{queries[i].plus_terms, queries[i].minus_terms, filter, max_count};
+        vector<Document> documents;
+        if (!version_->result_cache.Find(version_->version, key, documents)) {
+            return false;
+        }
+        deliver_all(i, move(documents));
+        return true;
+    }), pending.end());
+    const ThreadPool::View &pool = version_->thread_pool;
+    pool.ForEach(policy, pending.begin(), pending.end(), [this, &queries](size_t i) {
+        ScratchLease<QueryScratch> scratch;
+        swap(scratch->query, queries[i]);
+        PrepareQuery(*scratch);
+        swap(scratch->query, queries[i]);
+    });
+
+    vector<uint64_t> allowed;
+    const auto predicate = MakeFilterPredicate(filter, allowed);
+    const auto finish = [this, &queries, &deliver_all, &filter, max_count](size_t i, vector<Document> documents) {
+        const ResultCache::Key key{queries[i].plus_terms, queries[i].minus_terms, filter, max_count};
+        version_->result_cache.Insert(version_->version, key, documents);
+        deliver_all(i, move(documents));
+    };
+    // распакованные списки общих слов части пакета занимают не больше batch_decoded_bytes: пакет делится
+    // на части по объёму списков слов, становящихся общими. Списки распаковываются по сегменту в буферы,
+    // переиспользуемые от сегмента к сегменту, поэтому слово занимает столько, сколько его самый длинный список
+    // в одном сегменте
+    const auto decoded_bytes = [this](uint32_t term_id, size_t posting_bytes) {
+        size_t size = 0;
+        for (const SegmentState &segment : version_->segments) {
+            if (const PostingList *postings = segment.index->FindPostings(term_id)) {
+                size = max(size, postings->size());
+            }
+        }
+        return size * posting_bytes;
+    };
+    vector<size_t> part;
+    map<uint32_t, size_t> part_plus_terms; // кол-во запросов части со словом
+    map<uint32_t, size_t> part_minus_terms;
+    size_t part_bytes = 0;
+    const auto added_bytes = [&part_plus_terms, &part_minus_terms, &decoded_bytes](const Query &query) {
+        size_t size = 0;
+        for (const uint32_t term_id : query.plus_terms) {
+            const auto it = part_plus_terms.find(term_id);
+            if (it != part_plus_terms.end() && it->second == 1) {
+                size += decoded_bytes(term_id, sizeof(pair<uint32_t, double>));
+            }
+        }
+        for (const uint32_t term_id : query.minus_terms) {
+            const auto it = part_minus_terms.find(term_id);
+            if (it != part_minus_terms.end() && it->second == 1) {
+                size += decoded_bytes(term_id, sizeof(uint32_t));
+            }
+        }
+        return size;
+    };
+    for (const size_t i : pending) {
+        size_t query_bytes = added_bytes(queries[i]);
+        if (!part.empty() && part_bytes + query_bytes > version_->batch_decoded_bytes) {
+            FindTopDocumentsJointly(policy, queries, part, predicate, status_mask, max_count, finish);
+            part.clear();
+            part_plus_terms.clear();
+            part_minus_terms.clear();
+            part_bytes = 0;
+            query_bytes = 0;
+        }
+        part.push_back(i);
+        for (const uint32_t term_id : queries[i].plus_terms) {
+            ++part_plus_terms[term_id];
+        }
+        for (const uint32_t term_id : queries[i].minus_terms) {
+            ++part_minus_terms[term_id];
+        }
+        part_bytes += query_bytes;
+    }
+    FindTopDocumentsJointly(policy, queries, part, predicate, status_mask, max_count, finish);
+}
+
+template <class DocumentPredicate, class Finish, class ExecutionPolicy>
+void SearchServer::Snapshot::FindTopDocumentsJointly(ExecutionPolicy&& policy, std::vector<Query> &queries,
+                                                     const std::vector<size_t> &part, DocumentPredicate predicate,
+                                                     uint32_t status_mask, size_t max_count, Finish finish) const {
+    using namespace std;
+    // общие слова части - те, что встречаются хотя бы в двух её запросах (плюс- и минус-слова отдельно)
+    const auto find_shared = [&queries, &part](vector<uint32_t> Query::*terms_of) {
+        vector<uint32_t> terms;
+        for (const size_t i : part) {
+            terms.insert(terms.end(), (queries[i].*terms_of).begin(), (queries[i].*terms_of).end());
+        }
+        sort(terms.begin(), terms.end());
+        vector<uint32_t> shared;
+        for (auto it = terms.begin(); it != terms.end();) {
+            const auto next = upper_bound(it, terms.end(), *it);
+            if (next - it > 1) {
+                shared.push_back(*it);
+            }
+            it = next;
+        }
+        return shared;
+    };
+    const vector<uint32_t> plus_terms = find_shared(&Query::plus_terms);
+    const vector<uint32_t> minus_terms = find_shared(&Query::minus_terms);
+    const auto find_term = [](const vector<uint32_t> &terms, uint32_t term_id) {
+        const auto it = lower_bound(terms.begin(), terms.end(), term_id);
+        return it != terms.end() && *it == term_id ? static_cast<size_t>(it - terms.begin()) : terms.size();
+    };
+
+    // запросы без общих слов ищутся по одному с отсечением, как FindTopDocuments
+    vector<size_t> joint;
+    vector<size_t> single;
+    for (const size_t i : part) {
+        const Query &query = queries[i];
+        const bool shares = any_of(query.plus_terms.begin(), query.plus_terms.end(), [&plus_terms](uint32_t term_id) {
+            return binary_search(plus_terms.begin(), plus_terms.end(), term_id);
+        }) || any_of(query.minus_terms.begin(), query.minus_terms.end(), [&minus_terms](uint32_t term_id) {
+            return binary_search(minus_terms.begin(), minus_terms.end(), term_id);
+        });
+        (shares ? joint : single).push_back(i);
+    }
+    const ThreadPool::View &pool = version_->thread_pool;
+    pool.ForEach(policy, single.begin(), single.end(),
+                 [this, &queries, &predicate, &finish, status_mask, max_count](size_t i) {
+        ScratchLease<QueryScratch> scratch;
+        swap(scratch->query, queries[i]);
+        vector<Document> documents = FindTopDocumentsPruned(*scratch, predicate, status_mask, max_count);
+        swap(scratch->query, queries[i]);
+        finish(i, move(documents));
+    });
+    if (joint.empty()) {
+        return;
+    }
+
+    // сегменты покрывают непересекающиеся диапазоны id, поэтому обходятся по одному: списки общих слов сегмента
+    // распаковываются (по списку плюс-слова - документы, прошедшие фильтр, и доля слова в них, по списку
+    // минус-слова - только документы), вклады раскладываются по аккумуляторам запросов, лучшие документы сегмента
+    // переходят в выдачи запросов, а буферы распакованного переиспользуются следующим сегментом. Выдача запроса
+    // отдаётся сразу после последнего сегмента с его плюс-словами, не дожидаясь остальных сегментов
+    const vector<SegmentState> &segments = version_->segments;
+    vector<size_t> segment_ends(joint.size(), 0);
+    for (size_t k = 0; k < joint.size(); ++k) {
+        const Query &query = queries[joint[k]];
+        for (size_t s = segments.size(); s > 0 && segment_ends[k] == 0; --s) {
+            if (any_of(query.plus_terms.begin(), query.plus_terms.end(), [&segments, s](uint32_t term_id) {
+                return segments[s - 1].index->FindPostings(term_id) != nullptr;
+            })) {
+                segment_ends[k] = s;
+            }
+        }
+    }
+    vector<vector<Document>> top_documents(joint.size());
+    // документы вне сегментов уже проверены на минус-слова при подготовке запроса
+    const auto finish_joint = [this, &queries, &joint, &top_documents, &predicate, &finish, status_mask,
+                               max_count](size_t k) {
+        vector<Document> &documents = top_documents[k];
+        for (const auto &[internal_id, relevance] : queries[joint[k]].active_documents) {
+            const uint32_t status = static_cast<uint32_t>(version_->statuses[internal_id]);
+            if (((status_mask >> status) & 1) != 0 && predicate(internal_id, status)) {
+                documents.push_back(Document{version_->external_ids[internal_id], relevance,
+                                             version_->ratings[internal_id]});
+            }
+        }
+        SelectTopDocuments(execution::seq, version_->thread_pool, documents, max_count);
+        finish(joint[k], move(documents));
+    };
+    pool.ForEachIndex(policy, joint.size(), [&segment_ends, &finish_joint](size_t k) {
+        if (segment_ends[k] == 0) {
+            finish_joint(k);
+        }
+    });
+    const size_t segment_end = *max_element(segment_ends.begin(), segment_ends.end());
+
+    vector<vector<pair<uint32_t, double>>> plus_postings(plus_terms.size());
+    vector<vector<uint32_t>> minus_postings(minus_terms.size());
+    for (size_t s = 0; s < segment_end; ++s) {
+        const SegmentState &segment = segments[s];
+        pool.ForEachIndex(policy, plus_terms.size() + minus_terms.size(),
+                          [this, &segment, &plus_terms, &minus_terms, &plus_postings, &minus_postings, &predicate,
+                           status_mask](size_t index) {
+            if (index < plus_terms.size()) {
+                auto &documents = plus_postings[index];
+                documents.clear();
+                if (const PostingList *postings = segment.index->FindPostings(plus_terms[index])) {
+                    postings->ForEach([this, &documents, &predicate](uint32_t internal_id, uint32_t count,
+                                                                      uint32_t status) {
+                        if (!IsRemoved(internal_id) && predicate(internal_id, status)) {
+                            documents.emplace_back(internal_id,
+                                                   ComputeTermFreq(count, version_->lengths[internal_id]));
+                        }
+                    }, status_mask);
+                }
+            } else {
+                auto &documents = minus_postings[index - plus_terms.size()];
+                documents.clear();
+                if (const PostingList *postings = segment.index->FindPostings(minus_terms[index - plus_terms.size()])) {
+                    postings->ForEach([&documents](uint32_t internal_id, uint32_t, uint32_t) {
+                        documents.push_back(internal_id);
+                    });
+                }
+            }
+        });
+        pool.ForEachIndex(policy, joint.size(),
+                          [this, &segment, &queries, &joint, &plus_terms, &minus_terms, &plus_postings,
+                           &minus_postings, &top_documents, &predicate, &find_term, &segment_ends, &finish_joint,
+                           s, status_mask, max_count](size_t k) {
+            if (s >= segment_ends[k]) {
+                return;
+            }
+            const Query &query = queries[joint[k]];
+            ScoreAccumulatorLease lease(1);
+            ScoreAccumulator &accumulator = lease[0];
+            accumulator.Reset(version_->document_end);
+            for (size_t j = 0; j < query.plus_terms.size(); ++j) {
+                const double inverse_document_freq = query.inverse_document_freqs[j];
+                const size_t shared = find_term(plus_terms, query.plus_terms[j]);
+                if (shared < plus_terms.size()) {
+                    for (const auto &[internal_id, term_freq] : plus_postings[shared]) {
+                        accumulator.Add(internal_id, term_freq * inverse_document_freq);
+                    }
+                } else if (const PostingList *postings = segment.index->FindPostings(query.plus_terms[j])) {
+                    postings->ForEach([this, &accumulator, &predicate, inverse_document_freq](
+                            uint32_t internal_id, uint32_t count, uint32_t status) {
+                        if (!IsRemoved(internal_id) && predicate(internal_id, status)) {
+                            accumulator.Add(internal_id, ComputeTermFreq(count, version_->lengths[internal_id]) *
+                                                         inverse_document_freq);
+                        }
+                    }, status_mask);
+                }
+            }
+            // минус-слова учитываются после всех плюс-слов сегмента, иначе документ снова отметится найденным
+            for (const uint32_t term_id : query.minus_terms) {
+                const size_t shared = find_term(minus_terms, term_id);
+                if (shared < minus_terms.size()) {
+                    for (const uint32_t internal_id : minus_postings[shared]) {
+                        accumulator.Exclude(internal_id);
+                    }
+                } else if (const PostingList *postings = segment.index->FindPostings(term_id)) {
+                    postings->ForEach([&accumulator](uint32_t internal_id, uint32_t, uint32_t) {
+                        accumulator.Exclude(internal_id);
+                    });
+                }
+            }
+            vector<Document> &documents = top_documents[k];
+            accumulator.ForEach([this, &documents](uint32_t internal_id, double relevance) {
+                documents.push_back(Document{version_->external_ids[internal_id], relevance,
+                                             version_->ratings[internal_id]});
+            });
+            SelectTopDocuments(execution::seq, version_->thread_pool, documents, max_count);
+            if (s + 1 == segment_ends[k]) {
+                finish_joint(k);
+            }
+        });
+    }
 }
 
 template<class ExecutionPolicy>
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(ExecutionPolicy&& policy,
-                                                        std::string_view raw_query, int document_id) const {
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::Snapshot::MatchDocument(
+        ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const {
     using namespace std;
-    if (documents_.count(document_id) == 0) {
+    const uint32_t internal_id = FindDocument(document_id);
+    if (internal_id == DocumentIdIndex::NO_DOCUMENT) {
         throw out_of_range("No document with id "s + to_string(document_id));
     }
 
-    Query query = SplitQueryWords(raw_query);
+    ScratchLease<QueryScratch> scratch;
+    SplitQueryWords(raw_query, *scratch);
+    const Query &query = scratch->query;
 
     tuple<vector<string_view>, DocumentStatus> result;
-    get<1>(result) = documents_.at(document_id).status;
+    get<1>(result) = version_->statuses[internal_id];
 
     // если в документе есть минус слово возвращаем пустой список
-    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [this, document_id] (auto &word){
-        return document_to_word_.at(document_id).count(word) != 0;})) {
-
+    const auto has_term = [this, internal_id] (uint32_t term_id){
+        return FindDocumentTerm(internal_id, term_id) != nullptr;};
+    bool excluded = false;
+    if constexpr (is_same_v<decay_t<ExecutionPolicy>, AdaptiveExecutionPolicy>) {
+        // проверка слова - двоичный поиск по терминам документа, поэтому стоимость - кол-во минус-слов
+        const QueryPlan plan = version_->planner.Plan(query.minus_terms.size(),
+                                                      version_->thread_pool.GetParallelism());
+        version_->planner.Record(plan, 1);
+        excluded = plan.threads == 1
+                ? any_of(query.minus_terms.begin(), query.minus_terms.end(), has_term)
+                : version_->thread_pool.AnyOf(execution::par, query.minus_terms.begin(), query.minus_terms.end(),
+                                              has_term);
+    } else {
+        excluded = version_->thread_pool.AnyOf(policy, query.minus_terms.begin(), query.minus_terms.end(), has_term);
+    }
+    if (excluded) {
         return result;
     }
 
     // если в документе есть плюс-слово добавляем его (слово) в выдачу
     // еще раз проверил, распараллеливание с локом не даёт выигрыша в скорости,
     // поэтому оставил последовательную версию
-    get<0>(result).reserve(query.plus_words.size());
-    for_each(query.plus_words.begin(), query.plus_words.end(),
-    [this, document_id, &result](auto &word){
-        if (document_to_word_.at(document_id).count(word) != 0) {
-            get<0>(result).push_back(word_to_document_.find(word)->first);
+    auto &words = get<0>(result);
+    words.reserve(query.plus_terms.size());
+    for (const uint32_t term_id : query.plus_terms) {
+        if (FindDocumentTerm(internal_id, term_id) != nullptr) {
+            words.push_back(version_->terms.GetWord(term_id));
         }
-    });
+    }
+    // слова выдаём в алфавитном порядке, а не в порядке id терминов
+    sort(words.begin(), words.end());
     return result;
 }
 
 template<class ExecutionPolicy>
-void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (documents_.count(document_id) != 0) {
-
-        // собираем вектор слов документа
-        std::vector<std::string_view> words(document_to_word_.at(document_id).size());
-        std::transform(document_to_word_.at(document_id).begin(),
-                       document_to_word_.at(document_id).end(), words.begin(), [](auto &word) {
-            return word.first;
-        });
+MatchResults SearchServer::Snapshot::MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                    const std::vector<int> &document_ids) const {
+    using namespace std;
+    vector<uint32_t> internal_ids(document_ids.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        internal_ids[i] = FindDocument(document_ids[i]);
+        if (internal_ids[i] == DocumentIdIndex::NO_DOCUMENT) {
+            throw out_of_range("No document with id "s + to_string(document_ids[i]));
+        }
+    }
+    return MatchInternalDocuments(policy, raw_query, internal_ids);
+}
+
+template<class ExecutionPolicy>
+MatchResults SearchServer::Snapshot::MatchAllDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
+    using namespace std;
+    vector<uint32_t> internal_ids;
+    internal_ids.reserve(static_cast<size_t>(version_->document_count));
+    for (uint32_t internal_id = 0; internal_id < version_->document_end; ++internal_id) {
+        if (!IsRemoved(internal_id)) {
+            internal_ids.push_back(internal_id);
+        }
+    }
+    // внутренние id идут в порядке добавления, а документы выдаём по возрастанию id
+    sort(internal_ids.begin(), internal_ids.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return version_->external_ids[lhs] < version_->external_ids[rhs];
+    });
+    return MatchInternalDocuments(policy, raw_query, internal_ids);
+}
+
+template <class ExecutionPolicy>
+MatchResults SearchServer::Snapshot::MatchInternalDocuments(ExecutionPolicy&&, std::string_view raw_query,
+                                                            const std::vector<uint32_t> &internal_ids) const {
+    using namespace std;
+    ScratchLease<QueryScratch> scratch;
+    SplitQueryWords(raw_query, *scratch);
+    const Query &query = scratch->query;
 
-        // удаляем слова (можно распараллелить потому что из каждого словаря удалится максимум одна запись)
-        std::for_each(policy, words.begin(), words.end(), [this, document_id](auto &word_view) {
-            word_to_document_.find(word_view)->second.erase(document_id);});
+    // слова плюс-терминов находятся один раз и сортируются, поэтому слова каждого документа выходят
+    // в алфавитном порядке без сортировки
+    vector<pair<string_view, uint32_t>> plus_words;
+    plus_words.reserve(query.plus_terms.size());
+    for (const uint32_t term_id : query.plus_terms) {
+        plus_words.emplace_back(version_->terms.GetWord(term_id), term_id);
+    }
+    sort(plus_words.begin(), plus_words.end());
+
+    // документы делятся на части по потокам, каждая часть складывает слова в свой буфер
+    size_t thread_count = 1;
+    if constexpr (is_same_v<decay_t<ExecutionPolicy>, AdaptiveExecutionPolicy>) {
+        // проверка слова - двоичный поиск по терминам документа
+        const QueryPlan plan = version_->planner.Plan(
+                internal_ids.size() * (query.plus_terms.size() + query.minus_terms.size()),
+                version_->thread_pool.GetParallelism());
+        version_->planner.Record(plan, 1);
+        thread_count = plan.threads;
+    } else if constexpr (!is_same_v<decay_t<ExecutionPolicy>, execution::sequenced_policy>) {
+        thread_count = version_->thread_pool.GetParallelism();
+    }
+    const size_t part_count = max<size_t>(min(thread_count, internal_ids.size()), 1);
+    const auto part_begin = [&internal_ids, part_count](size_t part) {
+        return internal_ids.size() / part_count * part + min(part, internal_ids.size() % part_count);
+    };
 
-        // подчищаем в словаре слова, которые остались без документов
-        // (нельзя распараллелить, потому что удаляются записи в одном словаре)
-        std::for_each(words.begin(), words.end(), [this, document_id](auto &word_view) {
-            auto it = word_to_document_.find(word_view);
-            if (it->second.empty()) {
-                word_to_document_.erase(it);
+    MatchResults results;
+    results.document_ids.resize(internal_ids.size());
+    results.statuses.resize(internal_ids.size());
+    results.word_offsets.assign(internal_ids.size() + 1, 0);
+    vector<vector<string_view>> part_words(part_count);
+    const auto match_part = [this, &query, &internal_ids, &plus_words, &results, &part_words,
+                             &part_begin](size_t part) {
+        vector<string_view> &words = part_words[part];
+        for (size_t i = part_begin(part); i < part_begin(part + 1); ++i) {
+            const uint32_t internal_id = internal_ids[i];
+            results.document_ids[i] = version_->external_ids[internal_id];
+            results.statuses[i] = version_->statuses[internal_id];
+            const size_t words_begin = words.size();
+            // документ с минус-словом не совпадает ни по одному слову
+            if (none_of(query.minus_terms.begin(), query.minus_terms.end(), [this, internal_id](uint32_t term_id) {
+                    return FindDocumentTerm(internal_id, term_id) != nullptr;
+                })) {
+                for (const auto &[word, term_id] : plus_words) {
+                    if (FindDocumentTerm(internal_id, term_id) != nullptr) {
+                        words.push_back(word);
+                    }
+                }
             }
-        });
+            results.word_offsets[i + 1] = words.size() - words_begin;
+        }
+    };
+    if (part_count == 1) {
+        match_part(0);
+    } else {
+        version_->thread_pool.ForEachIndex(execution::par, part_count, match_part);
+    }
 
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
-        document_to_word_.erase(document_id);
+    // кол-ва слов превращаются в смещения, буферы частей склеиваются в общий
+    partial_sum(results.word_offsets.begin(), results.word_offsets.end(), results.word_offsets.begin());
+    results.words.resize(results.word_offsets.back());
+    for (size_t part = 0; part < part_count; ++part) {
+        copy(part_words[part].begin(), part_words[part].end(),
+             results.words.begin() + static_cast<ptrdiff_t>(results.word_offsets[part_begin(part)]));
     }
+    return results;
+}
+
+template <class Сontainer>
+SearchServer::SearchServer(const Сontainer &stop_words) {
+    using namespace std;
+    vector<string_view> words;
+    for (string_view stop_word: stop_words) {
+        words.push_back(stop_word);
+    }
+    stop_words_ = make_shared<const StopWordSet>(words);
+    Publish();
+}
+
+template <size_t N>
+SearchServer::SearchServer(const StaticStopWords<N> &stop_words)
+    : stop_words_(std::make_shared<const StopWordSet>(stop_words)) {
+    Publish();
+}
+
+template <class ExecutionPolicy>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, const std::vector<DocumentInput> &documents) {
+    using namespace std;
+    ApplyMerge(false);
+    // id проверяем до изменения сервера
+    vector<int> ids(documents.size());
+    transform(documents.begin(), documents.end(), ids.begin(), [](const DocumentInput &document) {
+        return document.id;
+    });
+    sort(ids.begin(), ids.end());
+    if (adjacent_find(ids.begin(), ids.end()) != ids.end()) {
+        throw invalid_argument("Document with this id already exist"s);
+    }
+    for (const DocumentInput &document : documents) {
+        if (document.text.empty()) {
+            throw invalid_argument("Can't add empty document"s);
+        }
+        if (FindDocument(document.id) != DocumentIdIndex::NO_DOCUMENT) {
+            throw invalid_argument("Document with this id already exist"s);
+        }
+        if (document.id < 0) {
+            throw invalid_argument("Can't add document with negative id"s);
+        }
+    }
+
+    // разбиваем документы на слова и считаем вхождения слов; исключение из параллельного алгоритма
+    // выпустить нельзя, поэтому запоминаем его и выбрасываем после
+    struct ParsedDocument {
+        std::vector<std::string_view> words; // слова документа без стоп-слов
+        std::vector<uint32_t> terms; // id терминов слов
+        std::vector<TermCount> term_counts; // термины по возрастанию id
+        std::exception_ptr error;
+    };
+    vector<ParsedDocument> parsed(documents.size());
+    const ThreadPool::View &pool = thread_pool_.GetView();
+    pool.ForEachIndex(policy, documents.size(), [this, &documents, &parsed](size_t index) {
+        ParsedDocument &document = parsed[index];
+        try {
+            document.words = SplitIntoWordsNoStop(*stop_words_, documents[index].text);
+            // словарь только читается, поэтому известные слова ищем параллельно
+            document.terms.resize(document.words.size());
+            transform(document.words.begin(), document.words.end(), document.terms.begin(),
+                      [this](string_view word) {
+                return terms_.Find(word);
+            });
+        } catch (...) {
+            document.error = current_exception();
+        }
+    });
+    for (const ParsedDocument &document : parsed) {
+        if (document.error) {
+            rethrow_exception(document.error);
+        }
+    }
+
+    // документы записываются в журнал до первого изменения сервера
+    LogDocuments(documents);
+
+    // новые слова добавляем в словарь последовательно
+    for (ParsedDocument &document : parsed) {
+        for (size_t i = 0; i < document.terms.size(); ++i) {
+            if (document.terms[i] == TermDictionary::NO_TERM) {
+                document.terms[i] = terms_.Intern(document.words[i]);
+            }
+        }
+    }
+    statistics_.ResizeTerms(terms_.size());
+    // считаем вхождения терминов документа, упорядочивая их по id, как в прямом индексе
+    pool.ForEach(policy, parsed.begin(), parsed.end(), [](ParsedDocument &document) {
+        auto &terms = document.terms;
+        sort(terms.begin(), terms.end());
+        for (auto it = terms.begin(); it != terms.end();) {
+            const auto next = upper_bound(it, terms.end(), *it);
+            document.term_counts.push_back(TermCount{*it, static_cast<uint32_t>(next - it)});
+            it = next;
+        }
+    });
+
+    // данные документов дописываем в столбцы, а термины документов - в прямой индекс
+    const uint32_t first_internal_id = static_cast<uint32_t>(document_external_ids_.size());
+    for (size_t index = 0; index < documents.size(); ++index) {
+        const DocumentInput &document = documents[index];
+        document_internal_ids_.Add(document.id, first_internal_id + static_cast<uint32_t>(index));
+        document_external_ids_.push_back(document.id);
+        document_ratings_.push_back(ComputeAverageRating(document.ratings));
+        document_statuses_.push_back(document.status);
+        document_lengths_.push_back(static_cast<uint32_t>(parsed[index].words.size()));
+        document_removal_versions_.push_back(RemovalVersion());
+        document_term_offsets_.push_back(document_term_offsets_.back() + parsed[index].term_counts.size());
+        document_ids_.insert(document.id);
+        statistics_.AddDocument(static_cast<uint32_t>(parsed[index].words.size()));
+    }
+    document_terms_.resize(document_term_offsets_.back());
+    document_tombstones_.resize((document_external_ids_.size() + 63) / 64);
+    pool.ForEachIndex(policy, documents.size(), [this, &parsed, first_internal_id](size_t index) {
+        const auto &term_counts = parsed[index].term_counts;
+        copy(term_counts.begin(), term_counts.end(), document_terms_.begin() + static_cast<ptrdiff_t>(
+                document_term_offsets_[first_internal_id + index]));
+    });
+
+    // кол-во документов с термином обновляем один раз на термин
+    vector<uint32_t> term_documents(terms_.size());
+    for (const ParsedDocument &document : parsed) {
+        for (const TermCount &term : document.term_counts) {
+            ++term_documents[term.term_id];
+        }
+    }
+    vector<uint32_t> touched_terms;
+    for (uint32_t term_id = 0; term_id < term_documents.size(); ++term_id) {
+        if (term_documents[term_id] != 0) {
+            touched_terms.push_back(term_id);
+        }
+    }
+    pool.ForEach(policy, touched_terms.begin(), touched_terms.end(), [this, &term_documents](uint32_t term_id) {
+        statistics_.AddTermDocuments(term_id, term_documents[term_id]);
+    });
+    SealActiveDocuments(policy);
+    Publish();
+}
+
+template <class ExecutionPolicy>
+std::shared_ptr<IndexSegment> SearchServer::BuildSegment(ExecutionPolicy&& policy, uint32_t first_document,
+                                                         uint32_t end_document) const {
+    using namespace std;
+    const auto is_removed = [this](uint32_t internal_id) {
+        return document_removal_versions_[internal_id].version.load(memory_order_relaxed) != NOT_REMOVED;
+    };
+    // раскладываем вхождения по терминам сортировкой подсчётом: документы идут по возрастанию
+    // внутренних id, поэтому вхождения каждого термина сразу оказываются упорядочены
+    vector<size_t> term_offsets(terms_.size() + 1);
+    for (uint32_t internal_id = first_document; internal_id < end_document; ++internal_id) {
+        if (is_removed(internal_id)) {
+            continue;
+        }
+        for (size_t i = document_term_offsets_[internal_id]; i < document_term_offsets_[internal_id + 1]; ++i) {
+            ++term_offsets[document_terms_[i].term_id + 1];
+        }
+    }
+    partial_sum(term_offsets.begin(), term_offsets.end(), term_offsets.begin());
+    vector<PostingList::Posting> postings(term_offsets.back());
+    vector<size_t> term_positions(term_offsets.begin(), term_offsets.end() - 1);
+    for (uint32_t internal_id = first_document; internal_id < end_document; ++internal_id) {
+        if (is_removed(internal_id)) {
+            continue;
+        }
+        for (size_t i = document_term_offsets_[internal_id]; i < document_term_offsets_[internal_id + 1]; ++i) {
+            const TermCount &term = document_terms_[i];
+            postings[term_positions[term.term_id]++] = PostingList::Posting{
+                    internal_id, term.count, static_cast<uint32_t>(document_statuses_[internal_id])};
+        }
+    }
+    // списки терминов создаются заранее, а затем независимо друг от друга заполняются параллельно
+    auto segment = make_shared<IndexSegment>(first_document);
+    segment->ExtendTo(end_document);
+    vector<uint32_t> touched_terms;
+    for (uint32_t term_id = 0; term_id + 1 < term_offsets.size(); ++term_id) {
+        if (term_offsets[term_id] != term_offsets[term_id + 1]) {
+            touched_terms.push_back(term_id);
+            segment->GetPostings(term_id);
+        }
+    }
+    thread_pool_.GetView().ForEach(policy, touched_terms.begin(), touched_terms.end(),
+                                   [this, &segment, &postings, &term_offsets](uint32_t term_id) {
+        PostingList &record = *segment->FindPostings(term_id);
+        for (size_t i = term_offsets[term_id]; i < term_offsets[term_id + 1]; ++i) {
+            const PostingList::Posting &posting = postings[i];
+            record.Append(posting.document, posting.count, document_lengths_[posting.document], posting.tag);
+        }
+        record.Seal();
+    });
+    segment->Seal();
+    return segment;
+}
+
+template <class ExecutionPolicy>
+void SearchServer::SealActiveDocuments(ExecutionPolicy&& policy, bool force) {
+    const uint32_t end_document = static_cast<uint32_t>(document_external_ids_.size());
+    if (end_document == active_begin_ || (!force && end_document - active_begin_ < segment_document_count_)) {
+        for (uint32_t internal_id = active_postings_.GetEndDocument(); internal_id < end_document; ++internal_id) {
+            for (size_t i = document_term_offsets_[internal_id]; i < document_term_offsets_[internal_id + 1]; ++i) {
+                active_postings_.Add(internal_id, document_terms_[i].term_id, document_terms_[i].count);
+            }
+        }
+        return;
+    }
+    // удалённые до заморозки документы в сегмент не попадают, поэтому учитываются до того, как их id окажутся
+    // внутри сегмента
+    FoldRemovals();
+    uint32_t document_count = 0;
+    for (uint32_t internal_id = active_begin_; internal_id < end_document; ++internal_id) {
+        if (document_removal_versions_[internal_id].version.load(std::memory_order_relaxed) == NOT_REMOVED) {
+            ++document_count;
+        }
+    }
+    segments_.push_back(SegmentState{BuildSegment(policy, active_begin_, end_document), document_count, nullptr,
+                                     nullptr});
+    active_begin_ = end_document;
+    active_postings_.Clear(end_document);
+    ScheduleMerge();
+}
+
+template<class ExecutionPolicy>
+void SearchServer::RemoveDocument(ExecutionPolicy&&, int document_id) {
+    using namespace std;
+    const uint32_t internal_id = FindDocument(document_id);
+    if (internal_id == DocumentIdIndex::NO_DOCUMENT) {
+        return;
+    }
+    ApplyMerge(false);
+    LogChange(LogRecord{LogRecord::Type::REMOVE_DOCUMENT, 0, document_id, DocumentStatus::ACTUAL, {}, {}, 0});
+    // документ удаляется в следующей версии индекса; прежние версии и снимки его по-прежнему видят,
+    // а его вхождения остаются в индексе и пропускаются при поиске
+    document_removal_versions_[internal_id].version.store(version_ + 1, memory_order_relaxed);
+    document_tombstones_[internal_id / 64].bits.fetch_or(uint64_t{1} << (internal_id % 64), memory_order_relaxed);
+    statistics_.RemoveDocument(document_lengths_[internal_id]);
+
+    // кол-ва документов с терминами и удалённых документов сегментов по терминам пересчитываются пакетами
+    pending_removals_.push_back(internal_id);
+    if (pending_removals_.size() >= REMOVAL_BATCH_SIZE) {
+        FoldRemovals();
+        ScheduleMerge();
+    }
+    document_ids_.erase(document_id);
+    Publish();
+}
+
+template <class KeyMapper, class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                     KeyMapper key_mapper, size_t max_count) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).FindTopDocuments(policy, raw_query, key_mapper, max_count);
+}
+
+template <class KeyMapper>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+                                                     KeyMapper key_mapper, size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, key_mapper, max_count);
+}
+
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                     const DocumentFilter &filter, size_t max_count) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).FindTopDocuments(policy, raw_query, filter, max_count);
+}
+
+template<class ExecutionPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(ExecutionPolicy&& policy,
+                                                        std::string_view raw_query, int document_id) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).MatchDocument(policy, raw_query, document_id);
+}
+
+template<class ExecutionPolicy>
+MatchResults SearchServer::MatchDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                          const std::vector<int> &document_ids) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).MatchDocuments(policy, raw_query, document_ids);
+}
+
+template<class ExecutionPolicy>
+MatchResults SearchServer::MatchAllDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).MatchAllDocuments(policy, raw_query);
 }
 
 template<class ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view query,
-                                                     DocumentStatus document_status) const {
-    return FindTopDocuments(policy, query, [document_status](int, DocumentStatus status, int) {
-        return status == document_status;
-    });
+                                                     DocumentStatus document_status, size_t max_count) const {
+    return FindTopDocuments(policy, query, DocumentFilter(document_status), max_count);
 }
 
 template<class ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view query) const {
     return FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
 }
+
+template <class ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(
+        ExecutionPolicy&& policy, const std::vector<std::string> &raw_queries, const DocumentFilter &filter,
+        size_t max_count) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).FindTopDocumentsBatch(policy, raw_queries, filter, max_count);
+}
+
+template <class ExecutionPolicy, class Consumer>
+void SearchServer::FindTopDocumentsStream(ExecutionPolicy&& policy, const std::vector<std::string> &raw_queries,
+                                          Consumer consumer, const DocumentFilter &filter, size_t max_count) const {
+    EpochGuard guard;
+    Snapshot(current_version_.Load()).FindTopDocumentsStream(policy, raw_queries, std::move(consumer), filter,
+                                                             max_count);
+}
@@ -8,6 +8,10 @@ void TestInitServer();
 // Тест проверяет, что корректные документы добавляются на сервер, а некорректные - нет
 void TestAddDocuments();
 
+// Тест проверяет пакетное добавление документов: результат совпадает с добавлением по одному,
+// а некорректный пакет не добавляется целиком
+void TestAddDocumentsBatch();
+
 // Тест проверяет, удаление документа
 void TestRemoveDocument();
 
@@ -17,6 +21,9 @@ void TestExcludeIncorrectFindDocuments();
 // Тест проверяет, что поисковая система исключает стоп-слова при добавлении документов
 void TestExcludeStopWordsFromAddedDocumentContent();
 
+// Проверка набора стоп-слов на случайных словах
+void TestStopWordSet();
+
 // Тест проверяет что поисковая система исключает из выдачи документы с минус-словами (и не исключает другие)
 void TestExcludeDocumentsWithMinusWords();
 
@@ -26,6 +33,10 @@ void TestExcludeDocumentsWithMinusWords();
 void TestDocumentsMatching();
 void TestDocumentsMatching_PAR();
 
+// Проверка, что MatchDocuments находит для каждого документа те же слова и статус, что MatchDocument,
+// MatchAllDocuments выдаёт все документы по возрастанию id, а отсутствующий документ выбрасывает исключение
+void TestMatchDocuments();
+
 // Проверка сортировки возвращаемых документов. Возвращаемые при поиске документов результаты должны быть
 // отсортированы в порядке убывания релевантности.
 void TestFindedDocumentsSort();
@@ -46,6 +57,71 @@ void TestFindedDocumentsRelevance();
 // Проверка возврата частоты слов по id документа
 void TestGetWordFrequencies();
 
+// Проверка статистики коллекции документов
+void TestCollectionStatistics();
+
+// Проверка разбиения текста на слова с поиском управляющих символов всеми реализациями
+void TestForEachWord();
+
+// Проверка словаря терминов
+void TestTermDictionary();
+
+// Проверка сжатого списка вхождений
+void TestPostingList();
+
+// Проверка аккумулятора релевантности документов
+void TestScoreAccumulator();
+
+// Проверка ограничения кол-ва документов в выдаче, задаваемого при вызове
+void TestFindTopDocumentsCount();
+
+// Проверка, что поиск с отсечением документов даёт ту же выдачу, что и полный подсчёт релевантности
+// и что декларативный фильтр отбирает те же документы, что и эквивалентный предикат
+void TestFindTopDocumentsPruning();
+
+// Проверка, что временные буферы запроса берутся из пула потока, в том числе при вложенных запросах,
+// и что запросы после первого выделяют память только под выдачу
+void TestQueryScratch();
+
+// Проверка, что повторные запросы берутся из кэша разобранных запросов с той же выдачей, что кэш устаревает
+// с ростом словаря, не разделяется копиями сервера и вытесняет давно не использованные запросы
+void TestQueryCache();
+
+// Проверка, что кэш выдачи отдаёт ту же выдачу, различает запросы, фильтры и кол-во документов, устаревает
+// с изменением сервера и не вытесняет частые запросы однократными
+void TestResultCache();
+
+// Проверка, что пакетный поиск даёт те же выдачи, что и поиск по каждому запросу
+void TestFindTopDocumentsBatch();
+
+// Проверка, что пул потоков выполняет каждую часть задачи один раз, в том числе во вложенных задачах,
+// передаёт исключения вызывающему и что сервер на пуле с любыми настройками ищет так же, как последовательно
+void TestThreadPool();
+
+// Проверка, что adaptive_execution выбирает последовательный поиск для дешёвых запросов и параллельный
+// для дорогих, показывает план в ExplainQuery и счётчиках и находит то же, что последовательный поиск
+void TestAdaptiveExecution();
+
+// Проверка, что потоковый поиск пакета отдаёт выдачу каждого запроса ровно один раз и ту же, что пакетный поиск,
+// отдаёт выдачу запроса, как только пройден последний сегмент с его словами, и что склеенные выдачи
+// ProcessQueriesJoined обходятся без копирования, в том числе пустые пакеты и выдачи
+void TestProcessQueriesStreaming();
+
+// Проверка, что индекс из нескольких сегментов, в том числе слитых в фоне, даёт ту же выдачу, что и один сегмент
+void TestIndexSegments();
+
+// Проверка, что снимок индекса не меняется вместе с сервером и что поиск идёт одновременно с изменением сервера
+void TestSnapshots();
+
+// Проверка, что удалённые документы пропускаются при поиске до перестройки сегментов и выбрасываются при ней
+void TestCompaction();
+
+// Проверка, что сервер, открытый из файла индекса, ищет так же, как сохранённый, и меняется как обычный
+void TestIndexFile();
+
+// Проверка восстановления сервера из журнала изменений поверх сохранённого индекса
+void TestWriteAheadLog();
+
 // Проверка удаления дубликатов
 void TestRemoveDuplicates();
 
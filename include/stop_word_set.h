@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+// таблица стоп-слов: хэш-таблица с открытой адресацией и линейным пробированием, заполненная не больше чем
+// наполовину, и перед ней фильтр на FILTER_BITS битов по длине, первому и последнему байту слова. Почти все слова
+// текста - не стоп-слова, и большинство из них фильтр отсекает проверкой одного бита, не считая хэш и не сравнивая
+// строк. Функции constexpr, поэтому одна и та же таблица строится и при компиляции (StaticStopWords),
+// и при создании сервера (StopWordSet)
+struct StopWordTable {
+    static constexpr size_t FILTER_BITS = 1024;
+    static constexpr size_t FILTER_WORDS = FILTER_BITS / 64;
+    using Filter = std::array<uint64_t, FILTER_WORDS>;
+
+    // возвращает бит фильтра непустого слова
+    static constexpr size_t FilterBit(std::string_view word) {
+        const uint32_t key = static_cast<uint32_t>(word.size()) * 0x9E3779B1u +
+                             static_cast<unsigned char>(word.front()) * 0x85EBCA77u +
+                             static_cast<unsigned char>(word.back()) * 0xC2B2AE3Du;
+        return key >> 22; // старшие 10 битов
+    }
+
+    // FNV-1a с перемешиванием старших битов в младшие, по которым выбирается ячейка
+    static constexpr uint64_t Hash(std::string_view word) {
+        uint64_t hash = 14695981039346656037ull;
+        for (const char c : word) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash ^ (hash >> 32);
+    }
+
+    // кол-во ячеек таблицы для word_count слов: степень двойки, не меньше 2 * word_count
+    static constexpr size_t SlotCount(size_t word_count) {
+        size_t slot_count = 2;
+        while (slot_count < 2 * word_count) {
+            slot_count *= 2;
+        }
+        return slot_count;
+    }
+
+    // true, если в слове нет управляющих символов
+    static constexpr bool IsValid(std::string_view word) {
+        for (const char c : word) {
+            if (static_cast<unsigned char>(c) < ' ') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // добавляет непустое слово в таблицу, если его там ещё нет; возвращает true, если слово добавлено.
+    // Пустая ячейка - пустой string_view
+    template <class Slots>
+    static constexpr bool Insert(Slots &slots, Filter &filter, std::string_view word) {
+        const size_t mask = slots.size() - 1;
+        for (size_t slot = static_cast<size_t>(Hash(word)) & mask;; slot = (slot + 1) & mask) {
+            if (slots[slot].empty()) {
+                slots[slot] = word;
+                break;
+            }
+            if (slots[slot] == word) {
+                return false;
+            }
+        }
+        const size_t bit = FilterBit(word);
+        filter[bit / 64] |= uint64_t{1} << (bit % 64);
+        return true;
+    }
+
+    // true, если слово есть в таблице из mask + 1 ячеек
+    static constexpr bool Contains(const std::string_view *slots, size_t mask, const uint64_t *filter,
+                                   std::string_view word) {
+        if (word.empty()) {
+            return false;
+        }
+        const size_t bit = FilterBit(word);
+        if (((filter[bit / 64] >> (bit % 64)) & 1) == 0) {
+            return false;
+        }
+        for (size_t slot = static_cast<size_t>(Hash(word)) & mask;; slot = (slot + 1) & mask) {
+            if (slots[slot].empty()) {
+                return false;
+            }
+            if (slots[slot] == word) {
+                return true;
+            }
+        }
+    }
+};
+
+// набор стоп-слов, таблица которого строится при компиляции:
+// `constexpr StaticStopWords STOP_WORDS(std::array{"и"sv, "в"sv, "на"sv});`.
+// Слова не копируются, поэтому должны жить всё время жизни набора (строковые литералы живут всегда).
+// Слово с управляющим символом в constexpr-наборе - ошибка компиляции
+template <size_t N>
+class StaticStopWords {
+public:
+    constexpr explicit StaticStopWords(const std::array<std::string_view, N> &words) {
+        for (const std::string_view word : words) {
+            if (!StopWordTable::IsValid(word)) {
+                throw std::invalid_argument("Document contain service symbols");
+            }
+            if (!word.empty() && StopWordTable::Insert(slots_, filter_, word)) {
+                ++size_;
+            }
+        }
+    }
+
+    constexpr bool Contains(std::string_view word) const {
+        return StopWordTable::Contains(slots_.data(), slots_.size() - 1, filter_.data(), word);
+    }
+    constexpr size_t size() const {
+        return size_;
+    }
+
+private:
+    friend class StopWordSet;
+
+    std::array<std::string_view, StopWordTable::SlotCount(N)> slots_{};
+    StopWordTable::Filter filter_{};
+    size_t size_ = 0;
+};
+
+// неизменяемый набор стоп-слов сервера: либо собственная таблица, построенная по списку слов,
+// либо таблица constexpr-набора StaticStopWords, используемая на месте
+class StopWordSet {
+public:
+    // копирует слова в собственную память; пустые слова пропускаются.
+    // Выбрасывает invalid_argument, если в слове есть управляющие символы
+    explicit StopWordSet(const std::vector<std::string_view> &words);
+    // набор words должен жить дольше StopWordSet, например, быть constexpr-переменной
+    template <size_t N>
+    explicit StopWordSet(const StaticStopWords<N> &words);
+    template <size_t N>
+    explicit StopWordSet(const StaticStopWords<N> &&words) = delete;
+    StopWordSet(const StopWordSet &other) = delete;
+    StopWordSet& operator=(const StopWordSet &other) = delete;
+
+    bool Contains(std::string_view word) const;
+    // возвращает стоп-слова в алфавитном порядке
+    std::vector<std::string_view> GetWords() const;
+    size_t size() const;
+
+private:
+    std::vector<char> storage_; // слова собственного набора подряд
+    std::vector<std::string_view> own_slots_;
+    StopWordTable::Filter own_filter_{};
+    const std::string_view *slots_ = nullptr;
+    size_t slot_mask_ = 0;
+    const uint64_t *filter_ = nullptr;
+    size_t size_ = 0;
+};
+
+template <size_t N>
+StopWordSet::StopWordSet(const StaticStopWords<N> &words)
+    : slots_(words.slots_.data()), slot_mask_(words.slots_.size() - 1), filter_(words.filter_.data()),
+      size_(words.size_) {}
+
+inline bool StopWordSet::Contains(std::string_view word) const {
+    return StopWordTable::Contains(slots_, slot_mask_, filter_, word);
+}
@@ -1,9 +1,88 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 // разбивает строку на слова, разделенные пробелами, игнорируя лишние пробелы
 std::vector<std::string> SplitIntoWords (const std::string &text);
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
+
+// маски блока текста из TEXT_BLOCK_SIZE байт: бит i соответствует байту i блока
+struct TextBlockMasks {
+    uint64_t spaces = 0; // пробелы
+    uint64_t controls = 0; // управляющие символы (байты меньше ' ')
+};
+constexpr size_t TEXT_BLOCK_SIZE = 64;
+
+// реализация поиска пробелов и управляющих символов в блоке текста: скалярная или на векторных инструкциях
+struct TextScanner {
+    const char *name;
+    TextBlockMasks (*scan)(const char *block); // блок из TEXT_BLOCK_SIZE байт
+};
+
+// возвращает самую быструю реализацию, которую поддерживает процессор; выбирается один раз при первом вызове
+const TextScanner& GetTextScanner();
+// возвращает все реализации, которые поддерживает процессор, начиная со скалярной
+std::vector<TextScanner> GetSupportedTextScanners();
+
+// возвращает номер младшего установленного бита, mask != 0
+inline int CountTrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// разбивает текст на слова, разделённые пробелами, и вызывает callback(word) для каждого слова по порядку.
+// Текст просматривается один раз блоками по TEXT_BLOCK_SIZE байт: в каждом блоке scanner за несколько
+// векторных инструкций находит и пробелы, и управляющие символы. Возвращает false, если в тексте есть
+// управляющие символы; слова при этом всё равно передаются в callback все
+template <class Callback>
+bool ForEachWord(std::string_view text, Callback callback, const TextScanner &scanner = GetTextScanner()) {
+    uint64_t controls = 0;
+    size_t word_begin = 0;
+    bool in_word = false; // последний байт предыдущего блока - не пробел
+    for (size_t offset = 0; offset < text.size(); offset += TEXT_BLOCK_SIZE) {
+        TextBlockMasks masks;
+        if (text.size() - offset >= TEXT_BLOCK_SIZE) {
+            masks = scanner.scan(text.data() + offset);
+        } else {
+            // неполный последний блок дополняется пробелами, которые и завершают последнее слово
+            char block[TEXT_BLOCK_SIZE];
+            std::memset(block, ' ', TEXT_BLOCK_SIZE);
+            std::memcpy(block, text.data() + offset, text.size() - offset);
+            masks = scanner.scan(block);
+        }
+        controls |= masks.controls;
+        // начало слова - не пробел после пробела, конец - пробел после не пробела
+        const uint64_t previous_spaces = masks.spaces << 1 | (in_word ? 0 : 1);
+        uint64_t starts = ~masks.spaces & previous_spaces;
+        uint64_t ends = masks.spaces & ~previous_spaces;
+        // начала и концы чередуются, поэтому обходим их вместе по возрастанию позиции
+        for (uint64_t bounds = starts | ends; bounds != 0; bounds &= bounds - 1) {
+            const uint64_t bit = bounds & (~bounds + 1);
+            const size_t position = offset + static_cast<size_t>(CountTrailingZeros(bit));
+            if ((starts & bit) != 0) {
+                word_begin = position;
+            } else {
+                callback(text.substr(word_begin, position - word_begin));
+            }
+        }
+        in_word = (masks.spaces >> (TEXT_BLOCK_SIZE - 1)) == 0;
+    }
+    if (in_word) {
+        callback(text.substr(word_begin));
+    }
+    return controls == 0;
+}
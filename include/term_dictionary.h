@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "append_only_array.h"
+
+// словарь терминов: хранит каждое слово один раз в непрерывной арене и сопоставляет ему плотный id.
+// Слова только добавляются, поэтому пока один поток добавляет слова, другие могут искать их через View
+class TermDictionary {
+private:
+    // блоки арены, никогда не перемещаются и не освобождаются раньше последнего View
+    struct Arena {
+        std::vector<std::unique_ptr<char[]>> chunks;
+        std::shared_ptr<const void> storage; // чужая память со словами, которые не копировались в арену
+    };
+    // хэш-таблица с открытой адресацией, ячейка - хэш слова в старших 32 битах и id в младших;
+    // хэш храним рядом с id, чтобы не ходить в арену зря. Ячейки атомарны, так как их читают во время записи
+    using Slots = std::shared_ptr<std::atomic<uint64_t>[]>;
+
+public:
+    static constexpr uint32_t NO_TERM = std::numeric_limits<uint32_t>::max(); // id отсутствующего слова
+
+    // словарь в момент получения View: видит только слова, добавленные до этого.
+    // Остаётся действительным и после изменения или разрушения словаря
+    class View {
+    public:
+        View() = default;
+
+        // возвращает id слова или NO_TERM, если слова в словаре нет
+        uint32_t Find(std::string_view word) const;
+        // возвращает слово по id, string_view действителен всё время жизни View
+        std::string_view GetWord(uint32_t term_id) const;
+        // возвращает кол-во слов
+        size_t size() const;
+
+    private:
+        friend class TermDictionary;
+
+        std::shared_ptr<const Arena> arena_;
+        std::shared_ptr<const std::string_view[]> words_;
+        size_t size_ = 0;
+        std::shared_ptr<const std::atomic<uint64_t>[]> slots_;
+        size_t slot_count_ = 0;
+    };
+
+    TermDictionary();
+    // словарь из уникальных слов в порядке id, лежащих в памяти storage (например, в отображённом файле индекса):
+    // слова не копируются в арену, а storage живёт, пока живы словарь и его View.
+    // Выбрасывает исключение, если слова повторяются
+    TermDictionary(const std::vector<std::string_view> &words, std::shared_ptr<const void> storage);
+    TermDictionary(const TermDictionary &other);
+    TermDictionary(TermDictionary &&other) noexcept = default;
+    TermDictionary& operator=(const TermDictionary &other);
+    TermDictionary& operator=(TermDictionary &&other) noexcept = default;
+
+    // возвращает id слова, добавляя слово в словарь при первом появлении
+    uint32_t Intern(std::string_view word);
+    // возвращает id слова или NO_TERM, если слова в словаре нет
+    uint32_t Find(std::string_view word) const;
+    // возвращает слово по id, string_view действителен всё время жизни словаря
+    std::string_view GetWord(uint32_t term_id) const;
+    // возвращает кол-во слов в словаре
+    size_t size() const;
+    // возвращает словарь в его текущем состоянии для чтения из других потоков
+    View GetView() const;
+
+private:
+    static constexpr size_t ARENA_CHUNK_SIZE = 64 * 1024; // размер блока арены в байтах
+    static constexpr size_t INITIAL_SLOT_COUNT = 1024; // начальный размер хэш-таблицы (степень двойки)
+    static constexpr uint64_t EMPTY_SLOT = NO_TERM; // пустая ячейка хэш-таблицы
+
+    std::shared_ptr<Arena> arena_;
+    size_t chunk_free_ = 0; // свободное место в последнем блоке арены
+    AppendOnlyArray<std::string_view> words_; // слова по id, указывают в арену
+    Slots slots_;
+    size_t slot_count_ = 0;
+
+    static uint32_t Hash(std::string_view word);
+    // копирует слово в арену и возвращает view на копию
+    std::string_view StoreWord(std::string_view word);
+    // возвращает индекс ячейки, в которой лежит слово, либо первой пустой ячейки на его пути, а в term_id -
+    // id слова или NO_TERM; ячейки слов с id не меньше word_count пропускаются
+    static size_t FindSlot(const std::atomic<uint64_t> *slots, size_t slot_count, const std::string_view *words,
+                           size_t word_count, std::string_view word, uint32_t hash, uint32_t &term_id);
+    // создаёт хэш-таблицу из slot_count пустых ячеек
+    static Slots MakeSlots(size_t slot_count);
+    // увеличивает хэш-таблицу вдвое и перераскладывает слова в новую таблицу, старая остаётся у View
+    void Grow();
+};
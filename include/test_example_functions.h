@@ -27,3 +27,4 @@ std::vector<std::string> GenerateQueries(std::mt19937& generator,
 
 void ProfileGetWordFrequencies();
 void ProfileRemoveDocument();
+void ProfilePostingLists();
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <execution>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+// настройки пула потоков
+struct ThreadPoolOptions {
+    // кол-во рабочих потоков; вызывающий поток выполняет части своей задачи вместе с ними,
+    // поэтому по умолчанию потоков на один меньше, чем ядер
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    // закреплять ли рабочий поток i за ядром i (только Linux)
+    bool pin_threads = false;
+    // наибольшее кол-во потоков, одновременно выполняющих одну задачу (например, один запрос);
+    // 0 - все рабочие потоки и вызывающий
+    size_t max_parallelism = 0;
+};
+
+// пул потоков с захватом задач (work stealing): у каждого рабочего потока своя очередь частей задач,
+// поток берёт части из конца своей очереди, а закончив их, забирает части из начала чужих. Поток, ждущий
+// свою задачу, выполняет чужие части, поэтому вложенные параллельные вызовы (параллельный запрос внутри
+// параллельного пакета запросов) делят те же потоки и не создают новых. Потоки запускаются при первой
+// параллельной задаче. Копия пула - новый пул с теми же настройками
+class ThreadPool {
+private:
+    struct Storage;
+
+public:
+    // пул в момент получения View: остаётся действительным и после разрушения пула, методы можно вызывать
+    // из любого числа потоков. View по умолчанию выполняет всё в вызывающем потоке
+    class View {
+    public:
+        View() = default;
+
+        // кол-во частей, на которые делится одна задача: кол-во потоков, выполняющих её одновременно
+        size_t GetParallelism() const;
+
+        // вызывает function(i) для i из [0, count): с execution::seq по порядку в вызывающем потоке,
+        // с другими политиками - частями на потоках пула. Исключение из function выбрасывается после
+        // выполнения всех частей
+        template <class ExecutionPolicy, class Function>
+        void ForEachIndex(ExecutionPolicy&& policy, size_t count, Function function) const;
+        // вызывает function(element) для элементов диапазона [first, last) с произвольным доступом
+        template <class ExecutionPolicy, class Iterator, class Function>
+        void ForEach(ExecutionPolicy&& policy, Iterator first, Iterator last, Function function) const;
+        // true, если predicate(element) верен хотя бы для одного элемента диапазона
+        template <class ExecutionPolicy, class Iterator, class Predicate>
+        bool AnyOf(ExecutionPolicy&& policy, Iterator first, Iterator last, Predicate predicate) const;
+
+    private:
+        friend class ThreadPool;
+
+        std::shared_ptr<Storage> storage_;
+
+        // делит индексы [0, count) на part_count частей и выполняет invoke(context, begin, end) для каждой
+        void Run(size_t count, size_t part_count, void (*invoke)(void*, size_t, size_t), void *context) const;
+    };
+
+    explicit ThreadPool(ThreadPoolOptions options = {});
+    ThreadPool(const ThreadPool &other);
+    ThreadPool(ThreadPool &&other) noexcept = default;
+    ThreadPool& operator=(const ThreadPool &other);
+    ThreadPool& operator=(ThreadPool &&other) noexcept = default;
+
+    const ThreadPoolOptions& GetOptions() const;
+    const View& GetView() const;
+
+private:
+    static constexpr size_t PARTS_PER_THREAD = 4; // части мельче потоков, чтобы неравные части распределялись
+
+    ThreadPoolOptions options_;
+    View view_;
+};
+
+template <class ExecutionPolicy, class Function>
+void ThreadPool::View::ForEachIndex(ExecutionPolicy&&, size_t count, Function function) const {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        for (size_t i = 0; i < count; ++i) {
+            function(i);
+        }
+    } else {
+        const size_t parallelism = GetParallelism();
+        // задачу не больше чем на поток делим ровно по потокам, большую - на части мельче
+        const size_t part_count = count <= parallelism ? count : std::min(count, parallelism * PARTS_PER_THREAD);
+        Run(count, part_count, [](void *context, size_t begin, size_t end) {
+            Function &part_function = *static_cast<Function*>(context);
+            for (size_t i = begin; i < end; ++i) {
+                part_function(i);
+            }
+        }, &function);
+    }
+}
+
+template <class ExecutionPolicy, class Iterator, class Function>
+void ThreadPool::View::ForEach(ExecutionPolicy&& policy, Iterator first, Iterator last, Function function) const {
+    ForEachIndex(policy, static_cast<size_t>(std::distance(first, last)), [first, &function](size_t i) {
+        function(first[static_cast<typename std::iterator_traits<Iterator>::difference_type>(i)]);
+    });
+}
+
+template <class ExecutionPolicy, class Iterator, class Predicate>
+bool ThreadPool::View::AnyOf(ExecutionPolicy&& policy, Iterator first, Iterator last, Predicate predicate) const {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        return std::any_of(first, last, predicate);
+    } else {
+        // части проверяют свои элементы независимо, флаг только пропускает уже ненужные проверки
+        std::atomic<bool> found{false};
+        ForEach(policy, first, last, [&found, &predicate](const auto &element) {
+            if (!found.load(std::memory_order_relaxed) && predicate(element)) {
+                found.store(true, std::memory_order_relaxed);
+            }
+        });
+        return found.load();
+    }
+}
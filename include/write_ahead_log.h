@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+// запись журнала изменений сервера
+struct LogRecord {
+    enum class Type : uint32_t {
+        ADD_DOCUMENT = 1, // document_id, status, ratings, text
+        REMOVE_DOCUMENT = 2, // document_id
+        SET_SEGMENT_DOCUMENT_COUNT = 3 // value
+    };
+
+    Type type = Type::ADD_DOCUMENT;
+    uint64_t sequence = 0; // номер изменения, номера записей журнала возрастают
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+    uint32_t value = 0;
+};
+
+// настройки сброса журнала на диск: чем больше группа, тем выше скорость записи и тем больше изменений
+// теряется при сбое ОС или питания
+struct LogOptions {
+    // кол-во записей, после которого журнал сбрасывается на диск (fsync): 1 - каждое изменение сохранено
+    // к возврату из метода, N - один fsync на группу из N изменений, 0 - только по Sync и при закрытии журнала
+    size_t group_commit_size = 1;
+};
+
+// журнал изменений (write-ahead log): записи только дописываются в конец файла, каждая с контрольной суммой
+// CRC-32C. Запись передаётся ОС сразу и переживает падение процесса, а на диск сбрасывается группами
+// (см. LogOptions). При открытии целые записи проигрываются по порядку, а оборванный при сбое хвост отбрасывается.
+// Копия журнала не наследует файл и ничего не пишет, перемещённый журнал передаёт файл
+class WriteAheadLog {
+public:
+    WriteAheadLog() = default;
+    WriteAheadLog(const WriteAheadLog &other);
+    WriteAheadLog(WriteAheadLog &&other) noexcept;
+    WriteAheadLog& operator=(const WriteAheadLog &other);
+    WriteAheadLog& operator=(WriteAheadLog &&other);
+    ~WriteAheadLog();
+
+    // открывает журнал, создавая файл при его отсутствии, и вызывает replay(record) для каждой целой записи
+    // по порядку; записи после первой повреждённой отбрасываются и стираются из файла.
+    // Выбрасывает исключение, если файл не открывается или не является журналом
+    void Open(const std::string &path, LogOptions options,
+              const std::function<void(const LogRecord &record)> &replay);
+    // true, если журнал открыт
+    bool IsOpen() const;
+    // дописывает запись; номер записи должен быть больше номеров всех записей журнала.
+    // Если запись не удалась, выбрасывает исключение, а файл обрезается до прежних записей
+    void Append(const LogRecord &record);
+    // дописывает пакет записей, сбрасывая журнал на диск не чаще одного раза на пакет; пакет дописывается
+    // или отбрасывается целиком
+    void Append(const std::vector<LogRecord> &records);
+    // сбрасывает на диск все дописанные записи
+    void Sync();
+    // стирает все записи (после сохранения индекса, который их уже содержит) и сбрасывает журнал на диск
+    void Reset();
+    // закрывает журнал, сбросив записи на диск
+    void Close();
+
+private:
+    std::string path_;
+    std::FILE *file_ = nullptr;
+    LogOptions options_;
+    size_t unsynced_ = 0; // кол-во записей, не сброшенных на диск
+    uint64_t size_ = 0; // размер файла с переданными ОС записями
+    bool broken_ = false; // файл не удалось обрезать после неудачной записи, журнал открыт, но не пишет
+    std::vector<char> buffer_; // запись в кодировке журнала
+
+    // кодирует запись и дописывает её в конец файла
+    void WriteRecord(const LogRecord &record);
+    // передаёт дописанные count записей ОС и сбрасывает журнал на диск, если набралась группа
+    void Commit(size_t count);
+    // отбрасывает недописанные байты и обрезает файл до размера size_
+    void Rollback();
+    // дописывает байты в конец файла
+    void WriteBytes(const void *data, size_t size);
+    void Check(bool condition) const;
+};
+
+// контрольная сумма CRC-32C (полином Кастаньоли)
+uint32_t ComputeCrc32c(const void *data, size_t size, uint32_t crc = 0);
@@ -0,0 +1,101 @@
+#include "active_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+ActiveIndex::Block::Block(size_t block_capacity)
+    : capacity(block_capacity), nodes(new Node[block_capacity]), slots(new atomic<uint64_t>[block_capacity * 2]) {
+    for (size_t slot = 0; slot < capacity * 2; ++slot) {
+        slots[slot].store(EMPTY_SLOT, memory_order_relaxed);
+    }
+}
+
+ActiveIndex::ActiveIndex(const ActiveIndex &other) : end_document_(other.end_document_) {
+    if (!other.block_) {
+        return;
+    }
+    // заполненные блоки больше не меняются и разделяются с копией, а последний копируется
+    const Block &source = *other.block_;
+    block_ = make_shared<Block>(source.capacity);
+    block_->size = source.size;
+    block_->previous = source.previous;
+    for (size_t position = 0; position < source.size; ++position) {
+        const Node &node = source.nodes[position];
+        Node &target = block_->nodes[position];
+        const uint32_t size = node.size.load(memory_order_relaxed);
+        target.size.store(size, memory_order_relaxed);
+        target.next = node.next;
+        copy_n(node.documents, size, target.documents);
+        copy_n(node.counts, size, target.counts);
+    }
+    for (size_t slot = 0; slot < source.capacity * 2; ++slot) {
+        block_->slots[slot].store(source.slots[slot].load(memory_order_relaxed), memory_order_relaxed);
+    }
+}
+
+ActiveIndex& ActiveIndex::operator=(const ActiveIndex &other) {
+    if (this != &other) {
+        ActiveIndex copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+void ActiveIndex::Add(uint32_t document, uint32_t term_id, uint32_t count) {
+    end_document_ = document + 1;
+    uint64_t value = EMPTY_SLOT;
+    size_t slot = block_ ? FindSlot(*block_, term_id, value) : 0;
+    if (value != EMPTY_SLOT) {
+        // дописываем вхождение в последний узел термина, если в нём есть место
+        Node &node = block_->nodes[static_cast<uint32_t>(value)];
+        const uint32_t size = node.size.load(memory_order_relaxed);
+        if (size < NODE_SIZE) {
+            node.documents[size] = document;
+            node.counts[size] = count;
+            node.size.store(size + 1, memory_order_release);
+            return;
+        }
+    }
+    if (!block_ || block_->size == block_->capacity) {
+        // список термина в новом блоке начинается заново, его прежние узлы остаются в предыдущих блоках
+        auto block = make_shared<Block>(block_ ? block_->capacity * 2 : INITIAL_CAPACITY);
+        block->previous = move(block_);
+        block_ = move(block);
+        slot = FindSlot(*block_, term_id, value);
+    }
+    const uint32_t position = static_cast<uint32_t>(block_->size++);
+    Node &node = block_->nodes[position];
+    node.next = value == EMPTY_SLOT ? NO_NODE : static_cast<uint32_t>(value);
+    node.documents[0] = document;
+    node.counts[0] = count;
+    node.size.store(1, memory_order_relaxed);
+    block_->slots[slot].store(uint64_t{term_id} << 32 | position, memory_order_release);
+}
+
+void ActiveIndex::Clear(uint32_t end_document) {
+    block_.reset();
+    end_document_ = end_document;
+}
+
+uint32_t ActiveIndex::GetEndDocument() const {
+    return end_document_;
+}
+
+ActiveIndex::View ActiveIndex::GetView() const {
+    View view;
+    view.block_ = block_;
+    return view;
+}
+
+size_t ActiveIndex::FindSlot(const Block &block, uint32_t term_id, uint64_t &value) {
+    // в блоке не больше capacity терминов, поэтому таблица заполнена не больше чем наполовину
+    const size_t mask = block.capacity * 2 - 1;
+    for (size_t slot = static_cast<size_t>((uint64_t{term_id} * 0x9E3779B97F4A7C15ull) >> 32) & mask;;
+         slot = (slot + 1) & mask) {
+        value = block.slots[slot].load(memory_order_acquire);
+        if (value == EMPTY_SLOT || static_cast<uint32_t>(value >> 32) == term_id) {
+            return slot;
+        }
+    }
+}
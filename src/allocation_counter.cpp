@@ -0,0 +1,61 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace {
+
+atomic<size_t> allocation_count{0};
+
+} // namespace
+
+size_t GetAllocationCount() {
+    return allocation_count.load(memory_order_relaxed);
+}
+
+// остальные формы new и delete (для массивов, nothrow) стандартная библиотека выражает через эти
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    if (void *const pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    const size_t align = static_cast<size_t>(alignment);
+#if defined(_WIN32)
+    void *const pointer = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+    // aligned_alloc требует размер, кратный выравниванию
+    void *const pointer = aligned_alloc(align, ((size == 0 ? 1 : size) + align - 1) / align * align);
+#endif
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, align_val_t) noexcept {
+#if defined(_WIN32)
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
+
+void operator delete(void *pointer, size_t, align_val_t alignment) noexcept {
+    operator delete(pointer, alignment);
+}
@@ -0,0 +1,198 @@
+#include "collection_statistics.h"
+
+#include <cmath>
+
+using namespace std;
+
+CollectionStatistics::TermStatistics::TermStatistics(const TermStatistics &other) {
+    *this = other;
+}
+
+CollectionStatistics::TermStatistics& CollectionStatistics::TermStatistics::operator=(const TermStatistics &other) {
+    for (size_t i = 0; i < 2; ++i) {
+        const TermValue &source = other.values[i];
+        values[i].first_version.store(source.first_version.load(memory_order_relaxed), memory_order_relaxed);
+        values[i].document_freq.store(source.document_freq.load(memory_order_relaxed), memory_order_relaxed);
+        values[i].log_document_freq.store(source.log_document_freq.load(memory_order_relaxed),
+                                          memory_order_relaxed);
+    }
+    return *this;
+}
+
+CollectionStatistics::TermValue& CollectionStatistics::TermStatistics::Current() {
+    return values[values[1].first_version.load(memory_order_relaxed) >
+                  values[0].first_version.load(memory_order_relaxed) ? 1 : 0];
+}
+
+const CollectionStatistics::TermValue& CollectionStatistics::TermStatistics::Current() const {
+    return const_cast<TermStatistics*>(this)->Current();
+}
+
+CollectionStatistics::CollectionStatistics(const CollectionStatistics &other)
+    : document_count_(other.document_count_), total_length_(other.total_length_),
+      log_document_count_(other.log_document_count_), terms_(other.terms_), changed_terms_(other.changed_terms_),
+      changed_count_(other.changed_count_.load(memory_order_relaxed)) {}
+
+CollectionStatistics::CollectionStatistics(CollectionStatistics &&other) noexcept
+    : document_count_(other.document_count_), total_length_(other.total_length_),
+      log_document_count_(other.log_document_count_), terms_(move(other.terms_)),
+      changed_terms_(move(other.changed_terms_)), changed_count_(other.changed_count_.load(memory_order_relaxed)) {}
+
+CollectionStatistics& CollectionStatistics::operator=(const CollectionStatistics &other) {
+    if (this != &other) {
+        CollectionStatistics copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+CollectionStatistics& CollectionStatistics::operator=(CollectionStatistics &&other) noexcept {
+    document_count_ = other.document_count_;
+    total_length_ = other.total_length_;
+    log_document_count_ = other.log_document_count_;
+    terms_ = move(other.terms_);
+    changed_terms_ = move(other.changed_terms_);
+    changed_count_.store(other.changed_count_.load(memory_order_relaxed), memory_order_relaxed);
+    return *this;
+}
+
+int CollectionStatistics::GetDocumentCount() const {
+    return document_count_;
+}
+
+uint64_t CollectionStatistics::GetTotalLength() const {
+    return total_length_;
+}
+
+double CollectionStatistics::GetAverageDocumentLength() const {
+    if (document_count_ == 0) {
+        return 0;
+    }
+    return static_cast<double>(total_length_) / document_count_;
+}
+
+size_t CollectionStatistics::GetTermCount() const {
+    return terms_.size();
+}
+
+uint32_t CollectionStatistics::GetDocumentFreq(uint32_t term_id) const {
+    return term_id < terms_.size() ? terms_[term_id].Current().document_freq.load(memory_order_relaxed) : 0;
+}
+
+double CollectionStatistics::GetInverseDocumentFreq(uint32_t term_id) const {
+    if (GetDocumentFreq(term_id) == 0) {
+        return 0;
+    }
+    return log_document_count_ - terms_[term_id].Current().log_document_freq.load(memory_order_relaxed);
+}
+
+void CollectionStatistics::AddDocument(uint32_t length) {
+    ++document_count_;
+    total_length_ += length;
+    log_document_count_ = log(static_cast<double>(document_count_));
+}
+
+void CollectionStatistics::RemoveDocument(uint32_t length) {
+    --document_count_;
+    total_length_ -= length;
+    log_document_count_ = document_count_ > 0 ? log(static_cast<double>(document_count_)) : 0;
+}
+
+void CollectionStatistics::AddDocuments(uint32_t document_count, uint64_t total_length) {
+    document_count_ += static_cast<int>(document_count);
+    total_length_ += total_length;
+    log_document_count_ = document_count_ > 0 ? log(static_cast<double>(document_count_)) : 0;
+}
+
+void CollectionStatistics::ResizeTerms(size_t term_count) {
+    // новые термины без документов не меняют частот, которые читают версии
+    if (terms_.size() < term_count) {
+        terms_.resize(term_count);
+        changed_terms_.resize(term_count);
+    }
+}
+
+void CollectionStatistics::AddTermDocument(uint32_t term_id) {
+    AddTermDocuments(term_id, 1);
+}
+
+void CollectionStatistics::AddTermDocuments(uint32_t term_id, uint32_t document_count) {
+    SetDocumentFreq(term_id, GetDocumentFreq(term_id) + document_count);
+}
+
+void CollectionStatistics::RemoveTermDocuments(uint32_t term_id, uint32_t document_count) {
+    SetDocumentFreq(term_id, GetDocumentFreq(term_id) - document_count);
+}
+
+void CollectionStatistics::Publish(uint64_t version) {
+    // значения, записанные до метки, видны версии, прочитавшей метку
+    const size_t changed_count = changed_count_.load(memory_order_relaxed);
+    for (size_t i = 0; i < changed_count; ++i) {
+        terms_[changed_terms_[i]].Current().first_version.store(version, memory_order_release);
+    }
+    changed_count_.store(0, memory_order_relaxed);
+}
+
+CollectionStatistics::View CollectionStatistics::GetView() const {
+    View view;
+    view.document_count_ = document_count_;
+    view.total_length_ = total_length_;
+    view.terms_ = terms_.GetBuffer();
+    view.term_count_ = terms_.size();
+    return view;
+}
+
+void CollectionStatistics::SetDocumentFreq(uint32_t term_id, uint32_t document_freq) {
+    TermStatistics &term = terms_[term_id];
+    TermValue *value = &term.Current();
+    if (value->first_version.load(memory_order_relaxed) != CHANGING) {
+        // первое изменение термина после публикации переписывает более старое значение. Метка снимается
+        // до записи частоты: версия, прочитавшая новую частоту, увидит снятую метку при повторной проверке
+        // (как в seqlock)
+        value = &term.values[value == &term.values[0] ? 1 : 0];
+        value->first_version.store(CHANGING, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        changed_terms_[changed_count_.fetch_add(1, memory_order_relaxed)] = term_id;
+    }
+    value->document_freq.store(document_freq, memory_order_relaxed);
+    value->log_document_freq.store(document_freq > 0 ? log(static_cast<double>(document_freq)) : 0,
+                                   memory_order_relaxed);
+}
+
+int CollectionStatistics::View::GetDocumentCount() const {
+    return document_count_;
+}
+
+uint64_t CollectionStatistics::View::GetTotalLength() const {
+    return total_length_;
+}
+
+double CollectionStatistics::View::GetAverageDocumentLength() const {
+    if (document_count_ == 0) {
+        return 0;
+    }
+    return static_cast<double>(total_length_) / document_count_;
+}
+
+bool CollectionStatistics::View::ReadTerm(uint64_t version, uint32_t term_id, uint32_t &document_freq,
+                                          double &log_document_freq) const {
+    if (term_id >= term_count_) {
+        return false;
+    }
+    // значение версии - самое новое из тех, что действуют не позже неё
+    const TermValue (&values)[2] = terms_[term_id].values;
+    const uint64_t first_versions[2] = {values[0].first_version.load(memory_order_acquire),
+                                        values[1].first_version.load(memory_order_acquire)};
+    size_t index = first_versions[1] > first_versions[0] ? 1 : 0;
+    if (first_versions[index] > version) {
+        index = 1 - index;
+        if (first_versions[index] > version) {
+            return false;
+        }
+    }
+    document_freq = values[index].document_freq.load(memory_order_relaxed);
+    log_document_freq = values[index].log_document_freq.load(memory_order_relaxed);
+    // если сервер начал переписывать значение, пока оно читалось, прочитанное могло смешать два значения
+    atomic_thread_fence(memory_order_acquire);
+    return values[index].first_version.load(memory_order_relaxed) == first_versions[index];
+}
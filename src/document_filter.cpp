@@ -0,0 +1,72 @@
+#include "document_filter.h"
+
+#include <algorithm>
+
+using namespace std;
+
+DocumentFilter::DocumentFilter(DocumentStatus status) {
+    SetStatuses({status});
+}
+
+DocumentFilter& DocumentFilter::SetStatuses(initializer_list<DocumentStatus> statuses) {
+    status_mask_ = 0;
+    for (const DocumentStatus status : statuses) {
+        status_mask_ |= 1u << static_cast<uint32_t>(status);
+    }
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetRatingRange(int min_rating, int max_rating) {
+    min_rating_ = min_rating;
+    max_rating_ = max_rating;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetIdRange(int min_id, int max_id) {
+    min_id_ = min_id;
+    max_id_ = max_id;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetIds(vector<int> ids) {
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    ids_ = move(ids);
+    has_ids_ = true;
+    return *this;
+}
+
+uint32_t DocumentFilter::GetStatusMask() const {
+    return status_mask_;
+}
+
+int DocumentFilter::GetMinRating() const {
+    return min_rating_;
+}
+
+int DocumentFilter::GetMaxRating() const {
+    return max_rating_;
+}
+
+int DocumentFilter::GetMinId() const {
+    return min_id_;
+}
+
+int DocumentFilter::GetMaxId() const {
+    return max_id_;
+}
+
+bool DocumentFilter::HasIds() const {
+    return has_ids_;
+}
+
+const vector<int>& DocumentFilter::GetIds() const {
+    return ids_;
+}
+
+bool DocumentFilter::operator()(int document_id, DocumentStatus status, int rating) const {
+    return ((status_mask_ >> static_cast<uint32_t>(status)) & 1) != 0 &&
+           rating >= min_rating_ && rating <= max_rating_ &&
+           document_id >= min_id_ && document_id <= max_id_ &&
+           (!has_ids_ || binary_search(ids_.begin(), ids_.end(), document_id));
+}
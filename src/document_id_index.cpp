@@ -0,0 +1,94 @@
+#include "document_id_index.h"
+
+using namespace std;
+
+DocumentIdIndex::DocumentIdIndex() : slots_(MakeSlots(INITIAL_SLOT_COUNT)), slot_count_(INITIAL_SLOT_COUNT) {}
+
+DocumentIdIndex::DocumentIdIndex(const DocumentIdIndex &other)
+    : slots_(MakeSlots(other.slot_count_)), slot_count_(other.slot_count_), size_(other.size_) {
+    for (size_t slot = 0; slot < slot_count_; ++slot) {
+        slots_.get()[slot].store(other.slots_.get()[slot].load(memory_order_relaxed), memory_order_relaxed);
+    }
+}
+
+DocumentIdIndex& DocumentIdIndex::operator=(const DocumentIdIndex &other) {
+    if (this != &other) {
+        DocumentIdIndex copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+void DocumentIdIndex::Add(int document_id, uint32_t internal_id) {
+    // держим заполненность таблицы не выше 1/2; новая таблица заполняется заново, старая остаётся у View
+    if ((size_ + 1) * 2 > slot_count_) {
+        const size_t slot_count = slot_count_ * 2;
+        Slots slots = MakeSlots(slot_count);
+        for (size_t slot = 0; slot < slot_count_; ++slot) {
+            const uint64_t value = slots_.get()[slot].load(memory_order_relaxed);
+            if (value != EMPTY_SLOT) {
+                Insert(slots, slot_count, value);
+            }
+        }
+        slots_ = move(slots);
+        slot_count_ = slot_count;
+    }
+    Insert(slots_, slot_count_, uint64_t{static_cast<uint32_t>(document_id)} << 32 | internal_id);
+    ++size_;
+}
+
+uint32_t DocumentIdIndex::Find(int document_id) const {
+    return Find(slots_.get(), slot_count_, document_id, NO_DOCUMENT);
+}
+
+DocumentIdIndex::View DocumentIdIndex::GetView() const {
+    View view;
+    view.slots_ = slots_;
+    view.slot_count_ = slot_count_;
+    return view;
+}
+
+uint32_t DocumentIdIndex::View::Find(int document_id, uint32_t document_end) const {
+    return DocumentIdIndex::Find(slots_.get(), slot_count_, document_id, document_end);
+}
+
+size_t DocumentIdIndex::Hash(uint32_t document_id) {
+    // мультипликативное хэширование: id документов часто идут подряд
+    return static_cast<size_t>((uint64_t{document_id} * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+uint32_t DocumentIdIndex::Find(const atomic<uint64_t> *slots, size_t slot_count, int document_id,
+                               uint32_t document_end) {
+    const uint32_t key = static_cast<uint32_t>(document_id);
+    const size_t mask = slot_count - 1;
+    // записи одного документа лежат на одном пути, просматриваем его до пустой ячейки
+    uint32_t found = NO_DOCUMENT;
+    for (size_t slot = Hash(key) & mask;; slot = (slot + 1) & mask) {
+        const uint64_t value = slots[slot].load(memory_order_relaxed);
+        if (value == EMPTY_SLOT) {
+            return found;
+        }
+        const uint32_t internal_id = static_cast<uint32_t>(value);
+        if (static_cast<uint32_t>(value >> 32) == key && internal_id < document_end &&
+            (found == NO_DOCUMENT || internal_id > found)) {
+            found = internal_id;
+        }
+    }
+}
+
+DocumentIdIndex::Slots DocumentIdIndex::MakeSlots(size_t slot_count) {
+    Slots slots(new atomic<uint64_t>[slot_count]);
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        slots.get()[slot].store(EMPTY_SLOT, memory_order_relaxed);
+    }
+    return slots;
+}
+
+void DocumentIdIndex::Insert(const Slots &slots, size_t slot_count, uint64_t value) {
+    const size_t mask = slot_count - 1;
+    size_t slot = Hash(static_cast<uint32_t>(value >> 32)) & mask;
+    while (slots.get()[slot].load(memory_order_relaxed) != EMPTY_SLOT) {
+        slot = (slot + 1) & mask;
+    }
+    slots.get()[slot].store(value, memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+#include "epoch.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t NOT_PINNED = numeric_limits<uint64_t>::max(); // поток сейчас ничего не читает
+
+atomic<uint64_t> global_epoch{1};
+
+} // namespace
+
+// запись потока в общем списке: эпоха, закреплённая потоком. Записи не удаляются, а переходят
+// к новым потокам после завершения своих
+struct EpochGuard::ThreadRecord {
+    atomic<uint64_t> epoch{NOT_PINNED};
+    atomic<bool> in_use{true};
+    ThreadRecord *next = nullptr;
+    size_t depth = 0; // кол-во вложенных EpochGuard потока, меняется только самим потоком
+};
+
+namespace {
+
+atomic<EpochGuard::ThreadRecord*> thread_records{nullptr};
+
+EpochGuard::ThreadRecord* AcquireRecord() {
+    for (EpochGuard::ThreadRecord *record = thread_records.load(); record != nullptr; record = record->next) {
+        bool in_use = false;
+        if (!record->in_use.load() && record->in_use.compare_exchange_strong(in_use, true)) {
+            return record;
+        }
+    }
+    auto *record = new EpochGuard::ThreadRecord;
+    record->next = thread_records.load();
+    while (!thread_records.compare_exchange_weak(record->next, record)) {
+    }
+    return record;
+}
+
+// запись потока берётся при первом чтении и освобождается при завершении потока
+class ThreadRecordHolder {
+public:
+    ThreadRecordHolder() : record_(AcquireRecord()) {}
+    ~ThreadRecordHolder() {
+        record_->in_use.store(false);
+    }
+    ThreadRecordHolder(const ThreadRecordHolder &) = delete;
+    ThreadRecordHolder& operator=(const ThreadRecordHolder &) = delete;
+
+    EpochGuard::ThreadRecord& Get() {
+        return *record_;
+    }
+
+private:
+    EpochGuard::ThreadRecord *record_;
+};
+
+EpochGuard::ThreadRecord& ThisThreadRecord() {
+    thread_local ThreadRecordHolder holder;
+    return holder.Get();
+}
+
+} // namespace
+
+EpochGuard::EpochGuard() : record_(ThisThreadRecord()) {
+    // вложенные EpochGuard оставляют закреплённой эпоху внешнего: она не новее текущей
+    if (record_.depth++ == 0) {
+        record_.epoch.store(global_epoch.load());
+    }
+}
+
+EpochGuard::~EpochGuard() {
+    if (--record_.depth == 0) {
+        record_.epoch.store(NOT_PINNED);
+    }
+}
+
+uint64_t AdvanceEpoch() {
+    return global_epoch.fetch_add(1) + 1;
+}
+
+uint64_t GetOldestPinnedEpoch() {
+    uint64_t oldest = NOT_PINNED;
+    for (const EpochGuard::ThreadRecord *record = thread_records.load(); record != nullptr; record = record->next) {
+        oldest = min(oldest, record->epoch.load());
+    }
+    return oldest;
+}
@@ -0,0 +1,202 @@
+#include "index_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const char INDEX_FILE_MAGIC[8] = {'S', 'R', 'V', 'I', 'N', 'D', 'E', 'X'};
+const uint32_t INDEX_FORMAT_VERSION = 2;
+const uint32_t BYTE_ORDER_MARK = 0x01020304; // в файле другого порядка байт читается иначе
+
+// заголовок в начале файла
+struct FileHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t byte_order;
+    uint32_t size_t_size;
+    uint32_t section_count;
+    uint64_t directory_offset; // смещение таблицы разделов
+    uint64_t file_size;
+};
+
+// отображает файл в память и возвращает отображение во владение, а в size - его размер
+shared_ptr<char> MapFile(const string &path, size_t &size) {
+#if defined(_WIN32)
+    // без mmap файл читается в память целиком
+    ifstream in(path, ios::binary);
+    if (!in) {
+        throw runtime_error("Can't open index file "s + path);
+    }
+    const vector<char> content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    size = content.size();
+    shared_ptr<char> data(new char[max<size_t>(size, 1)], default_delete<char[]>());
+    copy(content.begin(), content.end(), data.get());
+    return data;
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Can't open index file "s + path);
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+        close(fd);
+        throw runtime_error("Can't read index file "s + path);
+    }
+    size = static_cast<size_t>(status.st_size);
+    void *const data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // отображение держит файл само, дескриптор больше не нужен
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw runtime_error("Can't map index file "s + path);
+    }
+    return shared_ptr<char>(static_cast<char*>(data), [size](char *pointer) {
+        munmap(pointer, size);
+    });
+#endif
+}
+
+// сбрасывает на диск файл или каталог; false, если это не удалось
+bool SyncPath(const string &path) {
+#if defined(_WIN32)
+    // без fsync остаётся сброс при закрытии файла средствами ОС
+    static_cast<void>(path);
+    return true;
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+#endif
+}
+
+} // namespace
+
+void CheckIndexFile(bool condition) {
+    if (!condition) {
+        throw runtime_error("Index file is corrupted"s);
+    }
+}
+
+IndexFileWriter::IndexFileWriter(const string &path)
+    : path_(path), out_(path + ".tmp"s, ios::binary | ios::trunc) {
+    Check();
+    // заголовок пишется последним, когда известна таблица разделов; пока на его месте нули
+    const FileHeader header{};
+    WriteBytes(&header, sizeof(header), 1);
+}
+
+void IndexFileWriter::BeginSection(IndexSection section) {
+    if (in_section_) {
+        throw logic_error("Previous index file section is not finished"s);
+    }
+    WriteBytes(nullptr, 0, SECTION_ALIGNMENT);
+    sections_.push_back(IndexSectionEntry{static_cast<uint32_t>(section), 0, position_, 0});
+    in_section_ = true;
+}
+
+void IndexFileWriter::EndSection() {
+    sections_.back().size = position_ - sections_.back().offset;
+    in_section_ = false;
+}
+
+void IndexFileWriter::Finish() {
+    if (in_section_) {
+        throw logic_error("Index file section is not finished"s);
+    }
+    FileHeader header{};
+    memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic));
+    header.format_version = INDEX_FORMAT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.size_t_size = sizeof(size_t);
+    header.section_count = static_cast<uint32_t>(sections_.size());
+    header.directory_offset = WriteBytes(sections_.data(), sections_.size() * sizeof(IndexSectionEntry),
+                                         alignof(IndexSectionEntry));
+    header.file_size = position_;
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    Check();
+    // файл пишется рядом и подменяет прежний целиком: процессы, отобразившие прежний файл, продолжают читать его.
+    // Файл сбрасывается на диск до переименования, чтобы после сбоя под именем path не оказался недописанный файл,
+    // а каталог - после, чтобы переименование пережило сбой (на него полагается очистка журнала изменений)
+    const string directory = filesystem::absolute(path_).parent_path().string();
+    if (!SyncPath(path_ + ".tmp"s) || rename((path_ + ".tmp"s).c_str(), path_.c_str()) != 0 ||
+        !SyncPath(directory)) {
+        throw runtime_error("Can't write index file "s + path_);
+    }
+}
+
+uint64_t IndexFileWriter::WriteBytes(const void *data, size_t size, size_t alignment) {
+    static const char padding[SECTION_ALIGNMENT] = {};
+    const size_t padding_size = static_cast<size_t>((alignment - position_ % alignment) % alignment);
+    out_.write(padding, static_cast<streamsize>(padding_size));
+    const uint64_t offset = position_ + padding_size;
+    if (size > 0) {
+        out_.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+    }
+    position_ = offset + size;
+    Check();
+    return in_section_ ? offset - sections_.back().offset : offset;
+}
+
+void IndexFileWriter::Check() {
+    if (!out_) {
+        throw runtime_error("Can't write index file "s + path_);
+    }
+}
+
+IndexFile::IndexFile(const string &path)
+    : section_data_(static_cast<size_t>(IndexSection::COUNT), nullptr),
+      section_sizes_(static_cast<size_t>(IndexSection::COUNT), 0) {
+    storage_ = MapFile(path, size_);
+    FileHeader header;
+    CheckIndexFile(size_ >= sizeof(header));
+    memcpy(&header, storage_.get(), sizeof(header));
+    if (memcmp(header.magic, INDEX_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw runtime_error("Not an index file: "s + path);
+    }
+    if (header.format_version != INDEX_FORMAT_VERSION || header.byte_order != BYTE_ORDER_MARK ||
+        header.size_t_size != sizeof(size_t)) {
+        throw runtime_error("Unsupported index file format: "s + path);
+    }
+    CheckIndexFile(header.file_size == size_ && header.directory_offset <= size_ &&
+                   header.section_count <= (size_ - header.directory_offset) / sizeof(IndexSectionEntry));
+    for (uint32_t i = 0; i < header.section_count; ++i) {
+        IndexSectionEntry entry;
+        memcpy(&entry, storage_.get() + header.directory_offset + i * sizeof(IndexSectionEntry), sizeof(entry));
+        CheckIndexFile(entry.offset <= size_ && entry.size <= size_ - entry.offset);
+        // неизвестные разделы пропускаются
+        if (entry.id < section_data_.size()) {
+            section_data_[entry.id] = storage_.get() + entry.offset;
+            section_sizes_[entry.id] = static_cast<size_t>(entry.size);
+        }
+    }
+}
+
+const char* IndexFile::GetSection(IndexSection section, size_t &size) const {
+    const char *const data = section_data_[static_cast<size_t>(section)];
+    CheckIndexFile(data != nullptr);
+    size = section_sizes_[static_cast<size_t>(section)];
+    return data;
+}
+
+shared_ptr<const void> IndexFile::GetStorage() const {
+    return storage_;
+}
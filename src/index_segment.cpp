@@ -0,0 +1,164 @@
+#include "index_segment.h"
+
+#include <chrono>
+
+using namespace std;
+
+IndexSegment::IndexSegment(uint32_t first_document)
+    : first_document_(first_document), end_document_(first_document) {}
+
+uint32_t IndexSegment::GetFirstDocument() const {
+    return first_document_;
+}
+
+uint32_t IndexSegment::GetEndDocument() const {
+    return end_document_;
+}
+
+uint32_t IndexSegment::GetDocumentCount() const {
+    return end_document_ - first_document_;
+}
+
+void IndexSegment::ExtendTo(uint32_t end_document) {
+    end_document_ = max(end_document_, end_document);
+}
+
+const PostingList* IndexSegment::FindPostings(uint32_t term_id) const {
+    if (term_id >= term_slots_.size() || term_slots_[term_id] == NO_SLOT) {
+        return nullptr;
+    }
+    return &postings_[term_slots_[term_id]];
+}
+
+PostingList* IndexSegment::FindPostings(uint32_t term_id) {
+    if (term_id >= term_slots_.size() || term_slots_[term_id] == NO_SLOT) {
+        return nullptr;
+    }
+    return &postings_[term_slots_[term_id]];
+}
+
+PostingList& IndexSegment::GetPostings(uint32_t term_id) {
+    if (term_id >= term_slots_.size()) {
+        term_slots_.resize(term_id + 1, NO_SLOT);
+    }
+    if (term_slots_[term_id] == NO_SLOT) {
+        term_slots_[term_id] = static_cast<uint32_t>(postings_.size());
+        slot_terms_.push_back(term_id);
+        postings_.emplace_back();
+    }
+    return postings_[term_slots_[term_id]];
+}
+
+void IndexSegment::Seal() {
+    // списки, из которых выброшены все документы, не нужны
+    size_t kept = 0;
+    for (size_t slot = 0; slot < postings_.size(); ++slot) {
+        if (postings_[slot].empty()) {
+            term_slots_[slot_terms_[slot]] = NO_SLOT;
+            continue;
+        }
+        if (kept != slot) {
+            postings_[kept] = move(postings_[slot]);
+            slot_terms_[kept] = slot_terms_[slot];
+        }
+        term_slots_[slot_terms_[kept]] = static_cast<uint32_t>(kept);
+        postings_[kept].Seal();
+        ++kept;
+    }
+    postings_.resize(kept);
+    slot_terms_.resize(kept);
+    term_slots_.shrink_to_fit();
+    slot_terms_.shrink_to_fit();
+    postings_.shrink_to_fit();
+}
+
+size_t IndexSegment::MemoryUsage() const {
+    size_t memory = sizeof(IndexSegment) + term_slots_.capacity() * sizeof(uint32_t) +
+                    slot_terms_.capacity() * sizeof(uint32_t) +
+                    (postings_.capacity() - postings_.size()) * sizeof(PostingList);
+    for (const PostingList &postings : postings_) {
+        memory += postings.MemoryUsage();
+    }
+    return memory;
+}
+
+IndexSegment IndexSegment::Merge(const vector<const IndexSegment*> &segments, const vector<uint64_t> &removed) {
+    IndexSegment merged(segments.empty() ? 0 : segments.front()->first_document_);
+    for (const IndexSegment *segment : segments) {
+        merged.ExtendTo(segment->end_document_);
+        segment->ForEachTerm([&merged, &removed](uint32_t term_id, const PostingList &postings) {
+            merged.GetPostings(term_id).Extend(postings, removed, merged.first_document_);
+        });
+    }
+    merged.Seal();
+    return merged;
+}
+
+vector<SegmentTermRecord> IndexSegment::Write(IndexFileWriter &writer) const {
+    vector<SegmentTermRecord> records;
+    records.reserve(postings_.size());
+    ForEachTerm([&writer, &records](uint32_t term_id, const PostingList &postings) {
+        records.push_back(SegmentTermRecord{term_id, 0, postings.Write(writer)});
+    });
+    return records;
+}
+
+IndexSegment IndexSegment::Map(const SegmentRecord &record, const IndexFile &file, size_t term_count) {
+    const auto terms = file.GetArray<SegmentTermRecord>(IndexSection::SEGMENT_TERMS);
+    CheckIndexFile(record.first_document <= record.end_document && record.term_begin <= terms.size &&
+                   record.term_count <= terms.size - record.term_begin);
+    size_t postings_size = 0;
+    const char *const postings = file.GetSection(IndexSection::POSTINGS, postings_size);
+
+    IndexSegment segment(record.first_document);
+    segment.ExtendTo(record.end_document);
+    segment.storage_ = file.GetStorage();
+    segment.term_slots_.assign(term_count, NO_SLOT);
+    segment.slot_terms_.reserve(static_cast<size_t>(record.term_count));
+    segment.postings_.reserve(static_cast<size_t>(record.term_count));
+    for (size_t i = 0; i < record.term_count; ++i) {
+        const SegmentTermRecord &term = terms.data.get()[record.term_begin + i];
+        CheckIndexFile(term.term_id < term_count && segment.term_slots_[term.term_id] == NO_SLOT);
+        segment.term_slots_[term.term_id] = static_cast<uint32_t>(segment.postings_.size());
+        segment.slot_terms_.push_back(term.term_id);
+        segment.postings_.push_back(PostingList::Map(term.postings, postings, postings_size, record.first_document,
+                                                     record.end_document));
+    }
+    return segment;
+}
+
+SegmentMerger::SegmentMerger(const SegmentMerger &) {}
+
+SegmentMerger& SegmentMerger::operator=(const SegmentMerger &) {
+    return *this;
+}
+
+bool SegmentMerger::IsRunning() const {
+    return result_.valid();
+}
+
+void SegmentMerger::Start(vector<shared_ptr<const IndexSegment>> inputs, vector<uint64_t> removed) {
+    if (IsRunning()) {
+        return;
+    }
+    inputs_ = move(inputs);
+    removed_ = move(removed);
+    result_ = async(launch::async, [segments = inputs_, removed = removed_]() {
+        vector<const IndexSegment*> pointers;
+        pointers.reserve(segments.size());
+        for (const auto &segment : segments) {
+            pointers.push_back(segment.get());
+        }
+        return make_shared<IndexSegment>(IndexSegment::Merge(pointers, removed));
+    });
+}
+
+optional<SegmentMerger::Result> SegmentMerger::Finish(bool wait) {
+    if (!IsRunning() || (!wait && result_.wait_for(chrono::seconds(0)) != future_status::ready)) {
+        return nullopt;
+    }
+    Result result{move(inputs_), result_.get(), move(removed_)};
+    inputs_.clear();
+    removed_.clear();
+    return result;
+}
@@ -0,0 +1,37 @@
+#include "match_results.h"
+
+using namespace std;
+
+MatchResults::Words::Words(const string_view *begin, const string_view *end) : begin_(begin), end_(end) {}
+
+const string_view* MatchResults::Words::begin() const {
+    return begin_;
+}
+
+const string_view* MatchResults::Words::end() const {
+    return end_;
+}
+
+size_t MatchResults::Words::size() const {
+    return static_cast<size_t>(end_ - begin_);
+}
+
+bool MatchResults::Words::empty() const {
+    return begin_ == end_;
+}
+
+string_view MatchResults::Words::operator[](size_t i) const {
+    return begin_[i];
+}
+
+size_t MatchResults::size() const {
+    return document_ids.size();
+}
+
+bool MatchResults::empty() const {
+    return document_ids.empty();
+}
+
+MatchResults::Words MatchResults::GetWords(size_t i) const {
+    return Words(words.data() + word_offsets[i], words.data() + word_offsets[i + 1]);
+}
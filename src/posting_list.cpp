@@ -0,0 +1,447 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// возвращает кол-во бит, необходимое для записи значения
+uint32_t BitWidth(uint32_t value) {
+    uint32_t bits = 0;
+    while (value != 0) {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+// дописывает значения в конец out, отводя на каждое bits бит
+void PackBits(const uint32_t *values, size_t size, uint32_t bits, vector<uint32_t> &out) {
+    if (bits == 0) {
+        return;
+    }
+    uint64_t buffer = 0;
+    uint32_t filled = 0;
+    for (size_t i = 0; i < size; ++i) {
+        buffer |= static_cast<uint64_t>(values[i]) << filled;
+        filled += bits;
+        if (filled >= 32) {
+            out.push_back(static_cast<uint32_t>(buffer));
+            buffer >>= 32;
+            filled -= 32;
+        }
+    }
+    if (filled > 0) {
+        out.push_back(static_cast<uint32_t>(buffer));
+    }
+}
+
+// читает size значений по bits бит, возвращает указатель на слово после прочитанных
+const uint32_t* UnpackBits(const uint32_t *in, size_t size, uint32_t bits, uint32_t *values) {
+    if (bits == 0) {
+        fill(values, values + size, 0u);
+        return in;
+    }
+    const uint64_t mask = (static_cast<uint64_t>(1) << bits) - 1;
+    uint64_t buffer = 0;
+    uint32_t available = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (available < bits) {
+            buffer |= static_cast<uint64_t>(*in++) << available;
+            available += 32;
+        }
+        values[i] = static_cast<uint32_t>(buffer & mask);
+        buffer >>= bits;
+        available -= bits;
+    }
+    return in;
+}
+
+// кол-во слов, которое занимают size значений по bits бит
+size_t WordsFor(size_t size, uint32_t bits) {
+    return (size * bits + 31) / 32;
+}
+
+// term_freq, округлённая до float вверх, чтобы оставаться верхней оценкой
+float TermFreqBound(uint32_t count, uint32_t document_length) {
+    const double term_freq = static_cast<double>(count) / static_cast<double>(document_length);
+    float bound = static_cast<float>(term_freq);
+    if (static_cast<double>(bound) < term_freq) {
+        bound = nextafter(bound, numeric_limits<float>::infinity());
+    }
+    return bound;
+}
+
+} // namespace
+
+PostingList::Cursor::Cursor(const PostingList &postings, uint32_t tag_mask)
+    : postings_(&postings), tag_mask_(tag_mask) {
+    LoadBlock(0);
+}
+
+bool PostingList::Cursor::AtEnd() const {
+    return position_ == size_;
+}
+
+uint32_t PostingList::Cursor::Document() const {
+    return Data()[position_].document;
+}
+
+uint32_t PostingList::Cursor::Count() const {
+    return Data()[position_].count;
+}
+
+uint32_t PostingList::Cursor::Tag() const {
+    return Data()[position_].tag;
+}
+
+void PostingList::Cursor::Next() {
+    ++position_;
+    if (position_ == size_ && block_ < postings_->BlockCount()) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+void PostingList::Cursor::NextGeq(uint32_t document) {
+    if (AtEnd() || Document() >= document) {
+        return;
+    }
+    // блоки, все документы которых меньше искомого, пропускаем не распаковывая
+    const size_t block = FindBlock(document);
+    if (block != block_) {
+        LoadBlock(block);
+    }
+    const Posting *data = Data();
+    position_ = static_cast<size_t>(lower_bound(data + position_, data + size_, document,
+                                                [](const Posting &posting, uint32_t id) {
+        return posting.document < id;
+    }) - data);
+    if (position_ == size_ && block_ < postings_->BlockCount()) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+float PostingList::Cursor::BlockMaxTermFreq(uint32_t document) const {
+    const size_t block = FindBlock(document);
+    return block < postings_->BlockCount() ? postings_->Blocks()[block].max_term_freq
+                                           : postings_->tail_max_term_freq_;
+}
+
+const PostingList::Posting* PostingList::Cursor::Data() const {
+    return buffered_ ? buffer_ : postings_->tail_.data();
+}
+
+void PostingList::Cursor::LoadBlock(size_t block) {
+    const BlockHeader *const blocks = postings_->Blocks();
+    // после удалений в блоке может не остаться вхождений с нужными метками, тогда идём дальше
+    for (block_ = block; block_ < postings_->BlockCount(); ++block_) {
+        if ((blocks[block_].tag_mask & tag_mask_) == 0) {
+            continue;
+        }
+        size_ = postings_->DecodeBlock(blocks[block_], buffer_);
+        buffered_ = true;
+        position_ = 0;
+        if ((blocks[block_].tag_mask & ~tag_mask_) != 0) {
+            FilterBuffer();
+        }
+        if (size_ > 0) {
+            return;
+        }
+    }
+    // недописанный блок читаем на месте, если фильтровать в нём нечего
+    position_ = 0;
+    size_ = postings_->tail_.size();
+    buffered_ = (postings_->tail_tag_mask_ & ~tag_mask_) != 0;
+    if (buffered_) {
+        copy(postings_->tail_.begin(), postings_->tail_.end(), buffer_);
+        FilterBuffer();
+    }
+}
+
+void PostingList::Cursor::FilterBuffer() {
+    const Posting *const end = remove_if(buffer_, buffer_ + size_, [this](const Posting &posting) {
+        return ((tag_mask_ >> posting.tag) & 1) == 0;
+    });
+    size_ = static_cast<size_t>(end - buffer_);
+}
+
+size_t PostingList::Cursor::FindBlock(uint32_t document) const {
+    const BlockHeader *const blocks = postings_->Blocks();
+    const size_t block_count = postings_->BlockCount();
+    if (block_ >= block_count || blocks[block_].last_document >= document) {
+        return block_;
+    }
+    return static_cast<size_t>(lower_bound(blocks + block_ + 1, blocks + block_count, document,
+                                           [](const BlockHeader &header, uint32_t id) {
+        return header.last_document < id;
+    }) - blocks);
+}
+
+void PostingList::Append(uint32_t document, uint32_t count, uint32_t document_length, uint32_t tag) {
+    if (tag >= TAG_COUNT) {
+        throw invalid_argument("Posting tag is out of range"s);
+    }
+    Detach();
+    AppendPosting(Posting{document, count, tag}, TermFreqBound(count, document_length));
+}
+
+void PostingList::Extend(const PostingList &other, const vector<uint64_t> &removed, uint32_t first_document) {
+    // полные блоки other без удалённых документов копируются как есть, пока свой недописанный блок пуст;
+    // вхождения остальных блоков дописываются по одному, чтобы блоки списка оставались полными.
+    // Оценка term_freq вхождения берётся по его блоку: она не меньше точной и остаётся верхней оценкой
+    Detach();
+    Posting postings[BLOCK_SIZE];
+    const BlockHeader *const blocks = other.Blocks();
+    for (size_t block = 0; block < other.BlockCount(); ++block) {
+        const BlockHeader &header = blocks[block];
+        if (tail_.empty() && header.size == BLOCK_SIZE &&
+            !HasMarked(removed, first_document, header.first_document, header.last_document)) {
+            BlockHeader copy = header;
+            copy.offset = static_cast<uint32_t>(data_.size());
+            const uint32_t *const begin = other.PackedData() + header.offset;
+            data_.insert(data_.end(), begin, begin + PackedWords(header));
+            blocks_.push_back(copy);
+            max_term_freq_ = max(max_term_freq_, header.max_term_freq);
+            size_ += BLOCK_SIZE;
+            continue;
+        }
+        const size_t size = other.DecodeBlock(header, postings);
+        for (size_t i = 0; i < size; ++i) {
+            if (!IsMarked(removed, first_document, postings[i].document)) {
+                AppendPosting(postings[i], header.max_term_freq);
+            }
+        }
+    }
+    for (const Posting &posting : other.tail_) {
+        if (!IsMarked(removed, first_document, posting.document)) {
+            AppendPosting(posting, other.tail_max_term_freq_);
+        }
+    }
+}
+
+void PostingList::Seal() {
+    if (tail_.empty() && mapped_blocks_ != nullptr) {
+        // отображённые блоки уже упакованы
+        return;
+    }
+    Detach();
+    PackTail();
+    blocks_.shrink_to_fit();
+    data_.shrink_to_fit();
+    tail_.shrink_to_fit();
+}
+
+void PostingList::AppendPosting(const Posting &posting, float term_freq_bound) {
+    tail_.push_back(posting);
+    tail_max_term_freq_ = max(tail_max_term_freq_, term_freq_bound);
+    tail_tag_mask_ |= 1u << posting.tag;
+    max_term_freq_ = max(max_term_freq_, term_freq_bound);
+    ++size_;
+    if (tail_.size() == BLOCK_SIZE) {
+        PackTail();
+    }
+}
+
+PostingsRecord PostingList::Write(IndexFileWriter &writer) const {
+    if (!tail_.empty()) {
+        PostingList sealed(*this);
+        sealed.Seal();
+        return sealed.Write(writer);
+    }
+    PostingsRecord record;
+    record.block_offset = writer.Write(Blocks(), BlockCount());
+    record.data_offset = writer.Write(PackedData(), PackedSize());
+    record.block_count = static_cast<uint32_t>(BlockCount());
+    record.data_size = static_cast<uint32_t>(PackedSize());
+    record.size = static_cast<uint32_t>(size_);
+    record.max_term_freq = max_term_freq_;
+    return record;
+}
+
+PostingList PostingList::Map(const PostingsRecord &record, const char *section, size_t section_size,
+                             uint32_t first_document, uint32_t end_document) {
+    CheckIndexFile(record.block_offset <= section_size && record.block_offset % alignof(BlockHeader) == 0 &&
+                   record.block_count <= (section_size - record.block_offset) / sizeof(BlockHeader) &&
+                   record.data_offset <= section_size && record.data_offset % alignof(uint32_t) == 0 &&
+                   record.data_size <= (section_size - record.data_offset) / sizeof(uint32_t));
+    PostingList postings;
+    postings.mapped_blocks_ = reinterpret_cast<const BlockHeader*>(section + record.block_offset);
+    postings.mapped_block_count_ = record.block_count;
+    postings.mapped_data_ = reinterpret_cast<const uint32_t*>(section + record.data_offset);
+    postings.mapped_data_size_ = record.data_size;
+    postings.max_term_freq_ = record.max_term_freq;
+    postings.size_ = record.size;
+
+    // открытие читает только заголовки блоков: их поля задают размеры буферов и границы чтения упакованных
+    // данных, поэтому проверяются здесь, а id документов внутри блока - при его распаковке (DecodeBlock)
+    CheckIndexFile(record.max_term_freq > 0.0f && record.max_term_freq <= 1.0f);
+    size_t size = 0;
+    for (size_t block = 0; block < record.block_count; ++block) {
+        const BlockHeader &header = postings.mapped_blocks_[block];
+        CheckIndexFile(header.size >= 1 && header.size <= BLOCK_SIZE && header.delta_bits <= 32 &&
+                       header.count_bits <= 32 && header.tag_bits <= BitWidth(TAG_COUNT - 1) &&
+                       header.tag_mask != 0 && BitWidth(header.tag_mask) <= (1u << header.tag_bits) &&
+                       header.max_term_freq > 0.0f && header.max_term_freq <= record.max_term_freq &&
+                       header.offset <= record.data_size &&
+                       PackedWords(header) <= record.data_size - header.offset &&
+                       header.first_document >= first_document && header.last_document < end_document &&
+                       header.first_document <= header.last_document &&
+                       (block == 0 || header.first_document > postings.mapped_blocks_[block - 1].last_document));
+        size += header.size;
+    }
+    CheckIndexFile(size == record.size);
+    return postings;
+}
+
+float PostingList::MaxTermFreq() const {
+    return max_term_freq_;
+}
+
+size_t PostingList::size() const {
+    return size_;
+}
+
+bool PostingList::empty() const {
+    return size_ == 0;
+}
+
+size_t PostingList::MemoryUsage() const {
+    return sizeof(*this) +
+           blocks_.capacity() * sizeof(BlockHeader) +
+           data_.capacity() * sizeof(uint32_t) +
+           tail_.capacity() * sizeof(Posting);
+}
+
+const PostingList::BlockHeader* PostingList::Blocks() const {
+    return mapped_blocks_ != nullptr ? mapped_blocks_ : blocks_.data();
+}
+
+size_t PostingList::BlockCount() const {
+    return mapped_blocks_ != nullptr ? mapped_block_count_ : blocks_.size();
+}
+
+const uint32_t* PostingList::PackedData() const {
+    return mapped_blocks_ != nullptr ? mapped_data_ : data_.data();
+}
+
+size_t PostingList::PackedSize() const {
+    return mapped_blocks_ != nullptr ? mapped_data_size_ : data_.size();
+}
+
+void PostingList::Detach() {
+    if (mapped_blocks_ == nullptr) {
+        return;
+    }
+    blocks_.assign(mapped_blocks_, mapped_blocks_ + mapped_block_count_);
+    data_.assign(mapped_data_, mapped_data_ + mapped_data_size_);
+    mapped_blocks_ = nullptr;
+    mapped_block_count_ = 0;
+    mapped_data_ = nullptr;
+    mapped_data_size_ = 0;
+}
+
+void PostingList::PackTail() {
+    if (tail_.empty()) {
+        return;
+    }
+    blocks_.push_back(PackBlock(tail_.data(), tail_.size(), tail_max_term_freq_, data_));
+    tail_.clear();
+    tail_max_term_freq_ = 0;
+    tail_tag_mask_ = 0;
+}
+
+PostingList::BlockHeader PostingList::PackBlock(const Posting *postings, size_t size, float max_term_freq,
+                                                vector<uint32_t> &out) {
+    uint32_t deltas[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    uint32_t tags[BLOCK_SIZE];
+    uint32_t max_delta = 0;
+    uint32_t max_count = 0;
+    uint32_t max_tag = 0;
+    uint32_t tag_mask = 0;
+    for (size_t i = 0; i < size; ++i) {
+        // соседние id различаются хотя бы на 1, а вхождений в документе хотя бы одно - храним без этой единицы
+        deltas[i] = i == 0 ? 0 : postings[i].document - postings[i - 1].document - 1;
+        counts[i] = postings[i].count - 1;
+        tags[i] = postings[i].tag;
+        max_delta = max(max_delta, deltas[i]);
+        max_count = max(max_count, counts[i]);
+        max_tag = max(max_tag, tags[i]);
+        tag_mask |= 1u << tags[i];
+    }
+
+    BlockHeader header;
+    header.first_document = postings[0].document;
+    header.last_document = postings[size - 1].document;
+    header.offset = static_cast<uint32_t>(out.size());
+    header.max_term_freq = max_term_freq;
+    header.size = static_cast<uint8_t>(size);
+    header.delta_bits = static_cast<uint8_t>(BitWidth(max_delta));
+    header.count_bits = static_cast<uint8_t>(BitWidth(max_count));
+    header.tag_bits = static_cast<uint8_t>(BitWidth(max_tag));
+    header.tag_mask = static_cast<uint8_t>(tag_mask);
+    PackBits(deltas + 1, size - 1, header.delta_bits, out);
+    PackBits(counts, size, header.count_bits, out);
+    PackBits(tags, size, header.tag_bits, out);
+    return header;
+}
+
+size_t PostingList::DecodeBlock(const BlockHeader &header, Posting *out) const {
+    uint32_t deltas[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    uint32_t tags[BLOCK_SIZE];
+    const size_t size = header.size;
+    const uint32_t *in = PackedData() + header.offset;
+    in = UnpackBits(in, size - 1, header.delta_bits, deltas);
+    in = UnpackBits(in, size, header.count_bits, counts);
+    UnpackBits(in, size, header.tag_bits, tags);
+
+    // id считаются в 64 битах: сумма разностей без переполнения сходится к last_document, только если все id
+    // блока возрастают и лежат в проверенных при открытии границах блока
+    uint64_t document = header.first_document;
+    uint32_t tag_mask = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (i > 0) {
+            document += uint64_t{deltas[i - 1]} + 1;
+        }
+        out[i] = Posting{static_cast<uint32_t>(document), counts[i] + 1, tags[i]};
+        tag_mask |= 1u << tags[i];
+    }
+    if (mapped_blocks_ != nullptr) {
+        CheckIndexFile(document == header.last_document && tag_mask == header.tag_mask);
+    }
+    return size;
+}
+
+size_t PostingList::PackedWords(const BlockHeader &header) {
+    return WordsFor(header.size - 1u, header.delta_bits) + WordsFor(header.size, header.count_bits) +
+           WordsFor(header.size, header.tag_bits);
+}
+
+bool PostingList::IsMarked(const vector<uint64_t> &removed, uint32_t first_document, uint32_t document) {
+    const size_t offset = document - first_document;
+    return offset / 64 < removed.size() && ((removed[offset / 64] >> (offset % 64)) & 1) != 0;
+}
+
+bool PostingList::HasMarked(const vector<uint64_t> &removed, uint32_t first_document, uint32_t first,
+                            uint32_t last) {
+    const size_t first_offset = first - first_document;
+    const size_t last_offset = min<size_t>(last - first_document, removed.size() * 64);
+    for (size_t offset = first_offset; offset <= last_offset && offset / 64 < removed.size();
+         offset = (offset / 64 + 1) * 64) {
+        // биты слова от offset до last_offset
+        uint64_t bits = removed[offset / 64] >> (offset % 64);
+        if (last_offset / 64 == offset / 64) {
+            bits &= ~uint64_t{0} >> (63 - last_offset % 64 + offset % 64);
+        }
+        if (bits != 0) {
+            return true;
+        }
+    }
+    return false;
+}
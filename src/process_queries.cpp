@@ -4,13 +4,9 @@
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer &search_server,
                                                     const std::vector<std::string> &queries) {
-    std::vector<std::vector<Document>> result(queries.size());
-
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(),
-                   [&search_server](auto &query) {
-        return search_server.FindTopDocuments(query);
-    });
-    return result;
+    // слова, общие для запросов пакета, распаковываются один раз на весь пакет; маленький пакет
+    // дешевле раздачи потокам, поэтому сервер сам решает, искать ли его параллельно
+    return search_server.FindTopDocumentsBatch(adaptive_execution, queries);
 }
 
 VectorWrapper ProcessQueriesJoined(const SearchServer &search_server,
@@ -19,46 +15,40 @@ VectorWrapper ProcessQueriesJoined(const SearchServer &search_server,
 }
 
 
-VectorWrapper::BasicIterator::BasicIterator(const std::vector<std::vector<Document>> &c) : data_(c) {
-    size_ = c.size();
-    segment_ = 0;
-    offset_ = 0;
+VectorWrapper::BasicIterator::BasicIterator(const std::vector<std::vector<Document>> *data,
+                                            size_t segment, size_t offset) noexcept
+    : data_(data), segment_(segment), offset_(offset) {
+    SkipEmpty();
 }
 
-VectorWrapper::BasicIterator::BasicIterator(const std::vector<std::vector<Document>> &c,
-                                            size_t segment, size_t offset) : data_(c) {
-    size_ = c.size();
-    segment_ = segment;
-    offset_ = offset;
+void VectorWrapper::BasicIterator::SkipEmpty() noexcept {
+    while (segment_ < data_->size() && offset_ == (*data_)[segment_].size()) {
+        ++segment_;
+        offset_ = 0;
+    }
 }
 
-[[nodiscard]] bool VectorWrapper::BasicIterator::operator==(const BasicIterator& rhs) const noexcept{
-    return  (data_ == rhs.data_) &&
-            (segment_ == rhs.segment_) &&
-            (offset_ == rhs.offset_) &&
-            (size_ == rhs.size_);
+[[nodiscard]] bool VectorWrapper::BasicIterator::operator==(const BasicIterator& rhs) const noexcept {
+    return (data_ == rhs.data_) &&
+           (segment_ == rhs.segment_) &&
+           (offset_ == rhs.offset_);
 }
 
 [[nodiscard]] bool VectorWrapper::BasicIterator::operator!=(const BasicIterator& rhs) const noexcept {
     return !(*this == rhs);
 }
 
-[[nodiscard]] Document VectorWrapper::BasicIterator::operator*() const noexcept {
-    return data_[segment_][offset_];
+[[nodiscard]] const Document& VectorWrapper::BasicIterator::operator*() const noexcept {
+    return (*data_)[segment_][offset_];
+}
+
+[[nodiscard]] const Document* VectorWrapper::BasicIterator::operator->() const noexcept {
+    return &**this;
 }
 
 VectorWrapper::BasicIterator& VectorWrapper::BasicIterator::operator++() noexcept {
-    if (offset_ < (data_[segment_].size() - 1)) {
-        ++offset_;
-    } else {
-        if (segment_ < (size_ - 1)) {
-            ++segment_;
-            offset_ = 0;
-        }
-        else {
-            ++offset_;
-        }
-    }
+    ++offset_;
+    SkipEmpty();
     return *this;
 }
 
@@ -68,6 +58,8 @@ VectorWrapper::BasicIterator VectorWrapper::BasicIterator::operator++(int) noexc
     return old_value;
 }
 
-VectorWrapper::VectorWrapper(std::vector<std::vector<Document>> &&data) {
-    data_ = std::move(data);
+VectorWrapper::VectorWrapper(std::vector<std::vector<Document>> &&data) : data_(std::move(data)) {
+    for (const std::vector<Document> &documents : data_) {
+        size_ += documents.size();
+    }
 }
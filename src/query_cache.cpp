@@ -0,0 +1,115 @@
+#include "query_cache.h"
+
+#include <functional>
+
+using namespace std;
+
+QueryCache::QueryCache(size_t capacity) : storage_(make_shared<Storage>()) {
+    SetCapacity(capacity);
+}
+
+QueryCache::QueryCache(const QueryCache &other) : QueryCache(other.capacity_) {}
+
+QueryCache& QueryCache::operator=(const QueryCache &other) {
+    if (this != &other) {
+        QueryCache copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+void QueryCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    const size_t shard_capacity = (capacity + SHARD_COUNT - 1) / SHARD_COUNT;
+    storage_->shard_capacity.store(shard_capacity, memory_order_relaxed);
+    for (Shard &shard : storage_->shards) {
+        const lock_guard lock(shard.mutex);
+        Evict(shard, shard_capacity);
+    }
+}
+
+size_t QueryCache::GetCapacity() const {
+    return capacity_;
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+    Stats stats;
+    for (Shard &shard : storage_->shards) {
+        const lock_guard lock(shard.mutex);
+        stats.hits += shard.stats.hits;
+        stats.misses += shard.stats.misses;
+    }
+    return stats;
+}
+
+QueryCache::View QueryCache::GetView() const {
+    View view;
+    view.storage_ = storage_;
+    return view;
+}
+
+QueryCache::Shard& QueryCache::GetShard(Storage &storage, string_view raw_query) {
+    return storage.shards[hash<string_view>()(raw_query) % SHARD_COUNT];
+}
+
+void QueryCache::Evict(Shard &shard, size_t shard_capacity) {
+    while (shard.entries.size() > shard_capacity) {
+        shard.index.erase(shard.entries.back().raw_query);
+        shard.entries.pop_back();
+    }
+}
+
+bool QueryCache::View::Find(string_view raw_query, size_t term_count, vector<uint32_t> &plus_terms,
+                            vector<uint32_t> &minus_terms) const {
+    if (storage_ == nullptr || storage_->shard_capacity.load(memory_order_relaxed) == 0 ||
+        raw_query.size() > MAX_QUERY_SIZE) {
+        return false;
+    }
+    Shard &shard = GetShard(*storage_, raw_query);
+    const lock_guard lock(shard.mutex);
+    const auto it = shard.index.find(raw_query);
+    if (it == shard.index.end()) {
+        ++shard.stats.misses;
+        return false;
+    }
+    if (it->second->term_count != term_count) {
+        // запрос разобран по другому размеру словаря: слова, которых тогда не было, теперь могут найтись
+        ++shard.stats.misses;
+        return false;
+    }
+    // запись становится недавно использованной
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    const Entry &entry = shard.entries.front();
+    plus_terms.assign(entry.plus_terms.begin(), entry.plus_terms.end());
+    minus_terms.assign(entry.minus_terms.begin(), entry.minus_terms.end());
+    ++shard.stats.hits;
+    return true;
+}
+
+void QueryCache::View::Insert(string_view raw_query, size_t term_count, const vector<uint32_t> &plus_terms,
+                              const vector<uint32_t> &minus_terms) const {
+    if (storage_ == nullptr || raw_query.size() > MAX_QUERY_SIZE) {
+        return;
+    }
+    const size_t shard_capacity = storage_->shard_capacity.load(memory_order_relaxed);
+    if (shard_capacity == 0) {
+        return;
+    }
+    Shard &shard = GetShard(*storage_, raw_query);
+    const lock_guard lock(shard.mutex);
+    const auto it = shard.index.find(raw_query);
+    if (it != shard.index.end()) {
+        // запрос уже записан другим потоком или разобран по старому словарю: разбор по большему словарю новее
+        Entry &entry = *it->second;
+        if (entry.term_count < term_count) {
+            entry.term_count = term_count;
+            entry.plus_terms = plus_terms;
+            entry.minus_terms = minus_terms;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    shard.entries.push_front(Entry{string(raw_query), term_count, plus_terms, minus_terms});
+    shard.index.emplace(shard.entries.front().raw_query, shard.entries.begin());
+    Evict(shard, shard_capacity);
+}
@@ -0,0 +1,73 @@
+#include "query_planner.h"
+
+#include <algorithm>
+
+using namespace std;
+
+QueryPlanner::QueryPlanner() : storage_(make_shared<Storage>()) {}
+
+QueryPlanner::QueryPlanner(const QueryPlanner &other) : QueryPlanner() {
+    SetThresholds(other.storage_->cost_per_thread.load(memory_order_relaxed),
+                  other.storage_->selection_size.load(memory_order_relaxed));
+}
+
+QueryPlanner& QueryPlanner::operator=(const QueryPlanner &other) {
+    if (this != &other) {
+        QueryPlanner copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+void QueryPlanner::SetThresholds(uint64_t cost_per_thread, size_t selection_size) {
+    storage_->cost_per_thread.store(max<uint64_t>(cost_per_thread, 1), memory_order_relaxed);
+    storage_->selection_size.store(max<size_t>(selection_size, 1), memory_order_relaxed);
+}
+
+QueryPlanner::Stats QueryPlanner::GetStats() const {
+    Stats stats;
+    stats.sequential_queries = storage_->sequential_queries.load(memory_order_relaxed);
+    stats.parallel_queries = storage_->parallel_queries.load(memory_order_relaxed);
+    stats.parallel_threads = storage_->parallel_threads.load(memory_order_relaxed);
+    stats.parallel_selections = storage_->parallel_selections.load(memory_order_relaxed);
+    return stats;
+}
+
+QueryPlanner::View QueryPlanner::GetView() const {
+    View view;
+    view.storage_ = storage_;
+    return view;
+}
+
+QueryPlan QueryPlanner::View::Plan(uint64_t cost, size_t max_threads) const {
+    QueryPlan plan;
+    plan.cost = cost;
+    if (storage_ != nullptr) {
+        const uint64_t threads = cost / storage_->cost_per_thread.load(memory_order_relaxed);
+        plan.threads = static_cast<size_t>(clamp<uint64_t>(threads, 1, max<size_t>(max_threads, 1)));
+    }
+    return plan;
+}
+
+size_t QueryPlanner::View::PlanSelection(size_t document_count, size_t max_threads) const {
+    if (storage_ == nullptr) {
+        return 1;
+    }
+    const size_t threads = document_count / storage_->selection_size.load(memory_order_relaxed);
+    return clamp<size_t>(threads, 1, max<size_t>(max_threads, 1));
+}
+
+void QueryPlanner::View::Record(const QueryPlan &plan, size_t selection_threads) const {
+    if (storage_ == nullptr) {
+        return;
+    }
+    if (plan.threads == 1) {
+        storage_->sequential_queries.fetch_add(1, memory_order_relaxed);
+    } else {
+        storage_->parallel_queries.fetch_add(1, memory_order_relaxed);
+        storage_->parallel_threads.fetch_add(plan.threads, memory_order_relaxed);
+    }
+    if (selection_threads > 1) {
+        storage_->parallel_selections.fetch_add(1, memory_order_relaxed);
+    }
+}
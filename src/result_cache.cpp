@@ -0,0 +1,220 @@
+#include "result_cache.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// перемешивает значение с накопленным хэшем (шаг хэша boost::hash_combine для 64 битов)
+void CombineHash(uint64_t &hash, uint64_t value) {
+    hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 12) + (hash >> 4);
+}
+
+// память записи в байтах: выдача, ключ и примерно оценённые узел списка, ячейка индекса и поля записи
+size_t CountEntryBytes(const ResultCache::Key &key, size_t document_count) {
+    const size_t entry_overhead = 256;
+    return entry_overhead +
+           (key.plus_terms.size() + key.minus_terms.size()) * sizeof(uint32_t) +
+           key.filter.GetIds().size() * sizeof(int) + document_count * sizeof(Document);
+}
+
+} // namespace
+
+ResultCache::ResultCache(size_t capacity) : storage_(make_shared<Storage>()) {
+    SetCapacity(capacity);
+}
+
+ResultCache::ResultCache(const ResultCache &other) : ResultCache(other.capacity_) {}
+
+ResultCache& ResultCache::operator=(const ResultCache &other) {
+    if (this != &other) {
+        ResultCache copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+void ResultCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    const size_t shard_capacity = capacity / SHARD_COUNT;
+    // на запись приходится хотя бы несколько сотен байт, поэтому счётчиков в строке хватает с запасом
+    size_t sketch_width = 64;
+    while (sketch_width < shard_capacity / 256) {
+        sketch_width *= 2;
+    }
+    storage_->shard_capacity.store(shard_capacity, memory_order_relaxed);
+    for (Shard &shard : storage_->shards) {
+        const lock_guard lock(shard.mutex);
+        while (shard.bytes > shard_capacity) {
+            Erase(shard, prev(shard.entries.end()));
+            ++shard.stats.evictions;
+        }
+        if (shard.sketch.width != sketch_width) {
+            shard.sketch.Reset(sketch_width);
+        }
+    }
+}
+
+size_t ResultCache::GetCapacity() const {
+    return capacity_;
+}
+
+ResultCache::Stats ResultCache::GetStats() const {
+    Stats stats;
+    for (Shard &shard : storage_->shards) {
+        const lock_guard lock(shard.mutex);
+        stats.hits += shard.stats.hits;
+        stats.misses += shard.stats.misses;
+        stats.evictions += shard.stats.evictions;
+        stats.rejections += shard.stats.rejections;
+    }
+    return stats;
+}
+
+ResultCache::View ResultCache::GetView() const {
+    View view;
+    view.storage_ = storage_;
+    return view;
+}
+
+uint64_t ResultCache::Hash(const Key &key) {
+    uint64_t hash = key.max_count;
+    CombineHash(hash, key.plus_terms.size());
+    for (const uint32_t term_id : key.plus_terms) {
+        CombineHash(hash, term_id);
+    }
+    CombineHash(hash, key.minus_terms.size());
+    for (const uint32_t term_id : key.minus_terms) {
+        CombineHash(hash, term_id);
+    }
+    const DocumentFilter &filter = key.filter;
+    CombineHash(hash, filter.GetStatusMask());
+    for (const int value : {filter.GetMinRating(), filter.GetMaxRating(), filter.GetMinId(), filter.GetMaxId()}) {
+        CombineHash(hash, static_cast<uint32_t>(value));
+    }
+    CombineHash(hash, filter.HasIds() ? filter.GetIds().size() + 1 : 0);
+    for (const int id : filter.GetIds()) {
+        CombineHash(hash, static_cast<uint32_t>(id));
+    }
+    return hash;
+}
+
+bool ResultCache::IsSameKey(const Entry &entry, const Key &key) {
+    const DocumentFilter &lhs = entry.filter;
+    const DocumentFilter &rhs = key.filter;
+    return entry.max_count == key.max_count && entry.plus_terms == key.plus_terms &&
+           entry.minus_terms == key.minus_terms && lhs.GetStatusMask() == rhs.GetStatusMask() &&
+           lhs.GetMinRating() == rhs.GetMinRating() && lhs.GetMaxRating() == rhs.GetMaxRating() &&
+           lhs.GetMinId() == rhs.GetMinId() && lhs.GetMaxId() == rhs.GetMaxId() && lhs.HasIds() == rhs.HasIds() &&
+           lhs.GetIds() == rhs.GetIds();
+}
+
+ResultCache::Shard& ResultCache::GetShard(Storage &storage, uint64_t hash) {
+    // младшие биты хэша выбирают счётчики частот, поэтому часть выбирается по старшим
+    return storage.shards[(hash >> 56) % SHARD_COUNT];
+}
+
+void ResultCache::Erase(Shard &shard, list<Entry>::iterator it) {
+    shard.bytes -= it->bytes;
+    shard.index.erase(it->hash);
+    shard.entries.erase(it);
+}
+
+void ResultCache::Sketch::Reset(size_t sketch_width) {
+    width = sketch_width;
+    counters.assign(SKETCH_ROWS * width, 0);
+    additions = 0;
+    sample_size = 10 * width;
+}
+
+void ResultCache::Sketch::Add(uint64_t hash) {
+    // ячейки строк выбираются двойным хэшированием по двум половинам хэша
+    const uint64_t step = (hash >> 32) | 1;
+    for (size_t row = 0; row < SKETCH_ROWS; ++row) {
+        uint8_t &counter = counters[row * width + ((hash + row * step) & (width - 1))];
+        if (counter < SKETCH_MAX_COUNT) {
+            ++counter;
+        }
+    }
+    if (++additions == sample_size) {
+        for (uint8_t &counter : counters) {
+            counter /= 2;
+        }
+        additions /= 2;
+    }
+}
+
+uint8_t ResultCache::Sketch::Estimate(uint64_t hash) const {
+    const uint64_t step = (hash >> 32) | 1;
+    uint8_t estimate = SKETCH_MAX_COUNT;
+    for (size_t row = 0; row < SKETCH_ROWS; ++row) {
+        estimate = min(estimate, counters[row * width + ((hash + row * step) & (width - 1))]);
+    }
+    return estimate;
+}
+
+bool ResultCache::View::Find(uint64_t version, const Key &key, vector<Document> &documents) const {
+    if (storage_ == nullptr || storage_->shard_capacity.load(memory_order_relaxed) == 0) {
+        return false;
+    }
+    const uint64_t hash = Hash(key);
+    Shard &shard = GetShard(*storage_, hash);
+    const lock_guard lock(shard.mutex);
+    shard.sketch.Add(hash);
+    const auto it = shard.index.find(hash);
+    if (it == shard.index.end() || it->second->version != version || !IsSameKey(*it->second, key)) {
+        ++shard.stats.misses;
+        return false;
+    }
+    // запись становится недавно использованной
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    const vector<Document> &cached = shard.entries.front().documents;
+    documents.assign(cached.begin(), cached.end());
+    ++shard.stats.hits;
+    return true;
+}
+
+void ResultCache::View::Insert(uint64_t version, const Key &key, const vector<Document> &documents) const {
+    if (storage_ == nullptr) {
+        return;
+    }
+    const size_t shard_capacity = storage_->shard_capacity.load(memory_order_relaxed);
+    const size_t bytes = CountEntryBytes(key, documents.size());
+    if (bytes > shard_capacity) {
+        return;
+    }
+    const uint64_t hash = Hash(key);
+    Shard &shard = GetShard(*storage_, hash);
+    const lock_guard lock(shard.mutex);
+    if (const auto it = shard.index.find(hash); it != shard.index.end()) {
+        // выдача старой версии или другого ключа с тем же хэшем заменяется, выдача более новой версии остаётся
+        if (it->second->version > version) {
+            return;
+        }
+        Erase(shard, it->second);
+    }
+    // место освобождается, только если новый ключ запрашивали чаще всех вытесняемых; выдачи старых версий
+    // уже не понадобятся и вытесняются без сравнения. Вытесняемые проверяются до того, как вытеснен первый,
+    // иначе отвергнутая запись оставила бы кэш и без себя, и без вытесненных
+    const uint8_t frequency = shard.sketch.Estimate(hash);
+    size_t victim_count = 0;
+    size_t freed_bytes = 0;
+    for (auto victim = shard.entries.rbegin(); shard.bytes - freed_bytes + bytes > shard_capacity; ++victim) {
+        if (victim->version > version ||
+            (victim->version == version && shard.sketch.Estimate(victim->hash) >= frequency)) {
+            ++shard.stats.rejections;
+            return;
+        }
+        freed_bytes += victim->bytes;
+        ++victim_count;
+    }
+    for (; victim_count > 0; --victim_count) {
+        Erase(shard, prev(shard.entries.end()));
+        ++shard.stats.evictions;
+    }
+    shard.entries.push_front(Entry{hash, version, key.plus_terms, key.minus_terms, key.filter, key.max_count,
+                                   documents, bytes});
+    shard.index.emplace(hash, shard.entries.begin());
+    shard.bytes += bytes;
+}
@@ -0,0 +1,81 @@
+#include "score_accumulator.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void ScoreAccumulator::Reset(size_t document_count) {
+    // чистим только страницы, в которые писали
+    for (size_t page = 0; page < active_.size(); ++page) {
+        if (active_[page]) {
+            Page &data = *pages_[page];
+            data.scores.fill(0);
+            data.found.fill(0);
+        }
+    }
+    const size_t page_count = (document_count + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages_.size() < page_count) {
+        pages_.resize(page_count);
+    }
+    active_.assign(page_count, 0);
+}
+
+void ScoreAccumulator::Add(uint32_t document, double score) {
+    Page &data = Activate(document >> PAGE_BITS);
+    const size_t offset = document & (PAGE_SIZE - 1);
+    data.scores[offset] += score;
+    data.found[offset / 64] |= uint64_t{1} << (offset % 64);
+}
+
+void ScoreAccumulator::Exclude(uint32_t document) {
+    const size_t page = document >> PAGE_BITS;
+    if (page < active_.size() && active_[page]) {
+        const size_t offset = document & (PAGE_SIZE - 1);
+        pages_[page]->found[offset / 64] &= ~(uint64_t{1} << (offset % 64));
+    }
+}
+
+void ScoreAccumulator::Merge(const ScoreAccumulator &other, size_t first_page, size_t last_page) {
+    last_page = min(last_page, other.active_.size());
+    for (size_t page = first_page; page < last_page; ++page) {
+        if (!other.active_[page]) {
+            continue;
+        }
+        const Page &source = *other.pages_[page];
+        Page &target = Activate(page);
+        for (size_t offset = 0; offset < PAGE_SIZE; ++offset) {
+            target.scores[offset] += source.scores[offset];
+        }
+        for (size_t word = 0; word < target.found.size(); ++word) {
+            target.found[word] |= source.found[word];
+        }
+    }
+}
+
+size_t ScoreAccumulator::PageCount() const {
+    return active_.size();
+}
+
+ScoreAccumulator::Page& ScoreAccumulator::Activate(size_t page) {
+    if (!active_[page]) {
+        if (!pages_[page]) {
+            pages_[page] = make_unique<Page>();
+        }
+        active_[page] = 1;
+    }
+    return *pages_[page];
+}
+
+ScoreAccumulatorLease::ScoreAccumulatorLease(size_t count) : count_(count) {
+    if (accumulators_->size() < count_) {
+        accumulators_->resize(count_);
+    }
+}
+
+ScoreAccumulator& ScoreAccumulatorLease::operator[](size_t index) {
+    return (*accumulators_)[index];
+}
+
+size_t ScoreAccumulatorLease::size() const {
+    return count_;
+}
@@ -6,43 +6,113 @@
 
 using namespace std;
 
+namespace {
+
+// столбец из size значений раздела файла индекса, читаемый из файла на месте
+template <typename T>
+AppendOnlyArray<T> MapColumn(const IndexFile &file, IndexSection section, size_t size) {
+    auto column = file.GetArray<T>(section);
+    CheckIndexFile(column.size == size);
+    return AppendOnlyArray<T>(move(column.data), column.size);
+}
+
+} // namespace
+
 SearchServer::SearchServer(const std::string &stop_words) : SearchServer(SplitIntoWordsView(stop_words)) {}
 SearchServer::SearchServer(std::string_view stop_words) : SearchServer(SplitIntoWordsView(stop_words)) {}
 
+SearchServer::RemovalVersion::RemovalVersion(const RemovalVersion &other)
+    : version(other.version.load(memory_order_relaxed)) {}
+
+SearchServer::RemovalVersion& SearchServer::RemovalVersion::operator=(const RemovalVersion &other) {
+    version.store(other.version.load(memory_order_relaxed), memory_order_relaxed);
+    return *this;
+}
+
+SearchServer::TombstoneWord::TombstoneWord(const TombstoneWord &other)
+    : bits(other.bits.load(memory_order_relaxed)) {}
+
+SearchServer::TombstoneWord& SearchServer::TombstoneWord::operator=(const TombstoneWord &other) {
+    bits.store(other.bits.load(memory_order_relaxed), memory_order_relaxed);
+    return *this;
+}
+
+uint32_t SearchServer::SegmentState::GetRemovedCount(uint32_t term_id) const {
+    if (!removed_terms) {
+        return 0;
+    }
+    const auto it = lower_bound(removed_terms->begin(), removed_terms->end(), term_id,
+                                [](const TermCount &term, uint32_t id) {
+        return term.term_id < id;
+    });
+    return it != removed_terms->end() && it->term_id == term_id ? it->count : 0;
+}
+
 void SearchServer::AddDocument(int document_id, string_view document,
                                DocumentStatus status, const vector<int> &ratings) {
 
+    ApplyMerge(false);
     // если документ пустой или документ с таким id уже есть на сервере или id отрицательный - ничего не добавляем
     if (document.empty()) {
         throw invalid_argument("Can't add empty document"s);
     }
-    if (documents_.count(document_id) != 0) {
+    if (FindDocument(document_id) != DocumentIdIndex::NO_DOCUMENT) {
         throw invalid_argument("Document with this id already exist"s);
     }
     if (document_id < 0) {
         throw invalid_argument("Can't add document with negative id"s);
     }
 
-    vector<string_view> words = SplitIntoWordsNoStop(document);
-    const double document_size = static_cast<double>(words.size());
+    // слова и термины документа раскладываются в буферы сервера, поэтому документ из известных слов
+    // не выделяет память под свои слова: слова словаря лежат в его арене, а здесь только string_view на текст
+    vector<string_view> &words = word_buffer_;
+    SplitIntoWordsNoStop(*stop_words_, document, words);
+    // документ записывается в журнал до первого изменения сервера; текст копируется в запись,
+    // только если журнал подключён
+    LogChange(log_.IsOpen() ? LogRecord{LogRecord::Type::ADD_DOCUMENT, 0, document_id, status, ratings,
+                                        string(document), 0}
+                            : LogRecord{});
+    const uint32_t internal_id = static_cast<uint32_t>(document_external_ids_.size());
 
-    // считаем term_freq для каждого слова в документе и записываем их вместе со словом
-    for (string_view &word_view : words) {
-        string word{word_view.data(), word_view.size()};
-        word_to_document_[word][document_id] += 1.0/document_size;
-        document_to_word_[document_id][word_to_document_.find(word)->first] += 1.0/document_size;
+    // переводим слова в id терминов и сортируем, чтобы одинаковые термины шли подряд
+    vector<uint32_t> &terms = term_buffer_;
+    terms.resize(words.size());
+    transform(words.begin(), words.end(), terms.begin(), [this](string_view word) {
+        return terms_.Intern(word);
+    });
+    statistics_.ResizeTerms(terms_.size());
+    sort(terms.begin(), terms.end());
+
+    // считаем кол-во вхождений каждого термина документа; в сегмент документ попадёт, когда их наберётся
+    // достаточно, а до тех пор ищется по прямому индексу
+    for (auto it = terms.begin(); it != terms.end();) {
+        const auto next = upper_bound(it, terms.end(), *it);
+        document_terms_.push_back(TermCount{*it, static_cast<uint32_t>(next - it)});
+        statistics_.AddTermDocument(*it);
+        it = next;
     }
+    document_term_offsets_.push_back(document_terms_.size());
 
-    documents_[document_id] = DocumentData{ComputeAverageRating(ratings), status};
+    document_internal_ids_.Add(document_id, internal_id);
+    document_external_ids_.push_back(document_id);
+    document_ratings_.push_back(ComputeAverageRating(ratings));
+    document_statuses_.push_back(status);
+    document_lengths_.push_back(static_cast<uint32_t>(words.size()));
+    document_removal_versions_.push_back(RemovalVersion());
+    document_tombstones_.resize(internal_id / 64 + 1);
+    statistics_.AddDocument(static_cast<uint32_t>(words.size()));
     document_ids_.insert(document_id);
+    SealActiveDocuments(execution::seq);
+    Publish();
+}
+
+void SearchServer::AddDocuments(const vector<DocumentInput> &documents) {
+    AddDocuments(execution::seq, documents);
 }
 
 map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
-    map<string_view, double> map = {};
-    if (document_ids_.count(document_id) == 0) {
-        return map;
-    }
-    return document_to_word_.at(document_id);
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).GetWordFrequencies(document_id);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
@@ -50,7 +120,409 @@ void SearchServer::RemoveDocument(int document_id) {
 }
 
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(document_ids_.size());
+    EpochGuard guard;
+    return current_version_.Load()->document_count;
+}
+
+void SearchServer::SetSegmentDocumentCount(uint32_t document_count) {
+    if (document_count == 0) {
+        throw invalid_argument("Segment must hold at least one document"s);
+    }
+    LogChange(LogRecord{LogRecord::Type::SET_SEGMENT_DOCUMENT_COUNT, 0, 0, DocumentStatus::ACTUAL, {}, {},
+                        document_count});
+    segment_document_count_ = document_count;
+}
+
+void SearchServer::SetCompactionRemovedShare(double share) {
+    if (!(share > 0)) {
+        throw invalid_argument("Compaction share must be positive"s);
+    }
+    compaction_removed_share_ = share;
+}
+
+size_t SearchServer::GetSegmentCount() const {
+    return segments_.size() + 1;
+}
+
+size_t SearchServer::GetRemovedDocumentCount() const {
+    // удалённые документы вне сегментов в счёт не идут: при заморозке в сегмент они не попадают
+    size_t count = static_cast<size_t>(count_if(pending_removals_.begin(), pending_removals_.end(),
+                                                [this](uint32_t internal_id) {
+        return internal_id < active_begin_;
+    }));
+    for (const SegmentState &segment : segments_) {
+        count += segment.removed_documents ? segment.removed_documents->size() : 0;
+    }
+    return count;
+}
+
+void SearchServer::WaitForMerges() {
+    SealActiveDocuments(execution::seq, true);
+    ScheduleMerge();
+    while (merger_.IsRunning()) {
+        ApplyMerge(true);
+    }
+    Publish();
+}
+
+void SearchServer::Compact() {
+    while (merger_.IsRunning()) {
+        ApplyMerge(true);
+    }
+    FoldRemovals();
+    for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+        if (it->removed_documents) {
+            const vector<uint64_t> removed = CollectRemoved(it, it + 1);
+            auto index = make_shared<const IndexSegment>(IndexSegment::Merge({it->index.get()}, removed));
+            *it = MakeMergedState(it, it + 1, move(index), removed);
+        }
+    }
+    ScheduleMerge();
+    Publish();
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+    query_cache_.SetCapacity(capacity);
+}
+
+QueryCache::Stats SearchServer::GetQueryCacheStats() const {
+    return query_cache_.GetStats();
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+    result_cache_.SetCapacity(capacity);
+}
+
+ResultCache::Stats SearchServer::GetResultCacheStats() const {
+    return result_cache_.GetStats();
+}
+
+void SearchServer::SetThreadPoolOptions(const ThreadPoolOptions &options) {
+    // прежний пул живёт, пока по нему ищут снимки и версии индекса, новые запросы идут уже на новом
+    thread_pool_ = ThreadPool(options);
+    Publish();
+}
+
+const ThreadPoolOptions& SearchServer::GetThreadPoolOptions() const {
+    return thread_pool_.GetOptions();
+}
+
+void SearchServer::SetAdaptiveThresholds(uint64_t cost_per_thread, size_t selection_size) {
+    planner_.SetThresholds(cost_per_thread, selection_size);
+}
+
+QueryPlanner::Stats SearchServer::GetQueryPlannerStats() const {
+    return planner_.GetStats();
+}
+
+QueryPlan SearchServer::ExplainQuery(string_view raw_query) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).ExplainQuery(raw_query);
+}
+
+void SearchServer::SetBatchDecodedBytes(size_t bytes) {
+    if (bytes == 0) {
+        throw invalid_argument("Batch must be able to decode postings"s);
+    }
+    batch_decoded_bytes_ = bytes;
+    Publish();
+}
+
+void SearchServer::SaveIndex(const string &path) const {
+    IndexFileWriter writer(path);
+    string stop_words;
+    for (const string_view word : stop_words_->GetWords()) {
+        if (!stop_words.empty()) {
+            stop_words += ' ';
+        }
+        stop_words += word;
+    }
+    writer.WriteSection(IndexSection::STOP_WORDS, stop_words.data(), stop_words.size());
+
+    // словарь: слова подряд и их концы
+    vector<uint64_t> word_ends;
+    word_ends.reserve(terms_.size());
+    writer.BeginSection(IndexSection::TERM_WORDS);
+    for (uint32_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        const string_view word = terms_.GetWord(term_id);
+        writer.Write(word.data(), word.size());
+        word_ends.push_back((word_ends.empty() ? 0 : word_ends.back()) + word.size());
+    }
+    writer.EndSection();
+    writer.WriteSection(IndexSection::TERM_WORD_ENDS, word_ends.data(), word_ends.size());
+    // в файл пишутся точные кол-ва документов с терминами, а ещё не учтённые удаления сохраняются отдельно
+    vector<uint32_t> document_freqs(terms_.size());
+    for (uint32_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        document_freqs[term_id] = statistics_.GetDocumentFreq(term_id);
+    }
+    for (const TermCount &term : CountDocumentTerms(pending_removals_)) {
+        document_freqs[term.term_id] -= term.count;
+    }
+    writer.WriteSection(IndexSection::TERM_DOCUMENT_FREQS, document_freqs.data(), document_freqs.size());
+
+    // столбцы документов и прямой индекс
+    writer.WriteSection(IndexSection::DOCUMENT_IDS, document_external_ids_.begin(), document_external_ids_.size());
+    writer.WriteSection(IndexSection::DOCUMENT_RATINGS, document_ratings_.begin(), document_ratings_.size());
+    writer.WriteSection(IndexSection::DOCUMENT_STATUSES, document_statuses_.begin(), document_statuses_.size());
+    writer.WriteSection(IndexSection::DOCUMENT_LENGTHS, document_lengths_.begin(), document_lengths_.size());
+    writer.WriteSection(IndexSection::DOCUMENT_TERM_OFFSETS, document_term_offsets_.begin(),
+                        document_term_offsets_.size());
+    writer.WriteSection(IndexSection::DOCUMENT_TERMS, document_terms_.begin(), document_terms_.size());
+    vector<uint64_t> tombstones(document_tombstones_.size());
+    transform(document_tombstones_.begin(), document_tombstones_.end(), tombstones.begin(),
+              [](const TombstoneWord &word) {
+        return word.bits.load(memory_order_relaxed);
+    });
+    writer.WriteSection(IndexSection::DOCUMENT_TOMBSTONES, tombstones.data(), tombstones.size());
+
+    // списки вхождений сегментов пишутся подряд, а их записи и удалённые документы сегментов - следом
+    vector<SegmentRecord> segments;
+    vector<SegmentTermRecord> segment_terms;
+    vector<uint32_t> removed_documents;
+    vector<TermCount> removed_terms;
+    writer.BeginSection(IndexSection::POSTINGS);
+    for (const SegmentState &state : segments_) {
+        SegmentRecord record;
+        record.first_document = state.index->GetFirstDocument();
+        record.end_document = state.index->GetEndDocument();
+        record.document_count = state.document_count;
+        const vector<SegmentTermRecord> terms = state.index->Write(writer);
+        record.term_begin = segment_terms.size();
+        record.term_count = terms.size();
+        segment_terms.insert(segment_terms.end(), terms.begin(), terms.end());
+        record.removed_document_begin = removed_documents.size();
+        record.removed_term_begin = removed_terms.size();
+        if (state.removed_documents) {
+            record.removed_document_count = state.removed_documents->size();
+            record.removed_term_count = state.removed_terms->size();
+            removed_documents.insert(removed_documents.end(), state.removed_documents->begin(),
+                                     state.removed_documents->end());
+            removed_terms.insert(removed_terms.end(), state.removed_terms->begin(), state.removed_terms->end());
+        }
+        segments.push_back(record);
+    }
+    writer.EndSection();
+    writer.WriteSection(IndexSection::SEGMENTS, segments.data(), segments.size());
+    writer.WriteSection(IndexSection::SEGMENT_TERMS, segment_terms.data(), segment_terms.size());
+    writer.WriteSection(IndexSection::REMOVED_DOCUMENTS, removed_documents.data(), removed_documents.size());
+    writer.WriteSection(IndexSection::REMOVED_TERMS, removed_terms.data(), removed_terms.size());
+    writer.WriteSection(IndexSection::PENDING_REMOVALS, pending_removals_.data(), pending_removals_.size());
+    const ServerRecord server{active_begin_, segment_document_count_, log_sequence_};
+    writer.WriteSection(IndexSection::SERVER, &server, 1);
+    writer.Finish();
+}
+
+SearchServer SearchServer::OpenIndex(const string &path) {
+    const IndexFile file(path);
+    size_t stop_words_size = 0;
+    const char *const stop_words = file.GetSection(IndexSection::STOP_WORDS, stop_words_size);
+    SearchServer server(string_view(stop_words, stop_words_size));
+    const auto server_record = file.GetArray<ServerRecord>(IndexSection::SERVER);
+    CheckIndexFile(server_record.size == 1 && server_record.data.get()[0].segment_document_count > 0);
+
+    // слова словаря остаются в файле
+    const auto words = file.GetArray<char>(IndexSection::TERM_WORDS);
+    const auto word_ends = file.GetArray<uint64_t>(IndexSection::TERM_WORD_ENDS);
+    CheckIndexFile(word_ends.size < TermDictionary::NO_TERM);
+    vector<string_view> term_words(word_ends.size);
+    for (size_t term_id = 0, begin = 0; term_id < word_ends.size; ++term_id) {
+        const uint64_t end = word_ends.data.get()[term_id];
+        CheckIndexFile(begin <= end && end <= words.size);
+        term_words[term_id] = string_view(words.data.get() + begin, static_cast<size_t>(end) - begin);
+        begin = static_cast<size_t>(end);
+    }
+    server.terms_ = TermDictionary(term_words, file.GetStorage());
+    const size_t term_count = term_words.size();
+    const auto document_freqs = file.GetArray<uint32_t>(IndexSection::TERM_DOCUMENT_FREQS);
+    CheckIndexFile(document_freqs.size == term_count);
+
+    // столбцы документов и прямой индекс читаются из файла на месте
+    const size_t document_end = file.GetArray<int>(IndexSection::DOCUMENT_IDS).size;
+    CheckIndexFile(document_end < DocumentIdIndex::NO_DOCUMENT);
+    server.document_external_ids_ = MapColumn<int>(file, IndexSection::DOCUMENT_IDS, document_end);
+    server.document_ratings_ = MapColumn<int>(file, IndexSection::DOCUMENT_RATINGS, document_end);
+    server.document_statuses_ = MapColumn<DocumentStatus>(file, IndexSection::DOCUMENT_STATUSES, document_end);
+    server.document_lengths_ = MapColumn<uint32_t>(file, IndexSection::DOCUMENT_LENGTHS, document_end);
+    server.document_term_offsets_ = MapColumn<size_t>(file, IndexSection::DOCUMENT_TERM_OFFSETS, document_end + 1);
+    CheckIndexFile(server.document_term_offsets_[0] == 0);
+    server.document_terms_ = MapColumn<TermCount>(file, IndexSection::DOCUMENT_TERMS,
+                                                  server.document_term_offsets_.back());
+    // по прямому индексу документов вне сегментов без проверок строится active_postings_: смещения этих
+    // документов не убывают, а их термины идут по возрастанию id и есть в словаре; документы сегментов
+    // проверяются при чтении (GetDocumentTerms), так что открытие не читает весь прямой индекс
+    const uint32_t active_begin = server_record.data.get()[0].active_begin;
+    CheckIndexFile(active_begin <= document_end);
+    for (uint32_t internal_id = active_begin; internal_id < document_end; ++internal_id) {
+        const size_t begin = server.document_term_offsets_[internal_id];
+        const size_t end = server.document_term_offsets_[internal_id + 1];
+        CheckIndexFile(begin <= end && end <= server.document_terms_.size());
+        for (size_t i = begin; i < end; ++i) {
+            const TermCount &term = server.document_terms_[i];
+            CheckIndexFile(term.term_id < term_count && term.count > 0 &&
+                           (i == begin || term.term_id > server.document_terms_[i - 1].term_id));
+        }
+    }
+
+    // удалённые документы: их версия удаления меньше любой версии открытого сервера
+    const auto tombstones = file.GetArray<uint64_t>(IndexSection::DOCUMENT_TOMBSTONES);
+    CheckIndexFile(tombstones.size == (document_end + 63) / 64);
+    server.document_tombstones_.resize(tombstones.size);
+    server.document_removal_versions_.resize(document_end);
+    vector<int> document_ids;
+    uint64_t total_length = 0;
+    for (uint32_t internal_id = 0; internal_id < document_end; ++internal_id) {
+        const int document_id = server.document_external_ids_[internal_id];
+        server.document_internal_ids_.Add(document_id, internal_id);
+        if (((tombstones.data.get()[internal_id / 64] >> (internal_id % 64)) & 1) != 0) {
+            server.document_removal_versions_[internal_id].version.store(0, memory_order_relaxed);
+        } else {
+            document_ids.push_back(document_id);
+            total_length += server.document_lengths_[internal_id];
+        }
+    }
+    for (size_t i = 0; i < tombstones.size; ++i) {
+        server.document_tombstones_[i].bits.store(tombstones.data.get()[i], memory_order_relaxed);
+    }
+    sort(document_ids.begin(), document_ids.end());
+    for (const int document_id : document_ids) {
+        server.document_ids_.insert(server.document_ids_.end(), document_id);
+    }
+    server.statistics_.ResizeTerms(term_count);
+    for (uint32_t term_id = 0; term_id < term_count; ++term_id) {
+        if (document_freqs.data.get()[term_id] != 0) {
+            server.statistics_.AddTermDocuments(term_id, document_freqs.data.get()[term_id]);
+        }
+    }
+    server.statistics_.AddDocuments(static_cast<uint32_t>(document_ids.size()), total_length);
+
+    // сегменты идут подряд с нулевого документа до первого документа вне сегментов
+    const auto segments = file.GetArray<SegmentRecord>(IndexSection::SEGMENTS);
+    const auto removed_documents = file.GetArray<uint32_t>(IndexSection::REMOVED_DOCUMENTS);
+    const auto removed_terms = file.GetArray<TermCount>(IndexSection::REMOVED_TERMS);
+    uint32_t segment_end = 0;
+    for (size_t i = 0; i < segments.size; ++i) {
+        const SegmentRecord &record = segments.data.get()[i];
+        CheckIndexFile(record.first_document == segment_end &&
+                       record.removed_document_begin <= removed_documents.size &&
+                       record.removed_document_count <= removed_documents.size - record.removed_document_begin &&
+                       record.removed_term_begin <= removed_terms.size &&
+                       record.removed_term_count <= removed_terms.size - record.removed_term_begin);
+        SegmentState state{make_shared<const IndexSegment>(IndexSegment::Map(record, file, term_count)),
+                           record.document_count, nullptr, nullptr};
+        if (record.removed_document_count > 0) {
+            const uint32_t *const documents = removed_documents.data.get() + record.removed_document_begin;
+            const TermCount *const terms = removed_terms.data.get() + record.removed_term_begin;
+            // удалённые документы сегмента служат индексами его битовой карты удалённых
+            for (size_t j = 0; j < record.removed_document_count; ++j) {
+                CheckIndexFile(documents[j] >= record.first_document && documents[j] < record.end_document &&
+                               (j == 0 || documents[j] > documents[j - 1]));
+            }
+            for (size_t j = 0; j < record.removed_term_count; ++j) {
+                CheckIndexFile(terms[j].term_id < term_count && (j == 0 || terms[j].term_id > terms[j - 1].term_id));
+            }
+            state.removed_documents = make_shared<const vector<uint32_t>>(
+                    documents, documents + record.removed_document_count);
+            state.removed_terms = make_shared<const vector<TermCount>>(terms, terms + record.removed_term_count);
+        }
+        segment_end = record.end_document;
+        server.segments_.push_back(move(state));
+    }
+    const ServerRecord &record = server_record.data.get()[0];
+    CheckIndexFile(record.active_begin == segment_end && segment_end <= document_end);
+    const auto pending_removals = file.GetArray<uint32_t>(IndexSection::PENDING_REMOVALS);
+    server.pending_removals_.assign(pending_removals.data.get(), pending_removals.data.get() + pending_removals.size);
+    for (const uint32_t internal_id : server.pending_removals_) {
+        CheckIndexFile(internal_id < document_end &&
+                       server.document_removal_versions_[internal_id].version.load(memory_order_relaxed) == 0);
+    }
+    // ещё не учтённые удаления вычитаются из кол-в документов с терминами при следующем пакете
+    for (const TermCount &term : server.CountDocumentTerms(server.pending_removals_)) {
+        server.statistics_.AddTermDocuments(term.term_id, term.count);
+    }
+    server.segment_document_count_ = record.segment_document_count;
+    server.active_begin_ = record.active_begin;
+    server.log_sequence_ = record.log_sequence;
+    // документы вне сегментов заново раскладываются по обратному индексу active_postings_
+    server.active_postings_.Clear(server.active_begin_);
+    server.SealActiveDocuments(execution::seq);
+    server.Publish();
+    return server;
+}
+
+void SearchServer::AttachLog(const string &path, LogOptions options) {
+    log_.Close();
+    // подряд идущие добавления проигрываются пакетами через AddDocuments; журнал закрыт, пока идёт проигрывание,
+    // поэтому проигранные изменения в него не дописываются, а только получают номера
+    vector<LogRecord> added;
+    const auto add_documents = [this, &added] {
+        vector<DocumentInput> documents;
+        documents.reserve(added.size());
+        for (const LogRecord &record : added) {
+            documents.push_back(DocumentInput{record.document_id, record.text, record.status, record.ratings});
+        }
+        AddDocuments(documents);
+        added.clear();
+    };
+    log_.Open(path, options, [this, &path, &added, &add_documents](const LogRecord &record) {
+        // записи, уже вошедшие в индекс, пропускаются, а остальные должны идти без пропусков
+        if (record.sequence <= log_sequence_) {
+            return;
+        }
+        if (record.sequence != log_sequence_ + added.size() + 1) {
+            throw runtime_error("Log doesn't continue the index: "s + path);
+        }
+        if (record.type == LogRecord::Type::ADD_DOCUMENT) {
+            added.push_back(record);
+            if (added.size() >= LOG_REPLAY_BATCH_SIZE) {
+                add_documents();
+            }
+            return;
+        }
+        add_documents();
+        if (record.type == LogRecord::Type::REMOVE_DOCUMENT) {
+            RemoveDocument(record.document_id);
+        } else {
+            SetSegmentDocumentCount(record.value);
+        }
+    });
+    try {
+        add_documents();
+    } catch (...) {
+        log_.Close();
+        throw;
+    }
+}
+
+void SearchServer::SyncLog() {
+    log_.Sync();
+}
+
+void SearchServer::Checkpoint(const string &index_path) {
+    // журнал очищается только после того, как файл индекса сброшен на диск и подменил прежний;
+    // если сбой случится между ними, записи журнала будут пропущены как уже вошедшие в индекс
+    SaveIndex(index_path);
+    log_.Reset();
+}
+
+CollectionStatistics::View SearchServer::GetStatistics() const {
+    EpochGuard guard;
+    return current_version_.Load()->statistics;
+}
+
+int SearchServer::GetDocumentFreq(string_view word) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).GetDocumentFreq(word);
+}
+
+double SearchServer::GetInverseDocumentFreq(string_view word) const {
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()).GetInverseDocumentFreq(word);
+}
+
+SearchServer::Snapshot SearchServer::GetSnapshot() const {
+    // пока читатель держит эпоху, версия не освобождается, и её можно взять во владение
+    EpochGuard guard;
+    return Snapshot(current_version_.Load()->shared_from_this());
 }
 
 set<int>::iterator SearchServer::begin() const {
@@ -61,6 +533,313 @@ set<int>::iterator SearchServer::end() const {
     return document_ids_.end(); // сложность О(1)
 }
 
+uint32_t SearchServer::FindDocument(int document_id) const {
+    const uint32_t internal_id = document_internal_ids_.Find(document_id);
+    if (internal_id == DocumentIdIndex::NO_DOCUMENT ||
+        document_removal_versions_[internal_id].version.load(memory_order_relaxed) != NOT_REMOVED) {
+        return DocumentIdIndex::NO_DOCUMENT;
+    }
+    return internal_id;
+}
+
+vector<SearchServer::TermCount> SearchServer::AddTermCounts(const vector<TermCount> &lhs,
+                                                            const vector<TermCount> &rhs) {
+    vector<TermCount> result;
+    result.reserve(lhs.size() + rhs.size());
+    auto left = lhs.begin();
+    auto right = rhs.begin();
+    while (left != lhs.end() || right != rhs.end()) {
+        if (right == rhs.end() || (left != lhs.end() && left->term_id < right->term_id)) {
+            result.push_back(*left++);
+        } else if (left == lhs.end() || right->term_id < left->term_id) {
+            result.push_back(*right++);
+        } else {
+            result.push_back(TermCount{left->term_id, left->count + right->count});
+            ++left;
+            ++right;
+        }
+    }
+    return result;
+}
+
+pair<const SearchServer::TermCount*, const SearchServer::TermCount*> SearchServer::GetDocumentTerms(
+        const TermCount *document_terms, const size_t *document_term_offsets, size_t document_terms_size,
+        uint32_t internal_id) {
+    const size_t begin = document_term_offsets[internal_id];
+    const size_t end = document_term_offsets[internal_id + 1];
+    CheckIndexFile(begin <= end && end <= document_terms_size);
+    return {document_terms + begin, document_terms + end};
+}
+
+vector<SearchServer::TermCount> SearchServer::CountDocumentTerms(const vector<uint32_t> &documents) const {
+    return CountDocumentTerms(documents, document_terms_.begin(), document_term_offsets_.begin(),
+                              document_terms_.size(), terms_.size());
+}
+
+vector<SearchServer::TermCount> SearchServer::CountDocumentTerms(const vector<uint32_t> &documents,
+                                                                 const TermCount *document_terms,
+                                                                 const size_t *document_term_offsets,
+                                                                 size_t document_terms_size, size_t term_count) {
+    vector<TermCount> terms;
+    for (const uint32_t internal_id : documents) {
+        const auto [begin, end] = GetDocumentTerms(document_terms, document_term_offsets, document_terms_size,
+                                                   internal_id);
+        for (const TermCount *term = begin; term != end; ++term) {
+            CheckIndexFile(term->term_id < term_count);
+            terms.push_back(TermCount{term->term_id, 1});
+        }
+    }
+    sort(terms.begin(), terms.end(), [](const TermCount &lhs, const TermCount &rhs) {
+        return lhs.term_id < rhs.term_id;
+    });
+    vector<TermCount> counts;
+    for (const TermCount &term : terms) {
+        if (!counts.empty() && counts.back().term_id == term.term_id) {
+            ++counts.back().count;
+        } else {
+            counts.push_back(term);
+        }
+    }
+    return counts;
+}
+
+void SearchServer::FoldRemovals() {
+    if (pending_removals_.empty()) {
+        return;
+    }
+    // кол-во документов с термином меняется один раз на термин сегмента пакета; документы вне сегментов
+    // в сегменты уже не попадут, поэтому учитываются только в статистике
+    const auto remove_terms = [this](const vector<TermCount> &terms) {
+        for (const TermCount &term : terms) {
+            statistics_.RemoveTermDocuments(term.term_id, term.count);
+        }
+    };
+    sort(pending_removals_.begin(), pending_removals_.end());
+    const auto segments_end = lower_bound(pending_removals_.begin(), pending_removals_.end(), active_begin_);
+    remove_terms(CountDocumentTerms(vector<uint32_t>(segments_end, pending_removals_.end())));
+    for (auto it = pending_removals_.begin(); it != segments_end;) {
+        SegmentState &segment = *(upper_bound(segments_.begin(), segments_.end(), *it,
+                                              [](uint32_t id, const SegmentState &state) {
+            return id < state.index->GetFirstDocument();
+        }) - 1);
+        const auto end = lower_bound(it, segments_end, segment.index->GetEndDocument());
+        const vector<uint32_t> documents(it, end);
+        const vector<TermCount> terms = CountDocumentTerms(documents);
+        remove_terms(terms);
+        // состояние сегмента разделяется с опубликованными версиями, поэтому заменяется целиком
+        if (segment.removed_documents) {
+            vector<uint32_t> removed_documents;
+            removed_documents.reserve(segment.removed_documents->size() + documents.size());
+            merge(segment.removed_documents->begin(), segment.removed_documents->end(),
+                  documents.begin(), documents.end(), back_inserter(removed_documents));
+            segment.removed_documents = make_shared<const vector<uint32_t>>(move(removed_documents));
+            segment.removed_terms = make_shared<const vector<TermCount>>(AddTermCounts(*segment.removed_terms, terms));
+        } else {
+            segment.removed_documents = make_shared<const vector<uint32_t>>(documents);
+            segment.removed_terms = make_shared<const vector<TermCount>>(terms);
+        }
+        it = end;
+    }
+    pending_removals_.clear();
+}
+
+vector<uint64_t> SearchServer::CollectRemoved(vector<SegmentState>::const_iterator begin,
+                                              vector<SegmentState>::const_iterator end) {
+    const uint32_t first_document = begin->index->GetFirstDocument();
+    vector<uint64_t> removed;
+    for (auto it = begin; it != end; ++it) {
+        if (!it->removed_documents) {
+            continue;
+        }
+        removed.resize((it->index->GetEndDocument() - first_document + 63) / 64);
+        for (const uint32_t internal_id : *it->removed_documents) {
+            removed[(internal_id - first_document) / 64] |= uint64_t{1} << ((internal_id - first_document) % 64);
+        }
+    }
+    return removed;
+}
+
+SearchServer::SegmentState SearchServer::MakeMergedState(vector<SegmentState>::const_iterator begin,
+                                                         vector<SegmentState>::const_iterator end,
+                                                         shared_ptr<const IndexSegment> index,
+                                                         const vector<uint64_t> &removed) const {
+    // документы, удалённые после запуска слияния, остались в новом сегменте и учитываются в нём заново
+    const uint32_t first_document = index->GetFirstDocument();
+    SegmentState state{move(index), 0, nullptr, nullptr};
+    vector<uint32_t> removed_documents;
+    for (auto it = begin; it != end; ++it) {
+        state.document_count += it->document_count;
+        if (!it->removed_documents) {
+            continue;
+        }
+        for (const uint32_t internal_id : *it->removed_documents) {
+            const uint32_t offset = internal_id - first_document;
+            if (offset / 64 < removed.size() && ((removed[offset / 64] >> (offset % 64)) & 1) != 0) {
+                --state.document_count;
+            } else {
+                removed_documents.push_back(internal_id);
+            }
+        }
+    }
+    if (!removed_documents.empty()) {
+        state.removed_terms = make_shared<const vector<TermCount>>(CountDocumentTerms(removed_documents));
+        state.removed_documents = make_shared<const vector<uint32_t>>(move(removed_documents));
+    }
+    return state;
+}
+
+void SearchServer::ScheduleMerge() {
+    if (merger_.IsRunning() || segments_.empty()) {
+        return;
+    }
+    // уровень сегмента - во сколько раз по степеням SEGMENT_MERGE_FACTOR он больше segment_document_count_
+    vector<size_t> levels(segments_.size());
+    transform(segments_.begin(), segments_.end(), levels.begin(), [this](const SegmentState &segment) {
+        size_t level = 0;
+        for (uint64_t size = uint64_t{segment_document_count_} * SEGMENT_MERGE_FACTOR;
+             segment.document_count >= size; size *= SEGMENT_MERGE_FACTOR) {
+            ++level;
+        }
+        return level;
+    });
+    // удалённые к началу слияния документы в слитый сегмент не попадают
+    FoldRemovals();
+    const auto start = [this](size_t first, size_t last) {
+        vector<shared_ptr<const IndexSegment>> inputs;
+        for (size_t i = first; i < last; ++i) {
+            inputs.push_back(segments_[i].index);
+        }
+        const auto begin = segments_.cbegin();
+        merger_.Start(move(inputs), CollectRemoved(begin + static_cast<ptrdiff_t>(first),
+                                                   begin + static_cast<ptrdiff_t>(last)));
+    };
+    // сливаем SEGMENT_MERGE_FACTOR соседних сегментов одного уровня из самой новой группы таких сегментов,
+    // начиная со старых в группе: так уровни сегментов не растут от старых к новым
+    for (size_t first = segments_.size(); first-- > 0;) {
+        const size_t last = first + SEGMENT_MERGE_FACTOR;
+        if (last <= segments_.size() && all_of(levels.begin() + static_cast<ptrdiff_t>(first),
+                                               levels.begin() + static_cast<ptrdiff_t>(last),
+                                               [&levels, first](size_t level) { return level == levels[first]; })) {
+            while (first > 0 && levels[first - 1] == levels[first]) {
+                --first;
+            }
+            start(first, first + SEGMENT_MERGE_FACTOR);
+            return;
+        }
+    }
+    // сегменты, оказавшиеся старше сегмента более высокого уровня (после большого пакета документов или
+    // слияния, закончившегося позже появления новых сегментов), сами уже не наберут группу,
+    // поэтому сливаются с этим сегментом
+    for (size_t next = segments_.size(); next-- > 1;) {
+        if (levels[next - 1] < levels[next]) {
+            size_t first = next - 1;
+            while (first > 0 && levels[first - 1] == levels[next - 1]) {
+                --first;
+            }
+            start(first, next + 1);
+            return;
+        }
+    }
+    // сегмент, из которого удалено много документов, перестраивается без них
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        const SegmentState &segment = segments_[i];
+        if (segment.removed_documents && static_cast<double>(segment.removed_documents->size()) >=
+                                         compaction_removed_share_ * segment.document_count) {
+            start(i, i + 1);
+            return;
+        }
+    }
+}
+
+void SearchServer::ApplyMerge(bool wait) {
+    optional<SegmentMerger::Result> merged = merger_.Finish(wait);
+    if (!merged) {
+        return;
+    }
+    const auto &inputs = merged->inputs;
+    const auto begin = find_if(segments_.begin(), segments_.end(), [&inputs](const SegmentState &segment) {
+        return segment.index == inputs.front();
+    });
+    if (static_cast<size_t>(segments_.end() - begin) >= inputs.size() &&
+        equal(inputs.begin(), inputs.end(), begin, [](const auto &input, const SegmentState &segment) {
+            return input == segment.index;
+        })) {
+        const auto end = begin + static_cast<ptrdiff_t>(inputs.size());
+        SegmentState state = MakeMergedState(begin, end, move(merged->segment), merged->removed);
+        segments_.insert(segments_.erase(begin, end), move(state));
+    }
+    ScheduleMerge();
+}
+
+void SearchServer::LogChange(LogRecord record) {
+    // номер занимается, только когда запись дописана: номера записей журнала идут без пропусков
+    record.sequence = log_sequence_ + 1;
+    if (log_.IsOpen()) {
+        log_.Append(record);
+    }
+    log_sequence_ = record.sequence;
+}
+
+void SearchServer::LogDocuments(const vector<DocumentInput> &documents) {
+    if (!log_.IsOpen()) {
+        log_sequence_ += documents.size();
+        return;
+    }
+    vector<LogRecord> records;
+    records.reserve(documents.size());
+    for (const DocumentInput &document : documents) {
+        records.push_back(LogRecord{LogRecord::Type::ADD_DOCUMENT, log_sequence_ + records.size() + 1, document.id,
+                                    document.status, document.ratings, string(document.text), 0});
+    }
+    log_.Append(records);
+    log_sequence_ += documents.size();
+}
+
+void SearchServer::Publish() {
+    auto version = make_shared<IndexVersion>();
+    version->version = ++version_;
+    version->stop_words = stop_words_;
+    version->terms = terms_.GetView();
+    version->internal_ids = document_internal_ids_.GetView();
+    version->external_ids = document_external_ids_.GetBuffer();
+    version->ratings = document_ratings_.GetBuffer();
+    version->statuses = document_statuses_.GetBuffer();
+    version->lengths = document_lengths_.GetBuffer();
+    version->removal_versions = document_removal_versions_.GetBuffer();
+    version->tombstones = document_tombstones_.GetBuffer();
+    version->document_terms = document_terms_.GetBuffer();
+    version->document_term_offsets = document_term_offsets_.GetBuffer();
+    version->document_end = static_cast<uint32_t>(document_external_ids_.size());
+    version->document_count = static_cast<int>(document_ids_.size());
+    version->log_document_count = version->document_count > 0 ? log(static_cast<double>(version->document_count)) : 0;
+    statistics_.Publish(version->version);
+    version->statistics = statistics_.GetView();
+    version->segments = segments_;
+    version->pending_removals = pending_removals_;
+    version->active_begin = active_begin_;
+    version->active_postings = active_postings_.GetView();
+    version->query_cache = query_cache_.GetView();
+    version->result_cache = result_cache_.GetView();
+    version->thread_pool = thread_pool_.GetView();
+    version->planner = planner_.GetView();
+    version->batch_decoded_bytes = batch_decoded_bytes_;
+    current_version_.Store(move(version));
+}
+
+double SearchServer::ComputeTermFreq(uint32_t count, uint32_t document_length) {
+    return static_cast<double>(count) / static_cast<double>(document_length);
+}
+
+bool SearchServer::IsMoreRelevant(const Document &lhs, const Document &rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < RELEVANCE_EPSILON) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
 int SearchServer::ComputeAverageRating(const vector<int> &ratings) {
     if (ratings.empty()) {
         return 0;
@@ -68,76 +847,358 @@ int SearchServer::ComputeAverageRating(const vector<int> &ratings) {
     return accumulate(ratings.begin(), ratings.end(), 0) / static_cast<int>(ratings.size());
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const{
-    using namespace std;
-    vector<string_view> words = SplitIntoWordsView(text);
-    vector<string_view> words_no_stop;
-    words_no_stop.reserve(words.size());
-
-    // здесь распараллеливание с локом words_no_stop преимущества в скорости не даёт
-    for_each(words.begin(), words.end(),
-    [this, &words_no_stop](string_view &word) {
-        if (stop_words_.count(word) == 0) {
-            if (IsNotValidWord(word)) {
-                throw invalid_argument("Document contain service symbols"s);
-            }
-            words_no_stop.push_back(word);
+vector<string_view> SearchServer::SplitIntoWordsNoStop(const StopWordSet &stop_words, string_view text) {
+    vector<string_view> words;
+    SplitIntoWordsNoStop(stop_words, text, words);
+    return words;
+}
+
+void SearchServer::SplitIntoWordsNoStop(const StopWordSet &stop_words, string_view text,
+                                        vector<string_view> &words) {
+    // слова выделяются прямо в words за один проход, который заодно ищет управляющие символы. Стоп-слова
+    // управляющих символов не содержат, поэтому символ в любом месте текста означает некорректное слово
+    words.clear();
+    const bool valid = ForEachWord(text, [&stop_words, &words](string_view word) {
+        if (!stop_words.Contains(word)) {
+            words.push_back(word);
+        }
+    });
+    if (!valid) {
+        throw invalid_argument("Document contain service symbols"s);
+    }
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view query, const DocumentFilter &filter,
+                                                size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, query, filter, max_count);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view query, DocumentStatus document_status,
+                                                size_t max_count) const {
+    return FindTopDocuments(query, DocumentFilter(document_status), max_count);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view query) const {
+    return FindTopDocuments(query, DocumentStatus::ACTUAL);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query,
+                                                                            int document_id) const {
+    return MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
+MatchResults SearchServer::MatchDocuments(string_view raw_query, const vector<int> &document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+MatchResults SearchServer::MatchAllDocuments(string_view raw_query) const {
+    return MatchAllDocuments(std::execution::seq, raw_query);
+}
+
+SearchServer::Snapshot::Snapshot(shared_ptr<const IndexVersion> version)
+    : owner_(move(version)), version_(owner_.get()) {}
+
+SearchServer::Snapshot::Snapshot(const IndexVersion *version) : version_(version) {}
+
+map<string_view, double> SearchServer::Snapshot::GetWordFrequencies(int document_id) const {
+    map<string_view, double> word_freqs = {};
+    const uint32_t internal_id = FindDocument(document_id);
+    if (internal_id == DocumentIdIndex::NO_DOCUMENT) {
+        return word_freqs;
+    }
+    const auto [begin, end] = GetDocumentTerms(version_->document_terms.get(), version_->document_term_offsets.get(),
+                                               version_->document_term_offsets[version_->document_end],
+                                               internal_id);
+    for (const TermCount *term = begin; term != end; ++term) {
+        CheckIndexFile(term->term_id < version_->terms.size());
+        word_freqs.emplace(version_->terms.GetWord(term->term_id),
+                           ComputeTermFreq(term->count, version_->lengths[internal_id]));
+    }
+    return word_freqs;
+}
+
+int SearchServer::Snapshot::GetDocumentCount() const {
+    return version_->document_count;
+}
+
+CollectionStatistics::View SearchServer::Snapshot::GetStatistics() const {
+    return version_->statistics;
+}
+
+int SearchServer::Snapshot::GetDocumentFreq(string_view word) const {
+    const uint32_t term_id = version_->terms.Find(word);
+    return term_id == TermDictionary::NO_TERM ? 0 : static_cast<int>(GetTermStatistics(term_id).first);
+}
+
+double SearchServer::Snapshot::GetInverseDocumentFreq(string_view word) const {
+    const uint32_t term_id = version_->terms.Find(word);
+    return term_id == TermDictionary::NO_TERM ? 0 : GetTermStatistics(term_id).second;
+}
+
+QueryPlan SearchServer::Snapshot::ExplainQuery(string_view raw_query) const {
+    ScratchLease<QueryScratch> scratch;
+    SplitQueryWords(raw_query, *scratch);
+    return version_->planner.Plan(EstimateQueryCost(scratch->query), version_->thread_pool.GetParallelism());
+}
+
+vector<Document> SearchServer::Snapshot::FindTopDocuments(string_view raw_query, const DocumentFilter &filter,
+                                                          size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, filter, max_count);
+}
+
+vector<Document> SearchServer::Snapshot::FindTopDocuments(string_view raw_query, DocumentStatus document_status,
+                                                          size_t max_count) const {
+    return FindTopDocuments(raw_query, DocumentFilter(document_status), max_count);
+}
+
+vector<Document> SearchServer::Snapshot::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::Snapshot::MatchDocument(string_view raw_query,
+                                                                                 int document_id) const {
+    return MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
+MatchResults SearchServer::Snapshot::MatchDocuments(string_view raw_query, const vector<int> &document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+MatchResults SearchServer::Snapshot::MatchAllDocuments(string_view raw_query) const {
+    return MatchAllDocuments(std::execution::seq, raw_query);
+}
+
+uint32_t SearchServer::Snapshot::FindDocument(int document_id) const {
+    const uint32_t internal_id = version_->internal_ids.Find(document_id, version_->document_end);
+    return internal_id == DocumentIdIndex::NO_DOCUMENT || IsRemoved(internal_id) ? DocumentIdIndex::NO_DOCUMENT
+                                                                                 : internal_id;
+}
+
+const SearchServer::TermCount* SearchServer::Snapshot::FindDocumentTerm(uint32_t internal_id,
+                                                                        uint32_t term_id) const {
+    const auto [begin, end] = GetDocumentTerms(version_->document_terms.get(), version_->document_term_offsets.get(),
+                                               version_->document_term_offsets[version_->document_end],
+                                               internal_id);
+    const TermCount *const it = lower_bound(begin, end, term_id, [](const TermCount &term, uint32_t id) {
+        return term.term_id < id;
+    });
+    return it != end && it->term_id == term_id ? it : nullptr;
+}
+
+uint32_t SearchServer::Snapshot::CountPendingRemovals(uint32_t term_id) const {
+    return static_cast<uint32_t>(count_if(version_->pending_removals.begin(), version_->pending_removals.end(),
+                                          [this, term_id](uint32_t internal_id) {
+        return internal_id < version_->active_begin && FindDocumentTerm(internal_id, term_id) != nullptr;
+    }));
+}
+
+uint32_t SearchServer::Snapshot::GetPendingRemovedCount(uint32_t term_id) const {
+    if (version_->pending_removals.empty()) {
+        return 0;
+    }
+    call_once(version_->pending_terms_flag, [this] {
+        version_->pending_terms = CountDocumentTerms(version_->pending_removals, version_->document_terms.get(),
+                                                     version_->document_term_offsets.get(),
+                                                     version_->document_term_offsets[version_->document_end],
+                                                     version_->terms.size());
+    });
+    const vector<TermCount> &terms = version_->pending_terms;
+    const auto it = lower_bound(terms.begin(), terms.end(), term_id, [](const TermCount &term, uint32_t id) {
+        return term.term_id < id;
+    });
+    return it != terms.end() && it->term_id == term_id ? it->count : 0;
+}
+
+uint32_t SearchServer::Snapshot::CountDocumentFreq(uint32_t term_id) const {
+    uint32_t document_freq = 0;
+    for (const SegmentState &segment : version_->segments) {
+        if (const PostingList *postings = segment.index->FindPostings(term_id)) {
+            document_freq += static_cast<uint32_t>(postings->size()) - segment.GetRemovedCount(term_id);
+        }
+    }
+    version_->active_postings.ForEachPosting(term_id, version_->document_end,
+                                             [this, &document_freq](uint32_t document, uint32_t) {
+        if (!IsRemoved(document)) {
+            ++document_freq;
         }
     });
-    return words_no_stop;
+    return document_freq - CountPendingRemovals(term_id);
 }
 
-bool SearchServer::IsNotValidWord(string_view word) {
-    // A valid word must not contain special characters
-    // здесь для не очень длинных слов распараллеливать смысла нет
-    for (const char c : word) {
-        if (c >= '\0' && c < ' ') {
-            return true;
+double SearchServer::Snapshot::ComputeInverseDocumentFreq(uint32_t document_freq) const {
+    // та же формула, что и в CollectionStatistics: log(кол-во документов) - log(кол-во документов с термином)
+    if (document_freq == 0) {
+        return 0;
+    }
+    return version_->log_document_count - log(static_cast<double>(document_freq));
+}
+
+pair<uint32_t, double> SearchServer::Snapshot::GetTermStatistics(uint32_t term_id) const {
+    uint32_t document_freq = 0;
+    double log_document_freq = 0;
+    if (version_->statistics.ReadTerm(version_->version, term_id, document_freq, log_document_freq)) {
+        const uint32_t removed = GetPendingRemovedCount(term_id);
+        if (removed == 0) {
+            return {document_freq, document_freq == 0 ? 0 : version_->log_document_count - log_document_freq};
         }
+        return {document_freq - removed, ComputeInverseDocumentFreq(document_freq - removed)};
     }
-    return false;
+    document_freq = CountDocumentFreq(term_id);
+    return {document_freq, ComputeInverseDocumentFreq(document_freq)};
 }
 
-SearchServer::Query SearchServer::SplitQueryWords(string_view raw_query) const {
+void SearchServer::Snapshot::SplitQueryWords(string_view raw_query, QueryScratch &scratch) const {
     using namespace std;
-    Query query;
-    vector<string_view> words = SplitIntoWordsNoStop(raw_query);
+    Query &query = scratch.query;
+    // разбор повторного запроса берётся из кэша, пока словарь версии не вырос
+    const size_t term_count = version_->terms.size();
+    if (version_->query_cache.Find(raw_query, term_count, query.plus_terms, query.minus_terms)) {
+        return;
+    }
+    query.plus_terms.clear();
+    query.minus_terms.clear();
+    vector<string_view> &words = scratch.words;
+    SplitIntoWordsNoStop(*version_->stop_words, raw_query, words);
 
     // здесь не параллелится (можно обрабатывать в 2 потока плюс и минус слова, или лочить контейнеры на запись,
     // но выигрыша по скорости не будет, я проверил)
-    for_each(words.begin(), words.end (), [this, &query](auto &word) {
+    for (string_view word : words) {
+        vector<uint32_t> *terms = &query.plus_terms;
         if (word.at(0) == '-') {
-            string_view result_word = word.substr(1);
+            word.remove_prefix(1);
             // не обрабатываем запросы со словами состоящими только из минуса или с двумя минусами вначале подряд
-            if (result_word.empty() || result_word[0] == '-') {
+            if (word.empty() || word[0] == '-') {
                 throw invalid_argument("Document contain invalid minus words"s);
             }
-            if (stop_words_.count(result_word) == 0) {
-                query.minus_words.insert(result_word);
-            }
-        } else {
-            if (stop_words_.count(word) == 0) {
-                //если слова нет в стоп-словах добавляем его в plus_words
-                query.plus_words.insert(word);
+            terms = &query.minus_terms;
+        }
+        // стоп-слова пропускаем (плюс-слова уже проверены при разбиении запроса, а минус-слова с минусом
+        // стоп-словами не считались), а слова, которых нет в словаре, не найдутся ни в одном документе
+        if (terms == &query.plus_terms || !version_->stop_words->Contains(word)) {
+            const uint32_t term_id = version_->terms.Find(word);
+            if (term_id != TermDictionary::NO_TERM) {
+                terms->push_back(term_id);
             }
         }
-    });
-    return query;
+    }
+    for (auto *terms : {&query.plus_terms, &query.minus_terms}) {
+        sort(terms->begin(), terms->end());
+        terms->erase(unique(terms->begin(), terms->end()), terms->end());
+    }
+    version_->query_cache.Insert(raw_query, term_count, query.plus_terms, query.minus_terms);
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view query, DocumentStatus document_status) const {
-    return FindTopDocuments(query, [document_status](int, DocumentStatus status, int) {
-        return status == document_status;
+void SearchServer::Snapshot::PrepareQuery(QueryScratch &scratch) const {
+    Query &query = scratch.query;
+    const vector<uint32_t> &plus_terms = query.plus_terms;
+    vector<uint32_t> &document_freqs = scratch.document_freqs;
+    vector<double> &log_document_freqs = scratch.log_document_freqs;
+    vector<uint8_t> &published = scratch.published_terms;
+    // кол-ва документов со словами обычно берутся готовыми из статистики версии; кол-ва слов, которые сервер
+    // успел изменить дважды, версия считает сама по спискам вхождений
+    document_freqs.resize(plus_terms.size());
+    log_document_freqs.resize(plus_terms.size());
+    published.resize(plus_terms.size());
+    bool all_published = true;
+    for (size_t i = 0; i < plus_terms.size(); ++i) {
+        published[i] = version_->statistics.ReadTerm(version_->version, plus_terms[i], document_freqs[i],
+                                                     log_document_freqs[i]);
+        if (!published[i]) {
+            document_freqs[i] = 0;
+            all_published = false;
+        }
+    }
+    // вхождения плюс-слов в документы вне сегментов нужны для релевантности (и для кол-ва документов со словом,
+    // если оно считается), поэтому запоминаются по порядку слов
+    vector<ActiveTerm> &active_terms = scratch.active_terms;
+    active_terms.clear();
+    query.active_documents.clear();
+    for (size_t i = 0; i < plus_terms.size(); ++i) {
+        version_->active_postings.ForEachPosting(plus_terms[i], version_->document_end,
+                                                 [this, &active_terms, i](uint32_t document, uint32_t count) {
+            if (!IsRemoved(document)) {
+                active_terms.push_back(ActiveTerm{document, count, i});
+            }
+        });
+    }
+    query.inverse_document_freqs.resize(plus_terms.size());
+    if (!all_published) {
+        for (const ActiveTerm &term : active_terms) {
+            if (!published[term.term]) {
+                ++document_freqs[term.term];
+            }
+        }
+        for (const SegmentState &segment : version_->segments) {
+            for (size_t i = 0; i < plus_terms.size(); ++i) {
+                const PostingList *postings = published[i] ? nullptr : segment.index->FindPostings(plus_terms[i]);
+                if (postings != nullptr) {
+                    document_freqs[i] += static_cast<uint32_t>(postings->size())
+                                         - segment.GetRemovedCount(plus_terms[i]);
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < plus_terms.size(); ++i) {
+        if (!published[i]) {
+            document_freqs[i] -= CountPendingRemovals(plus_terms[i]);
+            query.inverse_document_freqs[i] = ComputeInverseDocumentFreq(document_freqs[i]);
+            continue;
+        }
+        // документы, удалённые после последнего пакета, в статистике ещё учтены
+        const uint32_t removed = GetPendingRemovedCount(plus_terms[i]);
+        if (removed == 0) {
+            query.inverse_document_freqs[i] = document_freqs[i] == 0
+                                              ? 0 : version_->log_document_count - log_document_freqs[i];
+        } else {
+            document_freqs[i] -= removed;
+            query.inverse_document_freqs[i] = ComputeInverseDocumentFreq(document_freqs[i]);
+        }
+    }
+    if (active_terms.empty()) {
+        return;
+    }
+
+    ScoreAccumulatorLease lease(1);
+    ScoreAccumulator &accumulator = lease[0];
+    accumulator.Reset(version_->document_end);
+    for (const ActiveTerm &term : active_terms) {
+        accumulator.Add(term.document, ComputeTermFreq(term.count, version_->lengths[term.document]) *
+                                       query.inverse_document_freqs[term.term]);
+    }
+    // документы с минус-словами учитываются в кол-ве документов со словом, но в выдачу не попадают
+    for (const uint32_t term_id : query.minus_terms) {
+        version_->active_postings.ForEachPosting(term_id, version_->document_end,
+                                                 [&accumulator](uint32_t document, uint32_t) {
+            accumulator.Exclude(document);
+        });
+    }
+    accumulator.ForEach([&query](uint32_t internal_id, double relevance) {
+        query.active_documents.emplace_back(internal_id, relevance);
     });
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view query) const {
-    return FindTopDocuments(query, DocumentStatus::ACTUAL);
+uint64_t SearchServer::Snapshot::EstimateQueryCost(const Query &query) const {
+    uint64_t cost = 0;
+    for (const SegmentState &segment : version_->segments) {
+        for (const auto *terms : {&query.plus_terms, &query.minus_terms}) {
+            for (const uint32_t term_id : *terms) {
+                if (const PostingList *postings = segment.index->FindPostings(term_id)) {
+                    cost += postings->size();
+                }
+            }
+        }
+    }
+    return cost;
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query,
-                                                                            int document_id) const {
-    return MatchDocument(std::execution::seq, raw_query, document_id);
+void SearchServer::Snapshot::BuildDocumentBitmap(const vector<int> &document_ids, vector<uint64_t> &bitmap) const {
+    bitmap.assign((version_->document_end + 63) / 64, 0);
+    for (const int document_id : document_ids) {
+        const uint32_t internal_id = FindDocument(document_id);
+        if (internal_id != DocumentIdIndex::NO_DOCUMENT) {
+            bitmap[internal_id / 64] |= uint64_t{1} << (internal_id % 64);
+        }
+    }
 }
 
 void PrintMatchDocumentResult(int document_id, vector<string_view> words, DocumentStatus status) {
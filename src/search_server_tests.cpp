@@ -1,8 +1,31 @@
 #include "search_server_tests.h"
+#include "allocation_counter.h"
+#include "posting_list.h"
+#include "process_queries.h"
+#include "score_accumulator.h"
+#include "scratch_lease.h"
 #include "search_server.h"
+#include "term_dictionary.h"
 #include "test_framework.h"
-
+#include "thread_pool.h"
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
 #include <numeric>
+#include <random>
+#include <set>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <csignal>
+#include <sys/resource.h>
+#endif
 
 // -------- Начало модульных тестов поисковой системы ----------
 
@@ -69,6 +92,85 @@ void TestAddDocuments () {
     }  catch (...) {}
 }
 
+// Тест проверяет пакетное добавление документов
+void TestAddDocumentsBatch() {
+    mt19937 generator;
+    vector<string> texts;
+    for (int id = 0; id < 500; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 20)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += "w"s + to_string(uniform_int_distribution<int>(0, 150)(generator)) + " "s;
+        }
+        texts.push_back(text);
+    }
+    // часть документов добавлена заранее по одному, остальные - пакетами
+    auto fill = [&texts](SearchServer &server, auto add_batch) {
+        vector<DocumentInput> batch;
+        for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+            const auto status = static_cast<DocumentStatus>(id % 4);
+            if (id < 100) {
+                server.AddDocument(id * 2, texts[static_cast<size_t>(id)], status, {id % 7, 1});
+            } else {
+                batch.push_back({id * 2, texts[static_cast<size_t>(id)], status, {id % 7, 1}});
+            }
+            if (batch.size() == 150) {
+                add_batch(server, batch);
+                batch.clear();
+            }
+        }
+        add_batch(server, batch);
+    };
+    SearchServer expected("w0"s);
+    fill(expected, [](SearchServer &server, const vector<DocumentInput> &batch) {
+        for (const DocumentInput &document : batch) {
+            server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+    });
+    SearchServer sequential("w0"s);
+    fill(sequential, [](SearchServer &server, const vector<DocumentInput> &batch) {
+        server.AddDocuments(batch);
+    });
+    SearchServer parallel("w0"s);
+    fill(parallel, [](SearchServer &server, const vector<DocumentInput> &batch) {
+        server.AddDocuments(execution::par, batch);
+    });
+
+    for (const SearchServer *server : {&sequential, &parallel}) {
+        ASSERT_EQUAL(server->GetDocumentCount(), expected.GetDocumentCount());
+        ASSERT_EQUAL(server->GetStatistics().GetTotalLength(), expected.GetStatistics().GetTotalLength());
+        for (const int id : expected) {
+            ASSERT_EQUAL(server->GetWordFrequencies(id), expected.GetWordFrequencies(id));
+            ASSERT(get<1>(server->MatchDocument("w1"s, id)) == get<1>(expected.MatchDocument("w1"s, id)));
+        }
+        for (int i = 0; i < 50; ++i) {
+            const string query = "w"s + to_string(i) + " w"s + to_string(i * 3) + " -w"s + to_string(i + 70);
+            ASSERT_EQUAL(server->GetDocumentFreq("w"s + to_string(i)), expected.GetDocumentFreq("w"s + to_string(i)));
+            ASSERT_EQUAL(server->FindTopDocuments(query, DocumentFilter(), 20),
+                         expected.FindTopDocuments(query, DocumentFilter(), 20));
+        }
+    }
+
+    // некорректный документ в пакете - не добавляется ни один документ пакета
+    SearchServer server(""s);
+    server.AddDocument(1, "белый кот"s);
+    const vector<vector<DocumentInput>> invalid_batches = {
+        {{2, "пёс"sv, DocumentStatus::ACTUAL, {}}, {3, ""sv, DocumentStatus::ACTUAL, {}}},
+        {{2, "пёс"sv, DocumentStatus::ACTUAL, {}}, {1, "попугай"sv, DocumentStatus::ACTUAL, {}}},
+        {{2, "пёс"sv, DocumentStatus::ACTUAL, {}}, {2, "попугай"sv, DocumentStatus::ACTUAL, {}}},
+        {{2, "пёс"sv, DocumentStatus::ACTUAL, {}}, {-3, "попугай"sv, DocumentStatus::ACTUAL, {}}},
+        {{2, "пёс"sv, DocumentStatus::ACTUAL, {}}, {3, "скво\x12рец"sv, DocumentStatus::ACTUAL, {}}},
+    };
+    for (const auto &batch : invalid_batches) {
+        try {
+            server.AddDocuments(execution::par, batch);
+            ASSERT_HINT(false, "Server add invalid batch"s);
+        } catch (const invalid_argument &) {}
+        ASSERT_EQUAL(server.GetDocumentCount(), 1);
+        ASSERT_EQUAL(server.GetDocumentFreq("пёс"s), 0);
+    }
+}
+
 // Тест проверяет удаление документа
 void TestRemoveDocument() {
     // проверка обычной версии
@@ -174,6 +276,52 @@ void TestExcludeStopWordsFromAddedDocumentContent() {
         auto found_docs = server.FindTopDocuments("in"s);
         ASSERT_HINT(found_docs.empty(), "Stop words must be excluded from documents"s);
     }
+
+    {
+        // таблица constexpr-набора строится при компиляции
+        static constexpr StaticStopWords stop_words(array{"in"sv, "the"sv, ""sv, "in"sv});
+        static_assert(stop_words.Contains("in"sv) && !stop_words.Contains("city"sv) && stop_words.size() == 2);
+        // временный набор умер бы раньше сервера
+        static_assert(!is_constructible_v<SearchServer, decltype(stop_words)>);
+        static_assert(is_constructible_v<SearchServer, decltype(stop_words)&>);
+        SearchServer server(stop_words);
+        server.AddDocument(doc_id, content);
+        ASSERT_HINT(server.FindTopDocuments("in"s).empty(), "Stop words must be excluded from documents"s);
+        ASSERT_EQUAL(server.FindTopDocuments("city -the"s).size(), 1u);
+    }
+}
+
+// Проверка набора стоп-слов на случайных словах
+void TestStopWordSet() {
+    mt19937 generator;
+    auto random_word = [&generator]() {
+        string word(uniform_int_distribution<size_t>(1, 6)(generator), 'a');
+        for (char &c : word) {
+            c = static_cast<char>(uniform_int_distribution<int>('a', 'e')(generator));
+        }
+        return word;
+    };
+    for (const size_t count : {size_t{0}, size_t{1}, size_t{10}, size_t{1000}}) {
+        vector<string> words;
+        for (size_t i = 0; i < count; ++i) {
+            words.push_back(random_word());
+        }
+        const set<string, less<>> expected(words.begin(), words.end());
+        const StopWordSet stop_words(vector<string_view>(words.begin(), words.end()));
+        ASSERT_EQUAL(stop_words.size(), expected.size());
+        ASSERT_HINT(stop_words.GetWords() == vector<string_view>(expected.begin(), expected.end()), "words"s);
+        for (int i = 0; i < 1000; ++i) {
+            const string word = random_word();
+            ASSERT_EQUAL_HINT(stop_words.Contains(word), expected.count(word) > 0, word);
+        }
+    }
+    bool thrown = false;
+    try {
+        StopWordSet stop_words({"a\tb"sv});
+    } catch (const invalid_argument &) {
+        thrown = true;
+    }
+    ASSERT_HINT(thrown, "Stop word with control character accepted"s);
 }
 
 // Тест проверяет что поисковая система исключает из выдачи документы с минус-словами (и не исключает другие)
@@ -313,6 +461,46 @@ void TestDocumentsMatching_PAR() {
     }
 }
 
+// Проверка, что MatchDocuments находит для каждого документа те же слова и статус, что MatchDocument,
+// MatchAllDocuments выдаёт все документы по возрастанию id, а отсутствующий документ выбрасывает исключение
+void TestMatchDocuments() {
+    SearchServer server("и в на"s);
+    server.SetSegmentDocumentCount(2);
+    server.AddDocument(3, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::BANNED, {7, 2, 7});
+    server.AddDocument(7, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(5, "пушистый пёс и белый хвост"s, DocumentStatus::IRRELEVANT, {1, 2});
+    server.AddDocument(2, "кот скворец"s, DocumentStatus::ACTUAL, {3});
+    server.RemoveDocument(7);
+    const string query = "пушистый белый кот -скворец неизвестное"s;
+    const auto check = [&server, &query](const MatchResults &results, const vector<int> &document_ids) {
+        ASSERT_EQUAL(results.size(), document_ids.size());
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const auto [words, status] = server.MatchDocument(query, document_ids[i]);
+            ASSERT_EQUAL(results.document_ids[i], document_ids[i]);
+            ASSERT(results.statuses[i] == status);
+            ASSERT_EQUAL(vector<string_view>(results.GetWords(i).begin(), results.GetWords(i).end()), words);
+        }
+    };
+    const vector<int> document_ids = {5, 2, 3, 5};
+    check(server.MatchDocuments(query, document_ids), document_ids);
+    check(server.MatchDocuments(execution::par, query, document_ids), document_ids);
+    check(server.MatchDocuments(adaptive_execution, query, document_ids), document_ids);
+    check(server.MatchAllDocuments(query), {1, 2, 3, 5});
+    check(server.GetSnapshot().MatchAllDocuments(execution::par, query), {1, 2, 3, 5});
+    ASSERT(server.MatchDocuments(query, {}).empty());
+    const MatchResults results = server.MatchDocuments(execution::par, query, {2, 5});
+    ASSERT(results.GetWords(0).empty());
+    ASSERT_EQUAL(results.GetWords(1).size(), 2u);
+    ASSERT_EQUAL(results.GetWords(1)[0], "белый"s);
+
+    try {
+        server.MatchDocuments(execution::par, query, {3, 7});
+        ASSERT_HINT(false, "Removed document must throw"s);
+    } catch (const out_of_range &) {
+    }
+}
+
 
 // Проверка сортировки возвращаемых документов. Возвращаемые при поиске документов результаты должны быть
 // отсортированы в порядке убывания релевантности.
@@ -497,6 +685,1617 @@ void TestGetWordFrequencies() {
     }
 }
 
+// Проверка статистики коллекции документов
+void TestCollectionStatistics() {
+    SearchServer server("и в на"s);
+    ASSERT_EQUAL(server.GetStatistics().GetDocumentCount(), 0);
+    ASSERT(abs(server.GetStatistics().GetAverageDocumentLength()) < 1e-9);
+
+    server.AddDocument(1, "пушистый кот и пушистый хвост"s);
+    server.AddDocument(2, "ухоженный пёс"s);
+    server.AddDocument(3, "кот в мешке"s);
+    CollectionStatistics::View statistics = server.GetStatistics();
+    ASSERT_EQUAL(statistics.GetDocumentCount(), 3);
+    ASSERT_EQUAL(statistics.GetTotalLength(), 8u);
+    ASSERT(abs(statistics.GetAverageDocumentLength() - 8.0 / 3.0) < 1e-9);
+    ASSERT_EQUAL(server.GetDocumentFreq("кот"s), 2);
+    ASSERT_EQUAL(server.GetDocumentFreq("пушистый"s), 1);
+    ASSERT_EQUAL(server.GetDocumentFreq("и"s), 0);
+    ASSERT_EQUAL(server.GetDocumentFreq("собака"s), 0);
+    ASSERT(abs(server.GetInverseDocumentFreq("кот"s) - log(3.0 / 2.0)) < 1e-9);
+    ASSERT(abs(server.GetInverseDocumentFreq("пёс"s) - log(3.0)) < 1e-9);
+    ASSERT(abs(server.GetInverseDocumentFreq("собака"s)) < 1e-9);
+
+    // снимок читает свои частоты, пока сервер не изменил термин дважды, а после считает их по спискам вхождений
+    const auto snapshot = server.GetSnapshot();
+    for (const int document_id : {4, 5}) {
+        server.AddDocument(document_id, "кот"s);
+        ASSERT_EQUAL(server.GetDocumentFreq("кот"s), document_id - 1);
+        ASSERT_EQUAL(snapshot.GetStatistics().GetDocumentCount(), 3);
+        ASSERT_EQUAL(snapshot.GetDocumentFreq("кот"s), 2);
+        ASSERT(abs(snapshot.GetInverseDocumentFreq("кот"s) - log(3.0 / 2.0)) < 1e-9);
+        ASSERT(abs(snapshot.GetInverseDocumentFreq("пёс"s) - log(3.0)) < 1e-9);
+        ASSERT_EQUAL(snapshot.FindTopDocuments("кот"s).size(), 2u);
+        ASSERT(abs(snapshot.FindTopDocuments("кот"s)[0].relevance - log(3.0 / 2.0) / 2.0) < 1e-9);
+    }
+    server.RemoveDocument(4);
+    server.RemoveDocument(5);
+
+    // после удаления статистика пересчитывается, слова без документов имеют нулевой IDF
+    server.RemoveDocument(3);
+    // полученная статистика не меняется вместе с сервером
+    ASSERT_EQUAL(statistics.GetDocumentCount(), 3);
+    statistics = server.GetStatistics();
+    ASSERT_EQUAL(statistics.GetDocumentCount(), 2);
+    ASSERT_EQUAL(statistics.GetTotalLength(), 6u);
+    ASSERT_EQUAL(server.GetDocumentFreq("кот"s), 1);
+    ASSERT_EQUAL(server.GetDocumentFreq("мешке"s), 0);
+    ASSERT(abs(server.GetInverseDocumentFreq("кот"s) - log(2.0)) < 1e-9);
+    ASSERT(abs(server.GetInverseDocumentFreq("мешке"s)) < 1e-9);
+    server.RemoveDocument(execution::par, 1);
+    server.RemoveDocument(2);
+    statistics = server.GetStatistics();
+    ASSERT_EQUAL(statistics.GetDocumentCount(), 0);
+    ASSERT_EQUAL(statistics.GetTotalLength(), 0u);
+    ASSERT_EQUAL(server.GetDocumentFreq("пушистый"s), 0);
+}
+
+// Проверка разбиения текста на слова с поиском управляющих символов всеми реализациями
+void TestForEachWord() {
+    // эталон: побайтовое разбиение по пробелам
+    auto split = [](string_view text, vector<string_view> &words) {
+        bool valid = true;
+        size_t begin = 0;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            if (i == text.size() || text[i] == ' ') {
+                if (i > begin) {
+                    words.push_back(text.substr(begin, i - begin));
+                }
+                begin = i + 1;
+            } else if (static_cast<unsigned char>(text[i]) < ' ') {
+                valid = false;
+            }
+        }
+        return valid;
+    };
+    mt19937 generator;
+    // слова пересекают границы блоков, пробелы идут подряд, встречаются байты больше 127
+    const string alphabet = "ab  \xd0\xba"s;
+    vector<string> texts = {""s, " "s, "a"s, string(64, 'a'), string(64, ' ') + "a"s, string(63, 'a') + " b"s,
+                            "кот\tпёс"s, string(200, 'x') + '\x01'};
+    for (int i = 0; i < 500; ++i) {
+        string text(uniform_int_distribution<size_t>(0, 300)(generator), ' ');
+        for (char &c : text) {
+            c = alphabet[uniform_int_distribution<size_t>(0, alphabet.size() - 1)(generator)];
+        }
+        if (i % 5 == 0 && !text.empty()) {
+            text[uniform_int_distribution<size_t>(0, text.size() - 1)(generator)] = static_cast<char>(i % 32);
+        }
+        texts.push_back(text);
+    }
+    for (const TextScanner &scanner : GetSupportedTextScanners()) {
+        for (const string &text : texts) {
+            vector<string_view> expected;
+            const bool expected_valid = split(text, expected);
+            vector<string_view> words;
+            const bool valid = ForEachWord(text, [&words](string_view word) {
+                words.push_back(word);
+            }, scanner);
+            ASSERT_EQUAL_HINT(valid, expected_valid, scanner.name + " validity: "s + text);
+            ASSERT_HINT(words == expected, scanner.name + " words: "s + text);
+        }
+    }
+}
+
+// Проверка словаря терминов
+void TestTermDictionary() {
+    TermDictionary terms;
+    ASSERT_EQUAL(terms.Find("кот"s), TermDictionary::NO_TERM);
+
+    // повторное добавление слова возвращает тот же id, id выдаются подряд
+    const uint32_t cat = terms.Intern("кот"s);
+    const uint32_t dog = terms.Intern("пёс"s);
+    ASSERT_EQUAL(cat, 0u);
+    ASSERT_EQUAL(dog, 1u);
+    ASSERT_EQUAL(terms.Intern("кот"s), cat);
+    ASSERT_EQUAL(terms.Find("пёс"s), dog);
+    ASSERT_EQUAL(terms.GetWord(cat), "кот"sv);
+
+    // слова остаются на месте при росте хэш-таблицы и арены, в том числе очень длинные
+    const string long_word(100'000, 'x');
+    vector<string> words;
+    for (int i = 0; i < 10'000; ++i) {
+        words.push_back("word"s + to_string(i));
+    }
+    const string_view cat_view = terms.GetWord(cat);
+    const uint32_t long_id = terms.Intern(long_word);
+    for (const string &word : words) {
+        terms.Intern(word);
+    }
+    ASSERT_EQUAL(terms.size(), words.size() + 3);
+    ASSERT_EQUAL(terms.GetWord(long_id), long_word);
+    ASSERT_EQUAL(cat_view.data(), terms.GetWord(cat).data());
+    for (const string &word : words) {
+        ASSERT_EQUAL(terms.GetWord(terms.Find(word)), word);
+    }
+    // известные слова не выделяют память: словарь ищет их по string_view в арене
+    const size_t allocations_before = GetAllocationCount();
+    for (const string &word : words) {
+        terms.Intern(word);
+    }
+    const size_t allocations = GetAllocationCount() - allocations_before;
+    ASSERT_EQUAL_HINT(allocations, 0u, "Interning known words allocates"s);
+
+    // копия словаря независима от оригинала и сохраняет id слов
+    TermDictionary copy(terms);
+    terms.Intern("новое"s);
+    ASSERT_EQUAL(copy.Find("новое"s), TermDictionary::NO_TERM);
+    ASSERT_EQUAL(copy.Find("word42"s), terms.Find("word42"s));
+    ASSERT(copy.GetWord(cat).data() != terms.GetWord(cat).data());
+}
+
+// Проверка сжатого списка вхождений
+void TestPostingList() {
+    mt19937 generator;
+    PostingList postings;
+    vector<PostingList::Posting> expected;
+    auto check = [&postings, &expected](const string &hint) {
+        vector<PostingList::Posting> result;
+        postings.ForEach([&result](uint32_t document, uint32_t count, uint32_t tag) {
+            result.push_back({document, count, tag});
+        });
+        ASSERT_EQUAL_HINT(postings.size(), expected.size(), hint);
+        ASSERT_EQUAL_HINT(result.size(), expected.size(), hint);
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_HINT(result[i].document == expected[i].document && result[i].count == expected[i].count &&
+                        result[i].tag == expected[i].tag, hint);
+        }
+    };
+
+    // разности id и кол-ва вхождений разной разрядности, вплоть до 32 бит; блоки с одинаковыми и разными метками
+    uint32_t document = 0;
+    for (int i = 0; i < 1000; ++i) {
+        const uint32_t gap = i == 500 ? (1u << 31) : uniform_int_distribution<uint32_t>(1, 1u << (i % 20))(generator);
+        const uint32_t count = i == 700 ? numeric_limits<uint32_t>::max() : uniform_int_distribution<uint32_t>(1, 5)(generator);
+        const uint32_t tag = (i / 200) % 2 == 0 ? 0 : uniform_int_distribution<uint32_t>(0, 7)(generator);
+        document += gap;
+        postings.Append(document, count, count, tag);
+        expected.push_back({document, count, tag});
+    }
+    check("Incorrect postings after append"s);
+
+    // после проверки в конец списка можно дописывать дальше
+    postings.Append(document + 1, 3, 4, 2);
+    expected.push_back({document + 1, 3, 2});
+    check("Incorrect postings after second append"s);
+
+    // курсор находит первый документ не меньше заданного, в том числе через несколько блоков
+    for (int i = 0; i < 100; ++i) {
+        PostingList::Cursor cursor(postings);
+        auto it = expected.begin();
+        while (!cursor.AtEnd()) {
+            ASSERT(it != expected.end());
+            ASSERT_EQUAL(cursor.Document(), it->document);
+            ASSERT_EQUAL(cursor.Count(), it->count);
+            ASSERT_EQUAL(cursor.Tag(), it->tag);
+            ASSERT(cursor.BlockMaxTermFreq(it->document) >= 0.75f);
+            const uint32_t target = it->document + uniform_int_distribution<uint32_t>(0, 1u << (i % 30))(generator);
+            cursor.NextGeq(target);
+            it = lower_bound(it, expected.end(), target, [](const PostingList::Posting &posting, uint32_t id) {
+                return posting.document < id;
+            });
+        }
+        ASSERT(it == expected.end());
+    }
+
+    // курсор и обход с маской меток видят только вхождения с метками из маски
+    for (const uint32_t tag_mask : {0u, 1u, 0b100u, 0b10110u, PostingList::ALL_TAGS}) {
+        vector<PostingList::Posting> filtered;
+        copy_if(expected.begin(), expected.end(), back_inserter(filtered), [tag_mask](const auto &posting) {
+            return ((tag_mask >> posting.tag) & 1) != 0;
+        });
+        size_t visited = 0;
+        postings.ForEach([&filtered, &visited](uint32_t document, uint32_t, uint32_t) {
+            ASSERT(visited < filtered.size() && filtered[visited].document == document);
+            ++visited;
+        }, tag_mask);
+        ASSERT_EQUAL(visited, filtered.size());
+
+        PostingList::Cursor cursor(postings, tag_mask);
+        auto it = filtered.begin();
+        for (int step = 0; !cursor.AtEnd(); ++step) {
+            ASSERT(it != filtered.end());
+            ASSERT_EQUAL(cursor.Document(), it->document);
+            ASSERT_EQUAL(cursor.Tag(), it->tag);
+            if (step % 2 == 0) {
+                cursor.Next();
+                ++it;
+            } else {
+                const uint32_t target = it->document + uniform_int_distribution<uint32_t>(0, 1u << 24)(generator);
+                cursor.NextGeq(target);
+                it = lower_bound(it, filtered.end(), target, [](const PostingList::Posting &posting, uint32_t id) {
+                    return posting.document < id;
+                });
+            }
+        }
+        ASSERT(it == filtered.end());
+    }
+
+    // дописывание другого списка копирует его блоки, в том числе неполные, и недописанный блок
+    PostingList other;
+    for (uint32_t i = 1; i <= 300; ++i) {
+        other.Append(expected.back().document + i * 3, i % 4 + 1, 8, i % 3);
+    }
+    vector<PostingList::Posting> other_expected;
+    other.ForEach([&other_expected](uint32_t document, uint32_t count, uint32_t tag) {
+        other_expected.push_back({document, count, tag});
+    });
+    postings.Seal();
+    postings.Extend(other);
+    expected.insert(expected.end(), other_expected.begin(), other_expected.end());
+    check("Incorrect postings after extend"s);
+    ASSERT(postings.MaxTermFreq() >= other.MaxTermFreq());
+    postings.Seal();
+    check("Incorrect postings after seal"s);
+    PostingList::Cursor cursor(postings);
+    for (const auto &posting : expected) {
+        cursor.NextGeq(posting.document);
+        ASSERT(!cursor.AtEnd() && cursor.Document() == posting.document && cursor.Count() == posting.count);
+    }
+
+    // при дописывании с битовой картой удалённых документов отмеченные документы выбрасываются,
+    // а блоки без них копируются как есть
+    const uint32_t first_document = other_expected.front().document;
+    vector<uint64_t> removed((other_expected.back().document - first_document) / 64 + 1);
+    vector<PostingList::Posting> kept;
+    for (size_t i = 0; i < other_expected.size(); ++i) {
+        const uint32_t offset = other_expected[i].document - first_document;
+        if (i >= PostingList::BLOCK_SIZE && i % 5 == 0) {
+            removed[offset / 64] |= uint64_t{1} << (offset % 64);
+        } else {
+            kept.push_back(other_expected[i]);
+        }
+    }
+    PostingList purged;
+    purged.Extend(other, removed, first_document);
+    ASSERT_EQUAL(purged.size(), kept.size());
+    vector<PostingList::Posting> purged_postings;
+    purged.ForEach([&purged_postings](uint32_t document, uint32_t count, uint32_t tag) {
+        purged_postings.push_back({document, count, tag});
+    });
+    ASSERT_HINT(equal(purged_postings.begin(), purged_postings.end(), kept.begin(), kept.end(),
+                      [](const PostingList::Posting &lhs, const PostingList::Posting &rhs) {
+        return lhs.document == rhs.document && lhs.count == rhs.count && lhs.tag == rhs.tag;
+    }), "Incorrect postings after extend without removed documents"s);
+}
+
+// Проверка аккумулятора релевантности документов
+void TestScoreAccumulator() {
+    mt19937 generator;
+    const size_t document_count = 5 * ScoreAccumulator::PAGE_SIZE + 17;
+    // аккумулятор из пула переиспользуется: результаты прошлых раундов не должны просачиваться
+    for (int round = 0; round < 3; ++round) {
+        ScoreAccumulatorLease accumulators(3);
+        ASSERT_EQUAL(accumulators.size(), 3u);
+        map<uint32_t, double> expected;
+        for (size_t lane = 0; lane < accumulators.size(); ++lane) {
+            accumulators[lane].Reset(document_count);
+            for (int i = 0; i < 300; ++i) {
+                const uint32_t document = uniform_int_distribution<uint32_t>(
+                        0, static_cast<uint32_t>(document_count - 1))(generator);
+                const double score = uniform_int_distribution<int>(0, 4)(generator) * 0.5;
+                accumulators[lane].Add(document, score);
+                expected[document] += score;
+            }
+        }
+        // сливаем по диапазонам страниц, как при параллельном поиске
+        const size_t page_count = accumulators[0].PageCount();
+        ASSERT_EQUAL(page_count, 6u);
+        for (size_t first_page = 0; first_page < page_count; first_page += 4) {
+            accumulators[0].Merge(accumulators[1], first_page, first_page + 4);
+            accumulators[0].Merge(accumulators[2], first_page, first_page + 4);
+        }
+        // исключаем несколько документов, в том числе ненайденный
+        for (int i = 0; i < 20; ++i) {
+            const uint32_t document = uniform_int_distribution<uint32_t>(
+                    0, static_cast<uint32_t>(document_count - 1))(generator);
+            accumulators[0].Exclude(document);
+            expected.erase(document);
+        }
+
+        vector<pair<uint32_t, double>> result;
+        accumulators[0].ForEach([&result](uint32_t document, double score) {
+            result.push_back({document, score});
+        });
+        ASSERT_EQUAL(result.size(), expected.size());
+        auto it = expected.begin();
+        for (const auto &[document, score] : result) {
+            // документы с нулевым вкладом тоже считаются найденными
+            ASSERT_EQUAL(document, it->first);
+            ASSERT(abs(score - it->second) < RELEVANCE_EPSILON);
+            ++it;
+        }
+    }
+
+    // вложенный запрос в том же потоке получает другой набор аккумуляторов
+    ScoreAccumulatorLease outer(1);
+    ScoreAccumulatorLease inner(1);
+    ASSERT(&outer[0] != &inner[0]);
+}
+
+// Проверка ограничения кол-ва документов в выдаче, задаваемого при вызове
+void TestFindTopDocumentsCount() {
+    SearchServer server("и в на"s);
+    // релевантность документов зависит от их длины и повторяется, как и рейтинг
+    for (int id = 0; id < 1000; ++id) {
+        string text = "кот"s + (id % 2 == 0 ? " ошейник"s : ""s);
+        for (int i = 0; i < id % 13; ++i) {
+            text += " пёс"s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+    }
+    server.AddDocument(1000, "пёс"s, DocumentStatus::BANNED, {1});
+
+    const string query = "кот ошейник"s;
+    const auto default_result = server.FindTopDocuments(query);
+    ASSERT_EQUAL(default_result.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    ASSERT(server.FindTopDocuments(query, DocumentStatus::ACTUAL, 0).empty());
+    ASSERT(server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, 0).empty());
+
+    const auto single = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1);
+    ASSERT_EQUAL(single.size(), 1u);
+    ASSERT_EQUAL(single.at(0), default_result.at(0));
+
+    // больше документов, чем нашлось, выдать нельзя
+    const auto all = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 5000);
+    const auto all_par = server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, 5000);
+    ASSERT_EQUAL(all.size(), 1000u);
+    ASSERT_EQUAL(all, all_par);
+    for (size_t i = 1; i < all.size(); ++i) {
+        ASSERT_HINT(!(all[i - 1] < all[i]), "Documents must be sorted by relevance"s);
+    }
+
+    // выдача произвольного размера совпадает с началом полной выдачи
+    for (const size_t max_count : {2u, 10u, 77u, 999u}) {
+        const vector<Document> expected(all.begin(), all.begin() + static_cast<ptrdiff_t>(max_count));
+        ASSERT_EQUAL(server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_count), expected);
+        ASSERT_EQUAL(server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, max_count), expected);
+        ASSERT_EQUAL(server.FindTopDocuments(query, [](int, DocumentStatus, int) { return true; }, max_count),
+                     expected);
+    }
+}
+
+// Проверка, что поиск с отсечением заведомо не попадающих в выдачу документов даёт ту же выдачу,
+// что и полный подсчёт релевантности всех найденных документов
+void TestFindTopDocumentsPruning() {
+    mt19937 generator;
+    vector<string> dictionary;
+    for (int i = 0; i < 200; ++i) {
+        dictionary.push_back("w"s + to_string(i));
+    }
+    // слова с маленькими номерами встречаются чаще, чтобы были и длинные, и короткие списки
+    auto random_word = [&generator, &dictionary]() {
+        const double x = uniform_real_distribution<double>(0, 1)(generator);
+        return dictionary[static_cast<size_t>(x * x * x * static_cast<double>(dictionary.size()))];
+    };
+
+    SearchServer server("w1"s);
+    map<int, pair<DocumentStatus, int>> documents; // <id, <статус, рейтинг>>
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 30)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += random_word() + " "s;
+        }
+        const auto status = static_cast<DocumentStatus>(uniform_int_distribution<int>(0, 3)(generator));
+        const int rating = uniform_int_distribution<int>(-3, 3)(generator);
+        server.AddDocument(id * 3, text, status, {rating});
+        documents[id * 3] = {status, rating};
+    }
+    for (int id = 0; id < 3000; id += 7) {
+        server.RemoveDocument(id * 3);
+        documents.erase(id * 3);
+    }
+
+    map<string_view, int> document_freqs;
+    for (const int id : server) {
+        for (const auto& [word, term_freq] : server.GetWordFrequencies(id)) {
+            ++document_freqs[word];
+        }
+    }
+    // эталонная выдача, посчитанная напрямую по частотам слов документов
+    auto find_reference = [&](const set<string> &plus_words, const set<string> &minus_words, auto predicate) {
+        vector<Document> result;
+        for (const auto& [id, data] : documents) {
+            const auto word_freqs = server.GetWordFrequencies(id);
+            double relevance = 0;
+            bool found = false;
+            for (const string &word : plus_words) {
+                if (word_freqs.count(word) != 0) {
+                    found = true;
+                    relevance += word_freqs.at(word) * log(server.GetDocumentCount() /
+                                                           static_cast<double>(document_freqs.at(word)));
+                }
+            }
+            for (const string &word : minus_words) {
+                found = found && word_freqs.count(word) == 0;
+            }
+            if (found && predicate(id, data.first, data.second)) {
+                result.push_back(Document{id, relevance, data.second});
+            }
+        }
+        sort(result.begin(), result.end(), [](const Document &lhs, const Document &rhs) {
+            if (abs(lhs.relevance - rhs.relevance) < 1e-6) {
+                return lhs.rating > rhs.rating || (lhs.rating == rhs.rating && lhs.id < rhs.id);
+            }
+            return lhs.relevance > rhs.relevance;
+        });
+        if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
+            result.resize(MAX_RESULT_DOCUMENT_COUNT);
+        }
+        return result;
+    };
+
+    const auto by_rating = [](int, DocumentStatus, int rating) {
+        return rating > 0;
+    };
+    for (int i = 0; i < 300; ++i) {
+        string query;
+        set<string> plus_words;
+        set<string> minus_words;
+        const int length = uniform_int_distribution<int>(1, 8)(generator);
+        for (int j = 0; j < length; ++j) {
+            const string word = random_word();
+            if (word == "w1"s) {
+                continue;
+            }
+            if (uniform_int_distribution<int>(0, 9)(generator) == 0) {
+                minus_words.insert(word);
+                query += " -"s + word;
+            } else {
+                plus_words.insert(word);
+                query += " "s + word;
+            }
+        }
+        // слово, которого нет ни в одном документе, не влияет на выдачу
+        query += " absent"s;
+        for (const string &word : minus_words) {
+            plus_words.erase(word);
+        }
+
+        const auto expected = find_reference(plus_words, minus_words, [](int, DocumentStatus status, int) {
+            return status == DocumentStatus::ACTUAL;
+        });
+        ASSERT_EQUAL_HINT(server.FindTopDocuments(query), expected, query);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, query), expected, query);
+
+        const auto expected_by_rating = find_reference(plus_words, minus_words, by_rating);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments(query, by_rating), expected_by_rating, query);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, query, by_rating), expected_by_rating, query);
+
+        // декларативный фильтр даёт ту же выдачу, что и эквивалентный ему предикат
+        DocumentFilter filter;
+        switch (i % 4) {
+        case 0:
+            filter.SetStatuses({DocumentStatus::BANNED, DocumentStatus::IRRELEVANT});
+            break;
+        case 1:
+            filter.SetRatingRange(-1, 2).SetIdRange(1000, 6000);
+            break;
+        case 2: {
+            vector<int> ids;
+            for (int j = 0; j < 500; ++j) {
+                ids.push_back(uniform_int_distribution<int>(0, 9500)(generator));
+            }
+            filter.SetStatuses({DocumentStatus::ACTUAL, DocumentStatus::REMOVED}).SetIds(move(ids));
+            break;
+        }
+        default:
+            filter.SetStatuses({});
+        }
+        const auto expected_by_filter = find_reference(plus_words, minus_words, filter);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments(query, filter), expected_by_filter, query);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, query, filter), expected_by_filter, query);
+    }
+}
+
+// Проверка пула временных буферов запроса
+void TestQueryScratch() {
+    {
+        // вложенная выдача получает отдельный объект, освобождённый объект выдаётся снова
+        const vector<int> *outer_address = nullptr;
+        {
+            ScratchLease<vector<int>> outer;
+            outer->push_back(1);
+            outer_address = &*outer;
+            ScratchLease<vector<int>> inner;
+            ASSERT(&*inner != &*outer);
+            ASSERT(inner->empty());
+        }
+        ScratchLease<vector<int>> again;
+        ASSERT_EQUAL(&*again, outer_address);
+        ASSERT_EQUAL(again->size(), 1u);
+        again->clear();
+    }
+
+    SearchServer server("и в на"s);
+    for (int id = 0; id < 2000; ++id) {
+        server.AddDocument(id, "кот пёс"s + (id % 2 == 0 ? " хвост"s : " ошейник"s) + " слово"s + to_string(id % 50),
+                           DocumentStatus::ACTUAL, {id % 7});
+    }
+    server.SetSegmentDocumentCount(500);
+    server.WaitForMerges();
+    const vector<string> queries = {"кот хвост -ошейник"s, "слово7 пёс"s, "кот в ошейник"s, "нет такого"s};
+    for (const string &query : queries) {
+        server.FindTopDocuments(query);
+        server.FindTopDocuments(query, DocumentFilter().SetIds({1, 2, 3, 4}));
+    }
+    // после первых запросов потока буферы берутся из пула, и память выделяется только под выдачу
+    const size_t allocations_before = GetAllocationCount();
+    for (const string &query : queries) {
+        server.FindTopDocuments(query);
+    }
+    const size_t allocations = GetAllocationCount() - allocations_before;
+    ASSERT_HINT(allocations <= queries.size(), "Query temporaries are allocated per query"s);
+}
+
+// Проверка кэша разобранных запросов
+void TestQueryCache() {
+    SearchServer server("и в на"s);
+    server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    const auto first = server.FindTopDocuments("пушистый кот -ошейник"s);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 1u);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 0u);
+    // повторный запрос берётся из кэша и даёт ту же выдачу, в том числе в MatchDocument
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот -ошейник"s), first);
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "пушистый кот -ошейник"s), first);
+    ASSERT_EQUAL(get<0>(server.MatchDocument("пушистый кот -ошейник"s, 2)),
+                 (vector<string_view>{"кот"sv, "пушистый"sv}));
+    ASSERT(get<0>(server.MatchDocument("пушистый кот -ошейник"s, 1)).empty());
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 4u);
+    // некорректный запрос не кэшируется и выбрасывает исключение каждый раз
+    for (int i = 0; i < 2; ++i) {
+        try {
+            server.FindTopDocuments("кот --хвост"s);
+            ASSERT_HINT(false, "Invalid query must throw"s);
+        } catch (const invalid_argument &) {
+        }
+    }
+
+    // новое слово словаря делает разбор устаревшим: слово, которого не было, теперь находится
+    ASSERT(server.FindTopDocuments("скворец"s).empty());
+    const auto snapshot = server.GetSnapshot();
+    server.AddDocument(3, "ухоженный скворец"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.FindTopDocuments("скворец"s).size(), 1u);
+    // снимок со старым словарём по-прежнему не видит слова
+    ASSERT(snapshot.FindTopDocuments("скворец"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("скворец"s).size(), 1u);
+
+    // копия сервера не разделяет кэш: её словарь растёт независимо
+    SearchServer copy(server);
+    server.AddDocument(4, "серый воробей"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(copy.FindTopDocuments("дятел"s).empty());
+    copy.AddDocument(4, "пёстрый дятел"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(server.FindTopDocuments("дятел"s).empty());
+    ASSERT_EQUAL(copy.FindTopDocuments("дятел"s).size(), 1u);
+    ASSERT_EQUAL(copy.GetQueryCacheStats().hits, 0u);
+
+    // выключенный кэш не считает обращений, а выдача не меняется
+    const auto expected = server.FindTopDocuments("пушистый кот -ошейник"s);
+    server.SetQueryCacheCapacity(0);
+    const QueryCache::Stats stats = server.GetQueryCacheStats();
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот -ошейник"s), expected);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, stats.hits);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, stats.misses);
+
+    // кэш вытесняет давно не использованные запросы
+    QueryCache cache(QueryCache::SHARD_COUNT);
+    const QueryCache::View view = cache.GetView();
+    vector<uint32_t> plus_terms;
+    vector<uint32_t> minus_terms;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        view.Insert("запрос"s + to_string(i), 1, {i}, {});
+    }
+    size_t found = 0;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        if (view.Find("запрос"s + to_string(i), 1, plus_terms, minus_terms)) {
+            ASSERT_EQUAL(plus_terms, vector<uint32_t>{i});
+            ++found;
+        }
+    }
+    ASSERT(found > 0);
+    ASSERT(found <= QueryCache::SHARD_COUNT);
+    ASSERT(view.Find("запрос999"s, 1, plus_terms, minus_terms));
+    ASSERT(!view.Find("запрос999"s, 2, plus_terms, minus_terms));
+}
+
+// Проверка кэша выдачи FindTopDocuments
+void TestResultCache() {
+    SearchServer server("и в на"s);
+    server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(3, "ухоженный пёс выразительные глаза"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+    // по умолчанию кэш выключен
+    server.FindTopDocuments("пушистый кот"s);
+    ASSERT_EQUAL(server.GetResultCacheStats().misses, 0u);
+
+    server.SetResultCacheCapacity(1 << 20);
+    const auto expected = server.FindTopDocuments("пушистый кот"s);
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот"s), expected);
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, "кот пушистый кот"s), expected);
+    ASSERT_EQUAL(server.GetResultCacheStats().hits, 2u);
+    // другие статус, фильтр и кол-во документов - другие ключи
+    ASSERT(server.FindTopDocuments("пушистый кот"s, DocumentStatus::BANNED).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот"s, DocumentStatus::ACTUAL, 1).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот"s, DocumentFilter().SetIds({1})).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("пёс кот"s, DocumentFilter().SetStatuses({DocumentStatus::BANNED})).size(),
+                 1u);
+    // выдача по произвольному предикату не кэшируется
+    server.FindTopDocuments("пушистый кот"s, [](int, DocumentStatus, int) { return true; });
+    server.FindTopDocuments("пушистый кот"s, [](int, DocumentStatus, int) { return true; });
+    ASSERT_EQUAL(server.GetResultCacheStats().hits, 2u);
+    ASSERT_EQUAL(server.GetResultCacheStats().misses, 5u);
+
+    // изменение сервера делает выдачу устаревшей
+    const auto snapshot = server.GetSnapshot();
+    server.AddDocument(4, "пушистый кот"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот"s).size(), 3u);
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот"s).front().id, 4);
+    server.RemoveDocument(4);
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот"s).size(), 2u);
+    // снимок ищет по своей версии
+    ASSERT_EQUAL(snapshot.FindTopDocuments("пушистый кот"s), expected);
+    // удаление отсутствующего документа не создаёт новой версии, и выдача остаётся в кэше
+    const uint64_t hits = server.GetResultCacheStats().hits;
+    server.RemoveDocument(100);
+    server.RemoveDocument(execution::par, 100);
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот"s).size(), 2u);
+    ASSERT_EQUAL(server.GetResultCacheStats().hits, hits + 1);
+
+    // копия сервера после первого изменения ищет с пустым кэшем того же размера
+    SearchServer copy(server);
+    copy.AddDocument(5, "рыжий кот"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(copy.FindTopDocuments("пушистый кот"s).size(), 3u);
+    ASSERT_EQUAL(copy.GetResultCacheStats().hits, 0u);
+    ASSERT_EQUAL(copy.GetResultCacheStats().misses, 1u);
+
+    // частый ключ не вытесняется потоком однократных: в каждой части кэша помещается одна выдача
+    ResultCache cache(ResultCache::SHARD_COUNT * 400);
+    const ResultCache::View view = cache.GetView();
+    const DocumentFilter filter;
+    const vector<uint32_t> no_terms;
+    const vector<Document> documents = {Document(1, 0.5, 1)};
+    vector<Document> found;
+    const vector<uint32_t> hot_terms = {7};
+    const ResultCache::Key hot{hot_terms, no_terms, filter, 5};
+    for (int i = 0; i < 15; ++i) {
+        view.Find(1, hot, found);
+    }
+    view.Insert(1, hot, documents);
+    for (uint32_t i = 100; i < 1100; ++i) {
+        const vector<uint32_t> cold_terms = {i};
+        const ResultCache::Key cold{cold_terms, no_terms, filter, 5};
+        view.Find(1, cold, found);
+        view.Insert(1, cold, documents);
+    }
+    ASSERT(view.Find(1, hot, found));
+    ASSERT_EQUAL(found, documents);
+    ASSERT(!view.Find(2, hot, found));
+    const ResultCache::Stats stats = cache.GetStats();
+    ASSERT(stats.rejections > 0);
+    ASSERT_EQUAL(stats.hits, 1u);
+
+    // отвергнутая запись ничего не вытесняет. Ключи для проверки должны попасть в одну часть кэша с hot:
+    // в части пробного кэша помещается одна выдача, и ключ из той же части не вытесняет более частый hot
+    vector<vector<uint32_t>> same_shard_terms;
+    for (uint32_t i = 2000; same_shard_terms.size() < 2; ++i) {
+        ResultCache probe(ResultCache::SHARD_COUNT * 400);
+        const ResultCache::View probe_view = probe.GetView();
+        probe_view.Find(1, hot, found);
+        probe_view.Insert(1, hot, documents);
+        const vector<uint32_t> terms = {i};
+        probe_view.Insert(1, ResultCache::Key{terms, no_terms, filter, 5}, documents);
+        if (probe.GetStats().rejections == 1) {
+            same_shard_terms.push_back(terms);
+        }
+    }
+    // в части помещаются две короткие выдачи; длинной нужна вся часть, и её запрашивали чаще cold,
+    // но реже hot, поэтому она отвергается, а cold остаётся
+    ResultCache small_cache(ResultCache::SHARD_COUNT * 700);
+    const ResultCache::View small_view = small_cache.GetView();
+    const ResultCache::Key cold{same_shard_terms[0], no_terms, filter, 5};
+    const ResultCache::Key long_key{same_shard_terms[1], no_terms, filter, 5};
+    const vector<Document> long_documents(10, Document(1, 0.5, 1));
+    small_view.Find(1, cold, found);
+    small_view.Insert(1, cold, documents);
+    for (int i = 0; i < 5; ++i) {
+        small_view.Find(1, hot, found);
+    }
+    small_view.Insert(1, hot, documents);
+    for (int i = 0; i < 3; ++i) {
+        small_view.Find(1, long_key, found);
+    }
+    small_view.Insert(1, long_key, long_documents);
+    ASSERT_EQUAL(small_cache.GetStats().rejections, 1u);
+    ASSERT_EQUAL(small_cache.GetStats().evictions, 0u);
+    ASSERT(small_view.Find(1, cold, found));
+    ASSERT(small_view.Find(1, hot, found));
+}
+
+// Проверка, что пакетный поиск даёт те же выдачи, что и поиск по каждому запросу
+void TestFindTopDocumentsBatch() {
+    SearchServer server("и в на"s);
+    // часть документов заморожена в сегменты, остальные ищутся вне сегментов
+    server.SetSegmentDocumentCount(3);
+    server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(3, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(4, "ухоженный скворец евгений"s, DocumentStatus::BANNED, {9});
+    server.AddDocument(5, "пушистый пёс и белый хвост"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(6, "кот скворец"s, DocumentStatus::ACTUAL, {3});
+    server.RemoveDocument(2);
+    const vector<string> queries = {"пушистый кот"s, "белый пёс -хвост"s, "кот пушистый"s, "скворец"s,
+                                    "неизвестное слово"s, "пушистый кот"s, "-кот хвост"s, ""s};
+    const DocumentFilter filters[] = {DocumentFilter(DocumentStatus::ACTUAL),
+                                      DocumentFilter().SetStatuses({DocumentStatus::ACTUAL, DocumentStatus::BANNED}),
+                                      DocumentFilter().SetIds({1, 4, 5}).SetRatingRange(2, 10),
+                                      DocumentFilter().SetIds({})};
+    for (const DocumentFilter &filter : filters) {
+        for (const size_t max_count : {size_t{1}, static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)}) {
+            const auto results = server.FindTopDocumentsBatch(execution::par, queries, filter, max_count);
+            ASSERT_EQUAL(results.size(), queries.size());
+            for (size_t i = 0; i < queries.size(); ++i) {
+                ASSERT_EQUAL(results[i], server.FindTopDocuments(queries[i], filter, max_count));
+            }
+            ASSERT_EQUAL(server.FindTopDocumentsBatch(execution::seq, queries, filter, max_count), results);
+        }
+    }
+    ASSERT(server.FindTopDocumentsBatch(execution::par, {}).empty());
+
+    // пакет, общим словам которого не хватает объёма распаковки, ищется по частям: при одном байте каждый запрос
+    // с уже встречавшимся в части словом начинает новую часть, а 40 байт хватает на одно общее слово части
+    // (самый длинный список слова в сегменте - два вхождения по 16 байт)
+    const vector<string> shared_queries = {"пушистый кот"s, "кот -хвост"s, "белый кот"s, "пушистый пёс"s,
+                                           "пёс -хвост"s, "белый хвост скворец"s, "скворец -кот"s, "кот"s};
+    for (const size_t bytes : {size_t{1}, size_t{40}, BATCH_DECODED_BYTES}) {
+        server.SetBatchDecodedBytes(bytes);
+        const auto results = server.FindTopDocumentsBatch(execution::par, shared_queries);
+        ASSERT_EQUAL(results.size(), shared_queries.size());
+        for (size_t i = 0; i < shared_queries.size(); ++i) {
+            ASSERT_EQUAL_HINT(results[i], server.FindTopDocuments(shared_queries[i]), shared_queries[i]);
+        }
+        ASSERT_EQUAL(server.FindTopDocumentsBatch(execution::seq, shared_queries), results);
+    }
+    try {
+        server.SetBatchDecodedBytes(0);
+        ASSERT_HINT(false, "Zero batch decoded bytes must throw"s);
+    } catch (const invalid_argument &) {
+    }
+
+    // с кэшем выдачи повторный пакет берёт выдачи из кэша, одинаковые после разбора запросы пакета ищутся один раз:
+    // три запроса из пушистого кота и два без известных слов
+    server.SetResultCacheCapacity(1 << 20);
+    const auto expected = server.FindTopDocumentsBatch(execution::par, queries);
+    ASSERT_EQUAL(server.GetResultCacheStats().hits, 0u);
+    ASSERT_EQUAL(server.GetResultCacheStats().misses, queries.size() - 3);
+    ASSERT_EQUAL(server.FindTopDocumentsBatch(execution::par, queries), expected);
+    ASSERT_EQUAL(server.GetResultCacheStats().hits, queries.size() - 3);
+
+    // некорректный запрос выбрасывает исключение
+    try {
+        server.FindTopDocumentsBatch(execution::par, {"кот"s, "пёс --хвост"s});
+        ASSERT_HINT(false, "Invalid query must throw"s);
+    } catch (const invalid_argument &) {
+    }
+}
+
+// Проверка, что пул потоков выполняет каждую часть задачи один раз, в том числе во вложенных задачах,
+// передаёт исключения вызывающему и что сервер на пуле с любыми настройками ищет так же, как последовательно
+void TestThreadPool() {
+    ThreadPoolOptions options;
+    options.thread_count = 3;
+    const ThreadPool pool(options);
+    const ThreadPool::View &view = pool.GetView();
+    ASSERT_EQUAL(view.GetParallelism(), 4u);
+    vector<atomic<int>> calls(1000);
+    mutex threads_mutex;
+    set<thread::id> threads;
+    view.ForEachIndex(execution::par, calls.size(), [&calls, &threads_mutex, &threads](size_t i) {
+        ++calls[i];
+        const lock_guard lock(threads_mutex);
+        threads.insert(this_thread::get_id());
+    });
+    ASSERT(all_of(calls.begin(), calls.end(), [](const atomic<int> &count) { return count == 1; }));
+    ASSERT(threads.size() <= 4u);
+
+    // вложенные задачи выполняются на тех же потоках и не ждут друг друга вечно
+    atomic<size_t> nested_calls{0};
+    view.ForEachIndex(execution::par, 16, [&view, &nested_calls](size_t) {
+        view.ForEachIndex(execution::par, 100, [&nested_calls](size_t) {
+            ++nested_calls;
+        });
+    });
+    ASSERT_EQUAL(nested_calls.load(), 1600u);
+    const vector<int> values = {1, 3, 5, 8, 9};
+    ASSERT(view.AnyOf(execution::par, values.begin(), values.end(), [](int value) { return value % 2 == 0; }));
+    ASSERT(!view.AnyOf(execution::par, values.begin(), values.end(), [](int value) { return value > 9; }));
+    try {
+        view.ForEachIndex(execution::par, 100, [](size_t i) {
+            if (i == 57) {
+                throw out_of_range("part"s);
+            }
+        });
+        ASSERT_HINT(false, "Exception from a part must reach the caller"s);
+    } catch (const out_of_range &) {
+    }
+    // копия пула - новый пул с теми же настройками, View по умолчанию выполняет всё в вызывающем потоке
+    const ThreadPool copy(pool);
+    ASSERT_EQUAL(copy.GetOptions().thread_count, 3u);
+    ASSERT_EQUAL(ThreadPool::View().GetParallelism(), 1u);
+
+    SearchServer server("и в на"s);
+    server.SetSegmentDocumentCount(50);
+    mt19937 generator;
+    const vector<string> words = {"белый"s, "кот"s, "пёс"s, "хвост"s, "ошейник"s, "скворец"s, "модный"s};
+    auto random_text = [&generator, &words](int length) {
+        string text;
+        for (int i = 0; i < length; ++i) {
+            text += words[generator() % words.size()] + " "s;
+        }
+        return text;
+    };
+    vector<string> texts;
+    for (int id = 0; id < 300; ++id) {
+        texts.push_back(random_text(8));
+    }
+    vector<DocumentInput> documents;
+    for (int id = 0; id < 300; ++id) {
+        documents.push_back({id, texts[static_cast<size_t>(id)], DocumentStatus::ACTUAL, {id % 7}});
+    }
+    server.AddDocuments(execution::par, documents);
+    server.RemoveDocument(execution::par, 17);
+    const vector<string> queries = {"белый кот"s, "пёс -хвост"s, "скворец модный ошейник"s};
+    vector<vector<Document>> expected;
+    for (const string &query : queries) {
+        expected.push_back(server.FindTopDocuments(execution::seq, query));
+    }
+    for (const size_t thread_count : {0u, 1u, 4u}) {
+        for (const size_t max_parallelism : {0u, 1u, 2u}) {
+            ThreadPoolOptions server_options;
+            server_options.thread_count = thread_count;
+            server_options.max_parallelism = max_parallelism;
+            server.SetThreadPoolOptions(server_options);
+            ASSERT_EQUAL(server.GetThreadPoolOptions().thread_count, thread_count);
+            for (size_t i = 0; i < queries.size(); ++i) {
+                ASSERT_EQUAL(server.FindTopDocuments(execution::par, queries[i]), expected[i]);
+            }
+            ASSERT_EQUAL(server.FindTopDocumentsBatch(execution::par, queries), expected);
+            ASSERT_EQUAL(get<0>(server.MatchDocument(execution::par, "белый -кот"s, 5)),
+                         get<0>(server.MatchDocument("белый -кот"s, 5)));
+        }
+    }
+}
+
+// Проверка, что adaptive_execution выбирает последовательный поиск для дешёвых запросов и параллельный
+// для дорогих, показывает план в ExplainQuery и счётчиках и находит то же, что последовательный поиск
+void TestAdaptiveExecution() {
+    SearchServer server("и в на"s);
+    server.SetSegmentDocumentCount(4);
+    server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(3, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(4, "белый пёс и пушистый хвост"s, DocumentStatus::ACTUAL, {1, 2});
+    server.AddDocument(5, "кот скворец"s, DocumentStatus::ACTUAL, {3});
+    const vector<string> queries = {"пушистый кот"s, "белый пёс -хвост"s, "кот скворец -ошейник"s};
+
+    // запросы по четырём документам дешевле раздачи потокам
+    for (const string &query : queries) {
+        ASSERT_EQUAL(server.ExplainQuery(query).threads, 1u);
+        ASSERT_EQUAL(server.FindTopDocuments(adaptive_execution, query), server.FindTopDocuments(query));
+    }
+    ASSERT_EQUAL(server.ExplainQuery("пушистый кот"s).cost, 4u);
+    ASSERT_EQUAL(server.GetQueryPlannerStats().sequential_queries, 3u);
+    ASSERT_EQUAL(server.GetQueryPlannerStats().parallel_queries, 0u);
+
+    // с низкими порогами тот же запрос считается на всех потоках пула
+    ThreadPoolOptions options;
+    options.thread_count = 3;
+    server.SetThreadPoolOptions(options);
+    server.SetAdaptiveThresholds(1, 1);
+    ASSERT_EQUAL(server.ExplainQuery("пушистый кот"s).threads, 4u);
+    ASSERT_EQUAL(server.ExplainQuery("кот"s).threads, 2u);
+    ASSERT_EQUAL(server.ExplainQuery("неизвестное слово"s).threads, 1u);
+    for (const string &query : queries) {
+        ASSERT_EQUAL(server.FindTopDocuments(adaptive_execution, query), server.FindTopDocuments(query));
+        ASSERT_EQUAL(get<0>(server.MatchDocument(adaptive_execution, query, 2)),
+                     get<0>(server.MatchDocument(query, 2)));
+    }
+    ASSERT_EQUAL(server.FindTopDocumentsBatch(adaptive_execution, queries),
+                 server.FindTopDocumentsBatch(execution::seq, queries));
+    const QueryPlanner::Stats stats = server.GetQueryPlannerStats();
+    ASSERT_EQUAL(stats.parallel_queries, 4u);
+    ASSERT(stats.parallel_threads >= 2 * stats.parallel_queries);
+    ASSERT(stats.parallel_selections > 0);
+
+    // копия сервера считает свои планы с теми же порогами
+    SearchServer copy(server);
+    copy.AddDocument(6, "рыжий кот"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(copy.GetQueryPlannerStats().parallel_queries, 0u);
+    ASSERT_EQUAL(copy.ExplainQuery("пушистый кот"s).threads, 4u);
+}
+
+// Проверка, что потоковый поиск пакета отдаёт выдачу каждого запроса ровно один раз и ту же, что пакетный поиск,
+// и что склеенные выдачи ProcessQueriesJoined обходятся без копирования, в том числе пустые пакеты и выдачи
+void TestProcessQueriesStreaming() {
+    SearchServer server("и в на"s);
+    server.SetSegmentDocumentCount(2);
+    server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(3, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(4, "пушистый пёс и белый хвост"s, DocumentStatus::ACTUAL, {1, 2});
+    const vector<string> queries = {"неизвестное слово"s, "пушистый кот"s, "белый пёс -хвост"s, "кот пушистый"s,
+                                    ""s, "глаза"s};
+    const auto expected = server.FindTopDocumentsBatch(execution::seq, queries);
+    for (const size_t capacity : {size_t{0}, size_t{1} << 20, size_t{1} << 20}) {
+        server.SetResultCacheCapacity(capacity);
+        vector<vector<Document>> results(queries.size());
+        vector<int> calls(queries.size());
+        ProcessQueriesStreaming(server, queries, [&results, &calls](size_t i, vector<Document> documents) {
+            ++calls[i];
+            results[i] = move(documents);
+        });
+        ASSERT(all_of(calls.begin(), calls.end(), [](int count) { return count == 1; }));
+        ASSERT_EQUAL(results, expected);
+        fill(calls.begin(), calls.end(), 0);
+        server.FindTopDocumentsStream(execution::par, queries, [&calls](size_t i, vector<Document>) {
+            ++calls[i];
+        }, DocumentFilter().SetIds({}));
+        ASSERT(all_of(calls.begin(), calls.end(), [](int count) { return count == 1; }));
+    }
+
+    // выдача запроса с общими словами отдаётся после последнего сегмента с его плюс-словами: запрос со словом
+    // только вне сегментов - до обхода сегментов, со словом первого сегмента - до обхода второго, хотя
+    // в порядке поиска запросы идут наоборот (по id терминов: кот, ошейник, пёс)
+    SearchServer segmented(""s);
+    segmented.SetSegmentDocumentCount(2);
+    segmented.AddDocument(1, "кот"s, DocumentStatus::ACTUAL, {1});
+    segmented.AddDocument(2, "ошейник кот"s, DocumentStatus::ACTUAL, {2});
+    segmented.AddDocument(3, "кот хвост"s, DocumentStatus::ACTUAL, {3});
+    segmented.AddDocument(4, "хвост"s, DocumentStatus::ACTUAL, {4});
+    segmented.AddDocument(5, "пёс"s, DocumentStatus::ACTUAL, {5});
+    ASSERT_EQUAL(segmented.GetSegmentCount(), 3u);
+    const vector<string> shared_queries = {"кот -хвост"s, "ошейник -хвост"s, "пёс -хвост"s};
+    vector<size_t> delivered;
+    segmented.FindTopDocumentsStream(execution::seq, shared_queries,
+                                     [&segmented, &shared_queries, &delivered](size_t i, vector<Document> documents) {
+        ASSERT_EQUAL(documents, segmented.FindTopDocuments(shared_queries[i]));
+        delivered.push_back(i);
+    });
+    ASSERT_EQUAL(delivered, (vector<size_t>{2, 1, 0}));
+
+    const VectorWrapper joined = ProcessQueriesJoined(server, queries);
+    vector<Document> flat;
+    for (const auto &documents : expected) {
+        flat.insert(flat.end(), documents.begin(), documents.end());
+    }
+    ASSERT_EQUAL(joined.size(), flat.size());
+    ASSERT_EQUAL(vector<Document>(joined.begin(), joined.end()), flat);
+    ASSERT_EQUAL(joined.begin()->id, flat.front().id);
+    ASSERT_EQUAL(&*joined.begin(), joined.GetResults()[1].data());
+    const VectorWrapper empty_batch = ProcessQueriesJoined(server, {});
+    ASSERT(empty_batch.empty());
+    ASSERT(empty_batch.begin() == empty_batch.end());
+    const VectorWrapper empty_results = ProcessQueriesJoined(server, {"неизвестное слово"s, ""s});
+    ASSERT(empty_results.empty());
+    ASSERT(empty_results.begin() == empty_results.end());
+}
+
+// Проверка, что индекс из нескольких сегментов, в том числе слитых в фоне, даёт ту же выдачу, что и один сегмент
+void TestIndexSegments() {
+    mt19937 generator;
+    auto random_text = [&generator](int length) {
+        string text;
+        for (int i = 0; i < length; ++i) {
+            const double x = uniform_real_distribution<double>(0, 1)(generator);
+            text += "w"s + to_string(static_cast<int>(x * x * 60)) + " "s;
+        }
+        return text;
+    };
+
+    SearchServer reference("w1"s);
+    SearchServer server("w1"s);
+    server.SetSegmentDocumentCount(7);
+    ASSERT_EQUAL(server.GetSegmentCount(), 1u);
+    for (int id = 0; id < 500; ++id) {
+        const string text = random_text(uniform_int_distribution<int>(1, 20)(generator));
+        const auto status = static_cast<DocumentStatus>(uniform_int_distribution<int>(0, 3)(generator));
+        const int rating = uniform_int_distribution<int>(-3, 3)(generator);
+        reference.AddDocument(id, text, status, {rating});
+        server.AddDocument(id, text, status, {rating});
+        // удаляем и документы вне сегментов, и документы замороженных сегментов, пока идут слияния
+        if (id % 5 == 4) {
+            const int removed = uniform_int_distribution<int>(0, id)(generator);
+            reference.RemoveDocument(removed);
+            server.RemoveDocument(removed);
+        }
+    }
+    // пакет документов замораживается в сегмент целиком
+    vector<string> texts;
+    vector<DocumentInput> batch;
+    for (int id = 500; id < 600; ++id) {
+        texts.push_back(random_text(uniform_int_distribution<int>(1, 20)(generator)));
+    }
+    for (int id = 500; id < 600; ++id) {
+        batch.push_back({id, texts[static_cast<size_t>(id - 500)], DocumentStatus::ACTUAL, {id % 5}});
+    }
+    reference.AddDocuments(batch);
+    server.AddDocuments(execution::par, batch);
+    const SearchServer copy = server;
+
+    auto check = [&generator, &reference](const SearchServer &server, const string &hint) {
+        ASSERT_EQUAL_HINT(server.GetDocumentCount(), reference.GetDocumentCount(), hint);
+        for (int i = 0; i < 100; ++i) {
+            string query;
+            const int length = uniform_int_distribution<int>(1, 6)(generator);
+            for (int j = 0; j < length; ++j) {
+                query += (uniform_int_distribution<int>(0, 7)(generator) == 0 ? " -w"s : " w"s) +
+                         to_string(uniform_int_distribution<int>(0, 59)(generator));
+            }
+            ASSERT_EQUAL_HINT(server.FindTopDocuments(query), reference.FindTopDocuments(query), hint + query);
+            ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, query), reference.FindTopDocuments(query),
+                              hint + query);
+            const DocumentFilter filter = DocumentFilter().SetStatuses({DocumentStatus::ACTUAL,
+                                                                        DocumentStatus::BANNED}).SetRatingRange(-1, 3);
+            ASSERT_EQUAL_HINT(server.FindTopDocuments(query, filter, 20), reference.FindTopDocuments(query, filter, 20),
+                              hint + query);
+            ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, query, filter, 20),
+                              reference.FindTopDocuments(query, filter, 20), hint + query);
+        }
+    };
+    check(server, "Incorrect search over segments: "s);
+
+    // после слияния сегментов их остаётся немного, а выдача не меняется
+    server.WaitForMerges();
+    ASSERT(server.GetSegmentCount() <= 2 * SEGMENT_MERGE_FACTOR);
+    check(server, "Incorrect search over merged segments: "s);
+
+    // копия сервера разделяет с ним замороженные сегменты, но удаление из копии на сервер не влияет
+    SearchServer removed_copy = server;
+    for (int id = 0; id < 600; id += 3) {
+        removed_copy.RemoveDocument(id);
+    }
+    check(server, "Server changed after removing from copy: "s);
+    check(copy, "Incorrect search in copy made before merges: "s);
+    for (int id = 0; id < 600; id += 3) {
+        reference.RemoveDocument(id);
+    }
+    removed_copy.WaitForMerges();
+    check(removed_copy, "Incorrect search in copy after remove: "s);
+}
+
+void TestSnapshots() {
+    // снимок не видит изменений сервера, сделанных после его получения
+    {
+        SearchServer server("и в на"s);
+        server.SetSegmentDocumentCount(2);
+        server.AddDocument(1, "белый кот"s, DocumentStatus::ACTUAL, {1});
+        server.AddDocument(2, "чёрный кот"s, DocumentStatus::ACTUAL, {2});
+        server.AddDocument(3, "рыжий кот"s, DocumentStatus::ACTUAL, {3});
+        const SearchServer::Snapshot snapshot = server.GetSnapshot();
+        const vector<Document> found = snapshot.FindTopDocuments("кот белый"s);
+
+        server.RemoveDocument(1);
+        server.RemoveDocument(3);
+        server.AddDocument(4, "серый кот"s, DocumentStatus::ACTUAL, {4});
+        server.AddDocument(1, "белый пёс"s, DocumentStatus::ACTUAL, {5});
+        server.WaitForMerges();
+
+        ASSERT_EQUAL_HINT(snapshot.GetDocumentCount(), 3, "Snapshot sees documents added or removed later"s);
+        ASSERT_EQUAL_HINT(snapshot.FindTopDocuments("кот белый"s), found, "Snapshot search changed with server"s);
+        ASSERT_EQUAL(snapshot.GetDocumentFreq("кот"s), 3);
+        ASSERT_EQUAL(snapshot.GetDocumentFreq("пёс"s), 0);
+        ASSERT_EQUAL(snapshot.GetWordFrequencies(3).size(), 2u);
+        const auto [snapshot_words, snapshot_status] = snapshot.MatchDocument("белый пёс"s, 1);
+        ASSERT_EQUAL(snapshot_words, vector<string_view>{"белый"sv});
+        try {
+            snapshot.MatchDocument("серый"s, 4);
+            ASSERT_HINT(false, "Snapshot sees document added later"s);
+        } catch (const out_of_range &) {
+        }
+
+        ASSERT_EQUAL(server.GetDocumentCount(), 3);
+        ASSERT_EQUAL(server.GetDocumentFreq("кот"s), 2);
+        const auto [words, status] = server.MatchDocument("белый пёс"s, 1);
+        ASSERT_EQUAL(words, (vector<string_view>{"белый"sv, "пёс"sv}));
+        ASSERT(server.GetWordFrequencies(3).empty());
+    }
+
+    // снимок переживает сервер, а слова в его выдаче остаются действительными
+    {
+        const SearchServer::Snapshot snapshot = [] {
+            SearchServer server("и в на"s);
+            server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8});
+            server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::BANNED, {7});
+            return server.GetSnapshot();
+        }();
+        const auto [words, status] = snapshot.MatchDocument("пушистый хвост"s, 2);
+        ASSERT_EQUAL(words, (vector<string_view>{"пушистый"sv, "хвост"sv}));
+        ASSERT_EQUAL(static_cast<int>(status), static_cast<int>(DocumentStatus::BANNED));
+        ASSERT_EQUAL(snapshot.FindTopDocuments("кот"s).size(), 1u);
+        ASSERT_EQUAL(snapshot.GetWordFrequencies(1).count("ошейник"sv), 1u);
+    }
+
+    // поиск идёт одновременно с добавлением и удалением документов: выдача снимка согласована с ним самим
+    {
+        SearchServer server("и в на"s);
+        server.SetSegmentDocumentCount(16);
+        const int document_count = 2000;
+        atomic<bool> done = false;
+        thread writer([&server, &done] {
+            for (int id = 0; id < document_count; ++id) {
+                server.AddDocument(id, "common w"s + to_string(id % 50), DocumentStatus::ACTUAL, {id % 7});
+                if (id % 3 == 2) {
+                    server.RemoveDocument(id - 1);
+                }
+            }
+            done = true;
+        });
+        vector<thread> readers;
+        for (int reader = 0; reader < 2; ++reader) {
+            readers.emplace_back([&server, &done] {
+                do {
+                    const SearchServer::Snapshot snapshot = server.GetSnapshot();
+                    const vector<Document> found = snapshot.FindTopDocuments("common"s, DocumentStatus::ACTUAL,
+                                                                             document_count);
+                    ASSERT_EQUAL_HINT(found.size(), static_cast<size_t>(snapshot.GetDocumentCount()),
+                                      "Snapshot search misses or duplicates documents"s);
+                    ASSERT_EQUAL(snapshot.GetDocumentFreq("common"s), snapshot.GetDocumentCount());
+                    ASSERT_EQUAL_HINT(snapshot.FindTopDocuments(execution::par, "common -w7"s,
+                                                                DocumentStatus::ACTUAL, document_count),
+                                      snapshot.FindTopDocuments("common -w7"s, DocumentStatus::ACTUAL,
+                                                                document_count),
+                                      "Snapshot search is not stable"s);
+                    ASSERT(server.FindTopDocuments("w1"s).size() <= MAX_RESULT_DOCUMENT_COUNT);
+                } while (!done);
+            });
+        }
+        writer.join();
+        for (thread &reader : readers) {
+            reader.join();
+        }
+        ASSERT_EQUAL(server.GetDocumentCount(), document_count - document_count / 3);
+        ASSERT_EQUAL(server.FindTopDocuments("common"s, DocumentStatus::ACTUAL, document_count).size(),
+                     static_cast<size_t>(server.GetDocumentCount()));
+    }
+}
+
+void TestCompaction() {
+    mt19937 generator;
+    vector<string> texts;
+    for (int id = 0; id < 300; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 15)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += "w"s + to_string(uniform_int_distribution<int>(0, 40)(generator)) + " "s;
+        }
+        texts.push_back(text);
+    }
+    SearchServer server("w1"s);
+    server.SetSegmentDocumentCount(8);
+    for (int id = 0; id < 300; ++id) {
+        server.AddDocument(id, texts[static_cast<size_t>(id)], DocumentStatus::ACTUAL, {id % 7});
+    }
+    server.WaitForMerges();
+    const SearchServer::Snapshot before = server.GetSnapshot();
+    const vector<Document> found_before = before.FindTopDocuments("w2 w3 -w4"s, DocumentStatus::ACTUAL, 300);
+
+    // удаление только отмечает документы, выдача и IDF совпадают с сервером, в который их не добавляли.
+    // Фоновая перестройка сегментов на время удаления выключена, поэтому все удалённые остаются в сегментах
+    server.SetCompactionRemovedShare(2);
+    SearchServer reference("w1"s);
+    for (int id = 0; id < 300; ++id) {
+        if (id % 3 == 0) {
+            server.RemoveDocument(id);
+        } else {
+            reference.AddDocument(id, texts[static_cast<size_t>(id)], DocumentStatus::ACTUAL, {id % 7});
+        }
+    }
+    auto check = [&server, &reference](const string &hint) {
+        ASSERT_EQUAL_HINT(server.GetDocumentCount(), reference.GetDocumentCount(), hint);
+        for (int word = 0; word <= 40; ++word) {
+            const string query = "w"s + to_string(word) + " w"s + to_string((word * 7) % 41) + " -w"s +
+                                 to_string((word * 5) % 41);
+            ASSERT_EQUAL_HINT(server.GetDocumentFreq("w"s + to_string(word)),
+                              reference.GetDocumentFreq("w"s + to_string(word)), hint + query);
+            ASSERT_EQUAL_HINT(server.FindTopDocuments(query, DocumentStatus::ACTUAL, 300),
+                              reference.FindTopDocuments(query, DocumentStatus::ACTUAL, 300), hint + query);
+            ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, 300),
+                              reference.FindTopDocuments(query, DocumentStatus::ACTUAL, 300), hint + query);
+        }
+    };
+    ASSERT_EQUAL(server.GetRemovedDocumentCount(), 100u);
+    check("Incorrect search after remove: "s);
+
+    // перестроенные сегменты не содержат удалённых документов, а снимок до удаления их по-прежнему видит
+    server.Compact();
+    ASSERT_EQUAL(server.GetRemovedDocumentCount(), 0u);
+    check("Incorrect search after compaction: "s);
+    ASSERT_EQUAL_HINT(before.FindTopDocuments("w2 w3 -w4"s, DocumentStatus::ACTUAL, 300), found_before,
+                      "Snapshot changed after compaction"s);
+
+    // сегменты с большой долей удалённых документов перестраиваются в фоне сами (удалённые за время
+    // перестройки документы остаются в сегменте, пока их доля снова не вырастет)
+    server.SetCompactionRemovedShare(COMPACTION_REMOVED_SHARE);
+    for (int id = 1; id < 300; id += 3) {
+        server.RemoveDocument(id);
+    }
+    SearchServer rest("w1"s);
+    for (int id = 2; id < 300; id += 3) {
+        rest.AddDocument(id, texts[static_cast<size_t>(id)], DocumentStatus::ACTUAL, {id % 7});
+    }
+    reference = rest;
+    server.WaitForMerges();
+    ASSERT_HINT(server.GetRemovedDocumentCount() < 100u, "Segments with removed documents are not compacted"s);
+    check("Incorrect search after background compaction: "s);
+}
+
+void TestIndexFile() {
+    mt19937 generator;
+    vector<string> texts;
+    for (int id = 0; id < 400; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 15)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += "w"s + to_string(uniform_int_distribution<int>(0, 60)(generator)) + " "s;
+        }
+        texts.push_back(text);
+    }
+    // в сервере есть сегменты с удалёнными документами и документы вне сегментов, в том числе удалённые
+    SearchServer server("w1 w2"s);
+    server.SetSegmentDocumentCount(16);
+    for (int id = 0; id < 300; ++id) {
+        server.AddDocument(id, texts[static_cast<size_t>(id)], static_cast<DocumentStatus>(id % 3), {id % 7});
+    }
+    for (int id = 0; id < 300; id += 7) {
+        server.RemoveDocument(id);
+    }
+    const string path = (filesystem::temp_directory_path() / "search_server_test_index.bin"s).string();
+    server.SaveIndex(path);
+    SearchServer opened = SearchServer::OpenIndex(path);
+
+    auto check = [&server, &opened](const string &hint) {
+        ASSERT_EQUAL_HINT(opened.GetDocumentCount(), server.GetDocumentCount(), hint);
+        ASSERT_HINT(equal(opened.begin(), opened.end(), server.begin(), server.end()), hint + "document ids"s);
+        for (int word = 0; word <= 60; ++word) {
+            const string query = "w"s + to_string(word) + " w"s + to_string((word * 7) % 61) + " -w"s +
+                                 to_string((word * 5) % 61);
+            ASSERT_EQUAL_HINT(opened.GetDocumentFreq("w"s + to_string(word)),
+                              server.GetDocumentFreq("w"s + to_string(word)), hint + query);
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                ASSERT_EQUAL_HINT(opened.FindTopDocuments(query, status, 400),
+                                  server.FindTopDocuments(query, status, 400), hint + query);
+                ASSERT_EQUAL_HINT(opened.FindTopDocuments(execution::par, query, status, 400),
+                                  server.FindTopDocuments(query, status, 400), hint + query);
+            }
+        }
+        for (const int id : {1, 7, 8, 299}) {
+            ASSERT_HINT(opened.GetWordFrequencies(id) == server.GetWordFrequencies(id), hint + "word frequencies"s);
+            if (server.GetWordFrequencies(id).empty()) {
+                continue;
+            }
+            ASSERT_HINT(opened.MatchDocument("w3 w4 w5 w6"s, id) == server.MatchDocument("w3 w4 w5 w6"s, id),
+                        hint + "match"s);
+        }
+    };
+    check("Incorrect search in opened index: "s);
+    ASSERT_EQUAL(opened.GetRemovedDocumentCount(), server.GetRemovedDocumentCount());
+
+    // изменения открытого сервера не трогают файл: добавление, удаление, слияние и уплотнение сегментов
+    for (int id = 300; id < 400; ++id) {
+        server.AddDocument(id, texts[static_cast<size_t>(id)], static_cast<DocumentStatus>(id % 3), {id % 7});
+        opened.AddDocument(id, texts[static_cast<size_t>(id)], static_cast<DocumentStatus>(id % 3), {id % 7});
+    }
+    for (int id = 3; id < 400; id += 5) {
+        server.RemoveDocument(id);
+        opened.RemoveDocument(id);
+    }
+    check("Incorrect search after changing opened index: "s);
+    opened.WaitForMerges();
+    opened.Compact();
+    check("Incorrect search after compacting opened index: "s);
+    const SearchServer reopened = SearchServer::OpenIndex(path);
+    ASSERT_EQUAL_HINT(reopened.GetDocumentCount(), 300 - 43, "Index file changed with opened server"s);
+
+    // сохранённый заново открытый сервер открывается так же
+    opened.SaveIndex(path);
+    opened = SearchServer::OpenIndex(path);
+    check("Incorrect search in reopened index: "s);
+
+    // чужие и повреждённые файлы не открываются
+    {
+        ofstream out(path, ios::binary | ios::trunc);
+        out << "not an index file at all"s;
+    }
+    bool thrown = false;
+    try {
+        SearchServer::OpenIndex(path);
+    } catch (const runtime_error &) {
+        thrown = true;
+    }
+    ASSERT_HINT(thrown, "Opened file that is not an index"s);
+    server.SaveIndex(path);
+    filesystem::resize_file(path, filesystem::file_size(path) - 8);
+    thrown = false;
+    try {
+        SearchServer::OpenIndex(path);
+    } catch (const runtime_error &) {
+        thrown = true;
+    }
+    ASSERT_HINT(thrown, "Opened truncated index file"s);
+
+    // повреждённые заголовки блоков списков вхождений не открываются, а повреждённые данные блоков и термины
+    // прямого индекса обнаруживаются при первом чтении (в заголовке блока за тремя id/смещениями и оценкой
+    // term_freq идут байты size, delta_bits, count_bits, tag_bits и tag_mask)
+    server.SaveIndex(path);
+    string corrupted_word;
+    auto corrupt = [&path, &corrupted_word](size_t offset, const string &bytes, const string &hint) {
+        const string copy_path = path + ".corrupted"s;
+        filesystem::copy_file(path, copy_path, filesystem::copy_options::overwrite_existing);
+        {
+            fstream out(copy_path, ios::binary | ios::in | ios::out);
+            out.seekp(static_cast<streamoff>(offset));
+            out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+        }
+        bool corrupted_thrown = false;
+        try {
+            const SearchServer opened = SearchServer::OpenIndex(copy_path);
+            for (const int document_id : opened) {
+                opened.GetWordFrequencies(document_id);
+            }
+            opened.FindTopDocuments(corrupted_word);
+        } catch (const runtime_error &) {
+            corrupted_thrown = true;
+        }
+        filesystem::remove(copy_path);
+        ASSERT_HINT(corrupted_thrown, hint);
+    };
+    size_t block_offset = 0;
+    size_t data_offset = 0;
+    size_t document_terms_offset = 0;
+    {
+        const IndexFile file(path);
+        const char *const base = static_cast<const char*>(file.GetStorage().get());
+        size_t size = 0;
+        const char *const postings = file.GetSection(IndexSection::POSTINGS, size);
+        // берётся список, в первом блоке которого id документов идут не подряд
+        const auto terms = file.GetArray<SegmentTermRecord>(IndexSection::SEGMENT_TERMS);
+        const auto it = find_if(terms.data.get(), terms.data.get() + terms.size, [postings](const auto &term) {
+            return term.postings.block_count > 0 && postings[term.postings.block_offset + 17] != 0;
+        });
+        ASSERT(it != terms.data.get() + terms.size);
+        block_offset = static_cast<size_t>(postings - base) + it->postings.block_offset;
+        data_offset = static_cast<size_t>(postings - base) + it->postings.data_offset;
+        // первый документ удалён, поэтому портится первый термин второго (id термина и кол-во - два uint32_t)
+        const auto document_term_offsets = file.GetArray<size_t>(IndexSection::DOCUMENT_TERM_OFFSETS);
+        document_terms_offset = static_cast<size_t>(file.GetSection(IndexSection::DOCUMENT_TERMS, size) - base) +
+                                document_term_offsets.data.get()[1] * 2 * sizeof(uint32_t);
+        const auto words = file.GetArray<char>(IndexSection::TERM_WORDS);
+        const auto word_ends = file.GetArray<uint64_t>(IndexSection::TERM_WORD_ENDS);
+        const size_t word_begin = it->term_id == 0 ? 0 : static_cast<size_t>(word_ends.data.get()[it->term_id - 1]);
+        corrupted_word.assign(words.data.get() + word_begin,
+                              static_cast<size_t>(word_ends.data.get()[it->term_id]) - word_begin);
+    }
+    corrupt(block_offset + 16, "\xff"s, "Opened index with oversized posting block"s);
+    corrupt(block_offset + 16, "\0"s, "Opened index with empty posting block"s);
+    corrupt(block_offset + 17, "\x40"s, "Opened index with too wide posting block"s);
+    corrupt(block_offset + 8, "\xff\xff\xff\x7f"s,
+            "Opened index with posting block outside the section"s);
+    corrupt(block_offset + 12, "\xff\xff\xff\xff"s, "Opened index with invalid term_freq bound"s);
+    corrupt(block_offset + 20, "\0"s, "Opened index with empty tag mask"s);
+    corrupt(data_offset, "\xff\xff\xff\xff"s,
+            "Searched index with broken posting block data"s);
+    corrupt(document_terms_offset, "\xff\xff\xff\xff"s,
+            "Read index with unknown document term"s);
+    filesystem::remove(path);
+}
+
+// Тест проверяет восстановление сервера из журнала изменений и из файла индекса с журналом
+void TestWriteAheadLog() {
+    mt19937 generator;
+    vector<string> texts;
+    for (int id = 0; id < 300; ++id) {
+        string text;
+        const int length = uniform_int_distribution<int>(1, 15)(generator);
+        for (int i = 0; i < length; ++i) {
+            text += "w"s + to_string(uniform_int_distribution<int>(0, 60)(generator)) + " "s;
+        }
+        texts.push_back(text);
+    }
+    // изменения до сохранения индекса: по одному документу, пакетом и удаления
+    auto apply_first = [&texts](SearchServer &server) {
+        server.SetSegmentDocumentCount(16);
+        for (int id = 0; id < 120; ++id) {
+            server.AddDocument(id, texts[static_cast<size_t>(id)], static_cast<DocumentStatus>(id % 3), {id % 7});
+        }
+        vector<DocumentInput> documents;
+        for (int id = 120; id < 200; ++id) {
+            documents.push_back(DocumentInput{id, texts[static_cast<size_t>(id)], DocumentStatus::ACTUAL, {id}});
+        }
+        server.AddDocuments(documents);
+        for (int id = 0; id < 200; id += 7) {
+            server.RemoveDocument(id);
+        }
+    };
+    // изменения после сохранения индекса, последнее - удаление документа 299
+    auto apply_second = [&texts](SearchServer &server) {
+        for (int id = 200; id < 300; ++id) {
+            server.AddDocument(id, texts[static_cast<size_t>(id)], DocumentStatus::BANNED, {-id});
+        }
+        for (int id = 3; id < 300; id += 5) {
+            server.RemoveDocument(id);
+        }
+        server.SetSegmentDocumentCount(32);
+        server.RemoveDocument(299);
+    };
+    auto check = [](const SearchServer &recovered, const SearchServer &expected, const string &hint) {
+        ASSERT_EQUAL_HINT(recovered.GetDocumentCount(), expected.GetDocumentCount(), hint);
+        ASSERT_HINT(equal(recovered.begin(), recovered.end(), expected.begin(), expected.end()), hint + "document ids"s);
+        for (int word = 0; word <= 60; ++word) {
+            const string query = "w"s + to_string(word) + " w"s + to_string((word * 7) % 61);
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                ASSERT_EQUAL_HINT(recovered.FindTopDocuments(query, status, 300),
+                                  expected.FindTopDocuments(query, status, 300), hint + query);
+            }
+        }
+    };
+    const string log_path = (filesystem::temp_directory_path() / "search_server_test_log.bin"s).string();
+    const string index_path = (filesystem::temp_directory_path() / "search_server_test_log_index.bin"s).string();
+    filesystem::remove(log_path);
+
+    SearchServer expected("w1 w2"s);
+    apply_first(expected);
+    {
+        // журнал сбрасывается на диск только при закрытии
+        SearchServer server("w1 w2"s);
+        server.AttachLog(log_path, LogOptions{0});
+        apply_first(server);
+    }
+    {
+        // восстановленный из журнала сервер продолжает его, сохраняет индекс и очищает журнал
+        SearchServer recovered("w1 w2"s);
+        recovered.AttachLog(log_path);
+        check(recovered, expected, "Incorrect search after log replay: "s);
+        recovered.Checkpoint(index_path);
+        apply_second(recovered);
+    }
+    apply_second(expected);
+    {
+        SearchServer recovered = SearchServer::OpenIndex(index_path);
+        recovered.AttachLog(log_path);
+        check(recovered, expected, "Incorrect search after index and log replay: "s);
+    }
+
+    // оборванная при сбое последняя запись отбрасывается, а журнал продолжается с её места
+    filesystem::resize_file(log_path, filesystem::file_size(log_path) - 3);
+    {
+        SearchServer recovered = SearchServer::OpenIndex(index_path);
+        recovered.AttachLog(log_path, LogOptions{64});
+        ASSERT_EQUAL_HINT(recovered.GetDocumentCount(), expected.GetDocumentCount() + 1, "Torn record replayed"s);
+        recovered.RemoveDocument(299);
+    }
+    {
+        SearchServer recovered = SearchServer::OpenIndex(index_path);
+        recovered.AttachLog(log_path);
+        check(recovered, expected, "Incorrect search after torn log tail: "s);
+    }
+
+    // журнал после сохранения индекса не продолжает пустой сервер, а чужой файл - не журнал
+    bool thrown = false;
+    try {
+        SearchServer server("w1 w2"s);
+        server.AttachLog(log_path);
+    } catch (const runtime_error &) {
+        thrown = true;
+    }
+    ASSERT_HINT(thrown, "Replayed log that doesn't continue the server"s);
+    thrown = false;
+    try {
+        SearchServer server("w1 w2"s);
+        server.AttachLog(index_path);
+    } catch (const runtime_error &) {
+        thrown = true;
+    }
+    ASSERT_HINT(thrown, "Replayed file that is not a log"s);
+
+    // запись с верной контрольной суммой, но несуществующим статусом документа считается повреждённой
+    filesystem::remove(log_path);
+    {
+        SearchServer server("w1 w2"s);
+        server.AttachLog(log_path);
+        server.AddDocument(0, texts[0], DocumentStatus::ACTUAL, {});
+    }
+    {
+        // заголовок журнала (16 байт), заголовок записи (8), номер (8), тип (4), id документа (4), статус
+        const streamoff record_offset = 16;
+        const streamoff payload_offset = record_offset + 8;
+        const streamoff status_offset = payload_offset + 16;
+        fstream file(log_path, ios::in | ios::out | ios::binary);
+        uint32_t payload_size = 0;
+        file.seekg(record_offset);
+        file.read(reinterpret_cast<char*>(&payload_size), sizeof(payload_size));
+        vector<char> payload(payload_size);
+        file.seekg(payload_offset);
+        file.read(payload.data(), static_cast<streamsize>(payload.size()));
+        const int32_t status = 7;
+        memcpy(payload.data() + (status_offset - payload_offset), &status, sizeof(status));
+        const uint32_t checksum = ComputeCrc32c(payload.data(), payload.size());
+        file.seekp(record_offset + 4);
+        file.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+        file.write(payload.data(), static_cast<streamsize>(payload.size()));
+    }
+    {
+        SearchServer recovered("w1 w2"s);
+        recovered.AttachLog(log_path);
+        ASSERT_EQUAL_HINT(recovered.GetDocumentCount(), 0, "Replayed record with invalid status"s);
+    }
+
+#if !defined(_WIN32)
+    // изменение, которое не удалось записать в журнал (файл упёрся в предел размера), не применяется,
+    // а журнал остаётся целым и продолжается следующими изменениями
+    filesystem::remove(log_path);
+    {
+        SearchServer server("w1 w2"s);
+        server.AttachLog(log_path);
+        for (int id = 0; id < 10; ++id) {
+            server.AddDocument(id, texts[static_cast<size_t>(id)], DocumentStatus::ACTUAL, {id});
+        }
+        const vector<Document> found = server.FindTopDocuments("w3 w5 w7"s, DocumentStatus::ACTUAL, 300);
+        rlimit limit{};
+        getrlimit(RLIMIT_FSIZE, &limit);
+        const rlimit saved_limit = limit;
+        limit.rlim_cur = static_cast<rlim_t>(filesystem::file_size(log_path) + 8);
+        const auto saved_handler = signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limit);
+        const auto check_failed = [](const function<void()> &change, const string &hint) {
+            bool failed = false;
+            try {
+                change();
+            } catch (const runtime_error &) {
+                failed = true;
+            }
+            ASSERT_HINT(failed, hint);
+        };
+        check_failed([&server, &texts] {
+            server.AddDocument(10, texts[10], DocumentStatus::ACTUAL, {10});
+        }, "Unlogged document added"s);
+        check_failed([&server, &texts] {
+            server.AddDocuments({DocumentInput{11, texts[11], DocumentStatus::ACTUAL, {}},
+                                 DocumentInput{12, texts[12], DocumentStatus::ACTUAL, {}}});
+        }, "Unlogged documents added"s);
+        check_failed([&server] {
+            server.RemoveDocument(3);
+        }, "Unlogged document removed"s);
+        setrlimit(RLIMIT_FSIZE, &saved_limit);
+        signal(SIGXFSZ, saved_handler);
+        ASSERT_EQUAL_HINT(server.GetDocumentCount(), 10, "Unlogged change applied"s);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments("w3 w5 w7"s, DocumentStatus::ACTUAL, 300), found,
+                          "Unlogged change visible"s);
+
+        server.AddDocument(10, texts[10], DocumentStatus::ACTUAL, {10});
+        server.RemoveDocument(3);
+        SearchServer recovered("w1 w2"s);
+        recovered.AttachLog(log_path);
+        ASSERT_EQUAL_HINT(recovered.GetDocumentCount(), 10, "Incorrect log replay after failed append"s);
+        ASSERT_HINT(equal(recovered.begin(), recovered.end(), server.begin(), server.end()),
+                    "Incorrect log replay after failed append"s);
+    }
+#endif
+    filesystem::remove(log_path);
+    filesystem::remove(index_path);
+}
+
 // Проверка удаления дубликатов
 void TestRemoveDuplicates() {
  // добавить тесты !!!
@@ -506,18 +2305,40 @@ void TestRemoveDuplicates() {
 void TestSearchServer() {
     RUN_TEST(TestInitServer);
     RUN_TEST(TestAddDocuments);
+    RUN_TEST(TestAddDocumentsBatch);
     RUN_TEST(TestRemoveDocument);
     RUN_TEST(TestExcludeIncorrectFindDocuments);
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
+    RUN_TEST(TestStopWordSet);
     RUN_TEST(TestExcludeDocumentsWithMinusWords);
     RUN_TEST(TestDocumentsMatching);
     RUN_TEST(TestDocumentsMatching_PAR);
+    RUN_TEST(TestMatchDocuments);
     RUN_TEST(TestFindedDocumentsSort);
     RUN_TEST(TestComputeAverageRating);
     RUN_TEST(TestFindedDocumentsPredicate);
     RUN_TEST(TestFindedDocumentsStatus);
     RUN_TEST(TestFindedDocumentsRelevance);
     RUN_TEST(TestGetWordFrequencies);
+    RUN_TEST(TestCollectionStatistics);
+    RUN_TEST(TestForEachWord);
+    RUN_TEST(TestTermDictionary);
+    RUN_TEST(TestPostingList);
+    RUN_TEST(TestScoreAccumulator);
+    RUN_TEST(TestFindTopDocumentsCount);
+    RUN_TEST(TestFindTopDocumentsPruning);
+    RUN_TEST(TestQueryScratch);
+    RUN_TEST(TestQueryCache);
+    RUN_TEST(TestResultCache);
+    RUN_TEST(TestFindTopDocumentsBatch);
+    RUN_TEST(TestThreadPool);
+    RUN_TEST(TestAdaptiveExecution);
+    RUN_TEST(TestProcessQueriesStreaming);
+    RUN_TEST(TestIndexSegments);
+    RUN_TEST(TestSnapshots);
+    RUN_TEST(TestCompaction);
+    RUN_TEST(TestIndexFile);
+    RUN_TEST(TestWriteAheadLog);
     RUN_TEST(TestRemoveDuplicates);
 }
 // --------- Окончание модульных тестов поисковой системы -----------
@@ -0,0 +1,49 @@
+#include "stop_word_set.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+StopWordSet::StopWordSet(const vector<string_view> &words) {
+    size_t total_size = 0;
+    for (const string_view word : words) {
+        if (!StopWordTable::IsValid(word)) {
+            throw invalid_argument("Document contain service symbols"s);
+        }
+        total_size += word.size();
+    }
+    // слова копируются подряд в один буфер, который уже не перемещается
+    storage_.resize(total_size);
+    own_slots_.resize(StopWordTable::SlotCount(words.size()));
+    size_t offset = 0;
+    for (const string_view word : words) {
+        if (word.empty()) {
+            continue;
+        }
+        memcpy(storage_.data() + offset, word.data(), word.size());
+        if (StopWordTable::Insert(own_slots_, own_filter_, string_view(storage_.data() + offset, word.size()))) {
+            offset += word.size();
+            ++size_;
+        }
+    }
+    slots_ = own_slots_.data();
+    slot_mask_ = own_slots_.size() - 1;
+    filter_ = own_filter_.data();
+}
+
+vector<string_view> StopWordSet::GetWords() const {
+    vector<string_view> words;
+    words.reserve(size_);
+    for (size_t slot = 0; slot <= slot_mask_; ++slot) {
+        if (!slots_[slot].empty()) {
+            words.push_back(slots_[slot]);
+        }
+    }
+    sort(words.begin(), words.end());
+    return words;
+}
+
+size_t StopWordSet::size() const {
+    return size_;
+}
@@ -2,6 +2,17 @@
 
 #include <sstream>
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define SEARCH_SERVER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define SEARCH_SERVER_TARGET_AVX2
+#else
+// функция собирается с AVX2 независимо от флагов сборки и вызывается, только если процессор его поддерживает
+#define SEARCH_SERVER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 using namespace std;
 
 vector<string> SplitIntoWords(const string &text) {
@@ -18,18 +29,117 @@ vector<string> SplitIntoWords(const string &text) {
 
 vector<string_view> SplitIntoWordsView(string_view str) {
     vector<string_view> result;
-    const int64_t pos_end = static_cast<int64_t>(str.npos);
-    while (true) {
-        int64_t space = static_cast<int64_t>(str.find(' '));
-        string_view s = str.substr(0, static_cast<size_t>(space));
-        if (!s.empty()) {
-            result.push_back(s);
-        }
-        if (space == pos_end) {
-            break;
-        } else {
-            str.remove_prefix(static_cast<size_t>(space+1));
-        }
-    }
+    ForEachWord(str, [&result](string_view word) {
+        result.push_back(word);
+    });
     return result;
 }
+
+namespace {
+
+// возвращает старшие биты байтов x как 8-битную маску: бит i - старший бит байта i
+uint64_t GatherHighBits(uint64_t x) {
+    return (((x >> 7) & 0x0101010101010101ull) * 0x0102040810204080ull) >> 56;
+}
+
+// возвращает слово со старшим битом в каждом нулевом байте x и только в них
+uint64_t FindZeroBytes(uint64_t x) {
+    const uint64_t low_bits = 0x7F7F7F7F7F7F7F7Full;
+    return ~(((x & low_bits) + low_bits) | x | low_bits);
+}
+
+TextBlockMasks ScanTextBlockScalar(const char *block) {
+    TextBlockMasks masks;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; ++i) {
+        const unsigned char c = static_cast<unsigned char>(block[i]);
+        masks.spaces |= uint64_t{c == ' '} << i;
+        masks.controls |= uint64_t{c < ' '} << i;
+    }
+#else
+    // по 8 байт в 64-битном слове: пробел - нулевой байт после xor с пробелами, управляющий символ -
+    // нулевой байт после сброса младших 5 битов
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; i += 8) {
+        uint64_t bytes;
+        memcpy(&bytes, block + i, sizeof(bytes));
+        masks.spaces |= GatherHighBits(FindZeroBytes(bytes ^ 0x2020202020202020ull)) << i;
+        masks.controls |= GatherHighBits(FindZeroBytes(bytes & 0xE0E0E0E0E0E0E0E0ull)) << i;
+    }
+#endif
+    return masks;
+}
+
+#if defined(SEARCH_SERVER_X86)
+
+// байт x - управляющий символ, если min(x, 31) == x без учёта знака
+TextBlockMasks ScanTextBlockSse2(const char *block) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i last_control = _mm_set1_epi8(' ' - 1);
+    TextBlockMasks masks;
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        const uint32_t spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)));
+        const uint32_t controls = static_cast<uint32_t>(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_min_epu8(bytes, last_control), bytes)));
+        masks.spaces |= uint64_t{spaces} << i;
+        masks.controls |= uint64_t{controls} << i;
+    }
+    return masks;
+}
+
+SEARCH_SERVER_TARGET_AVX2
+TextBlockMasks ScanTextBlockAvx2(const char *block) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i last_control = _mm256_set1_epi8(' ' - 1);
+    TextBlockMasks masks;
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        const uint32_t spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)));
+        const uint32_t controls = static_cast<uint32_t>(_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, last_control), bytes)));
+        masks.spaces |= uint64_t{spaces} << i;
+        masks.controls |= uint64_t{controls} << i;
+    }
+    return masks;
+}
+
+bool SupportsAvx2() {
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    // AVX2 требует и поддержки процессора, и сохранения ОС регистров ymm
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+    if (!osxsave || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+} // namespace
+
+vector<TextScanner> GetSupportedTextScanners() {
+    vector<TextScanner> scanners = {{"scalar", ScanTextBlockScalar}};
+#if defined(SEARCH_SERVER_X86)
+    // SSE2 есть на любом x86-64
+    scanners.push_back({"sse2", ScanTextBlockSse2});
+    if (SupportsAvx2()) {
+        scanners.push_back({"avx2", ScanTextBlockAvx2});
+    }
+#endif
+    return scanners;
+}
+
+const TextScanner& GetTextScanner() {
+    static const TextScanner scanner = GetSupportedTextScanners().back();
+    return scanner;
+}
@@ -0,0 +1,182 @@
+#include "term_dictionary.h"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+TermDictionary::TermDictionary()
+    : arena_(make_shared<Arena>()), slots_(MakeSlots(INITIAL_SLOT_COUNT)), slot_count_(INITIAL_SLOT_COUNT) {}
+
+TermDictionary::TermDictionary(const vector<string_view> &words, shared_ptr<const void> storage)
+    : TermDictionary() {
+    arena_->storage = move(storage);
+    // таблица сразу заводится нужного размера, чтобы не перераскладывать слова
+    while ((words.size() + 1) * 2 > slot_count_) {
+        slot_count_ *= 2;
+    }
+    slots_ = MakeSlots(slot_count_);
+    for (const string_view word : words) {
+        const uint32_t hash = Hash(word);
+        uint32_t term_id = NO_TERM;
+        const size_t slot = FindSlot(slots_.get(), slot_count_, words_.begin(), words_.size(), word, hash, term_id);
+        if (term_id != NO_TERM) {
+            throw invalid_argument("Dictionary words must be unique"s);
+        }
+        slots_.get()[slot].store(uint64_t{hash} << 32 | words_.size(), memory_order_relaxed);
+        words_.push_back(word);
+    }
+}
+
+TermDictionary::TermDictionary(const TermDictionary &other) : TermDictionary() {
+    // переносим слова в собственную арену в том же порядке, чтобы id слов не поменялись
+    for (string_view word : other.words_) {
+        Intern(word);
+    }
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary &other) {
+    if (this != &other) {
+        TermDictionary copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+uint32_t TermDictionary::Intern(string_view word) {
+    const uint32_t hash = Hash(word);
+    uint32_t term_id = NO_TERM;
+    size_t slot = FindSlot(slots_.get(), slot_count_, words_.begin(), words_.size(), word, hash, term_id);
+    if (term_id != NO_TERM) {
+        return term_id;
+    }
+    // держим заполненность таблицы не выше 1/2, чтобы цепочки проб оставались короткими
+    if ((words_.size() + 1) * 2 > slot_count_) {
+        Grow();
+        slot = FindSlot(slots_.get(), slot_count_, words_.begin(), words_.size(), word, hash, term_id);
+    }
+    term_id = static_cast<uint32_t>(words_.size());
+    words_.push_back(StoreWord(word));
+    slots_.get()[slot].store(uint64_t{hash} << 32 | term_id, memory_order_relaxed);
+    return term_id;
+}
+
+uint32_t TermDictionary::Find(string_view word) const {
+    uint32_t term_id = NO_TERM;
+    FindSlot(slots_.get(), slot_count_, words_.begin(), words_.size(), word, Hash(word), term_id);
+    return term_id;
+}
+
+string_view TermDictionary::GetWord(uint32_t term_id) const {
+    return words_[term_id];
+}
+
+size_t TermDictionary::size() const {
+    return words_.size();
+}
+
+TermDictionary::View TermDictionary::GetView() const {
+    View view;
+    view.arena_ = arena_;
+    view.words_ = words_.GetBuffer();
+    view.size_ = words_.size();
+    view.slots_ = slots_;
+    view.slot_count_ = slot_count_;
+    return view;
+}
+
+uint32_t TermDictionary::View::Find(string_view word) const {
+    uint32_t term_id = NO_TERM;
+    FindSlot(slots_.get(), slot_count_, words_.get(), size_, word, Hash(word), term_id);
+    return term_id;
+}
+
+string_view TermDictionary::View::GetWord(uint32_t term_id) const {
+    return words_[term_id];
+}
+
+size_t TermDictionary::View::size() const {
+    return size_;
+}
+
+uint32_t TermDictionary::Hash(string_view word) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char c : word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+string_view TermDictionary::StoreWord(string_view word) {
+    if (word.empty()) {
+        return {};
+    }
+    auto &chunks = arena_->chunks;
+    if (word.size() > chunk_free_) {
+        // длинные слова кладём в отдельный блок перед текущим, чтобы не терять остаток текущего блока
+        if (word.size() > ARENA_CHUNK_SIZE / 4) {
+            auto chunk = make_unique<char[]>(word.size());
+            char *data = chunk.get();
+            memcpy(data, word.data(), word.size());
+            chunks.insert(chunks.empty() ? chunks.end() : prev(chunks.end()), move(chunk));
+            return {data, word.size()};
+        }
+        chunks.push_back(make_unique<char[]>(ARENA_CHUNK_SIZE));
+        chunk_free_ = ARENA_CHUNK_SIZE;
+    }
+    char *data = chunks.back().get() + (ARENA_CHUNK_SIZE - chunk_free_);
+    memcpy(data, word.data(), word.size());
+    chunk_free_ -= word.size();
+    return {data, word.size()};
+}
+
+size_t TermDictionary::FindSlot(const atomic<uint64_t> *slots, size_t slot_count, const string_view *words,
+                                size_t word_count, string_view word, uint32_t hash, uint32_t &term_id) {
+    const size_t mask = slot_count - 1;
+    size_t slot = hash & mask;
+    // линейное пробирование: соседние ячейки лежат в одной кэш-линии. Слова добавляются только в пустые
+    // ячейки, поэтому слова, добавленные после получения View, на путь к его словам не попадают
+    for (;; slot = (slot + 1) & mask) {
+        const uint64_t value = slots[slot].load(memory_order_relaxed);
+        const uint32_t id = static_cast<uint32_t>(value);
+        if (id == NO_TERM) {
+            term_id = NO_TERM;
+            return slot;
+        }
+        if (static_cast<uint32_t>(value >> 32) == hash && id < word_count && words[id] == word) {
+            term_id = id;
+            return slot;
+        }
+    }
+}
+
+TermDictionary::Slots TermDictionary::MakeSlots(size_t slot_count) {
+    Slots slots(new atomic<uint64_t>[slot_count]);
+    for (size_t i = 0; i < slot_count; ++i) {
+        slots.get()[i].store(EMPTY_SLOT, memory_order_relaxed);
+    }
+    return slots;
+}
+
+void TermDictionary::Grow() {
+    const size_t slot_count = slot_count_ * 2;
+    Slots slots = MakeSlots(slot_count);
+    const size_t mask = slot_count - 1;
+    for (size_t old_slot = 0; old_slot < slot_count_; ++old_slot) {
+        const uint64_t value = slots_.get()[old_slot].load(memory_order_relaxed);
+        if (value == EMPTY_SLOT) {
+            continue;
+        }
+        size_t slot = (value >> 32) & mask;
+        while (slots.get()[slot].load(memory_order_relaxed) != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        slots.get()[slot].store(value, memory_order_relaxed);
+    }
+    slots_ = move(slots);
+    slot_count_ = slot_count;
+}
@@ -1,6 +1,8 @@
 #include "log_duration.h"
+#include "posting_list.h"
 #include "test_example_functions.h"
 
+#include <map>
 #include <vector>
 
 
@@ -119,6 +121,67 @@ void ProfileRemoveDocument() {
 }
 
 
+void ProfilePostingLists() {
+    mt19937 generator;
+    // индекс как в FindTopDocuments-тесте: 10000 документов по 70 слов из словаря в 1000 слов
+    const int document_count = 10'000;
+    const int word_count = 70;
+    const int dictionary_size = 1000;
+    vector<map<int, double>> map_index(dictionary_size);
+    vector<PostingList> posting_index(dictionary_size);
+    size_t postings = 0;
+    for (int document = 0; document < document_count; ++document) {
+        map<int, uint32_t> counts;
+        for (int i = 0; i < word_count; ++i) {
+            ++counts[uniform_int_distribution<int>(0, dictionary_size - 1)(generator)];
+        }
+        for (const auto& [term, count] : counts) {
+            map_index[static_cast<size_t>(term)][document] = count / static_cast<double>(word_count);
+            posting_index[static_cast<size_t>(term)].Append(static_cast<uint32_t>(document), count, word_count);
+            ++postings;
+        }
+    }
+
+    // узел красно-чёрного дерева: три указателя, цвет и значение
+    const size_t map_node_size = 3 * sizeof(void*) + sizeof(void*) + sizeof(pair<const int, double>);
+    size_t map_memory = 0;
+    size_t posting_memory = 0;
+    for (size_t term = 0; term < map_index.size(); ++term) {
+        map_memory += sizeof(map<int, double>) + map_index[term].size() * map_node_size;
+        posting_memory += posting_index[term].MemoryUsage();
+    }
+    cout << "Postings: "s << postings << endl;
+    cout << "map index memory: "s << map_memory << " bytes ("s
+         << static_cast<double>(map_memory) / static_cast<double>(postings) << " per posting)"s << endl;
+    cout << "PostingList index memory: "s << posting_memory << " bytes ("s
+         << static_cast<double>(posting_memory) / static_cast<double>(postings) << " per posting)"s << endl;
+
+    const int scan_count = 20;
+    {
+        LOG_DURATION("map index scan"s);
+        double total = 0;
+        for (int i = 0; i < scan_count; ++i) {
+            for (const auto &record : map_index) {
+                for (const auto& [document, term_freq] : record) {
+                    total += term_freq;
+                }
+            }
+        }
+        cout << total << endl;
+    }
+    {
+        LOG_DURATION("PostingList index scan"s);
+        double total = 0;
+        for (int i = 0; i < scan_count; ++i) {
+            for (const auto &record : posting_index) {
+                record.ForEach([&total](uint32_t, uint32_t count, uint32_t) {
+                    total += count / static_cast<double>(word_count);
+                });
+            }
+        }
+        cout << total << endl;
+    }
+}
 
 string GenerateWord(std::mt19937 &generator, int max_length) {
     const int length = std::uniform_int_distribution(1, max_length)(generator);
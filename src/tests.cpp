@@ -1,12 +1,16 @@
+#include "allocation_counter.h"
 #include "log_duration.h"
 #include "process_queries.h"
 #include "search_server.h"
 #include "search_server_tests.h"
 #include "test_example_functions.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <execution>
 #include <iostream>
 #include <random>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -14,17 +18,26 @@ using namespace std;
 
 
 template <typename ExecutionPolicy>
-void TestMatch(string_view mark, SearchServer search_server, const string& query, ExecutionPolicy&& policy) {
+void TestMatch(string_view mark, const SearchServer::Snapshot& snapshot, const string& query, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
-    const int document_count = search_server.GetDocumentCount();
+    const int document_count = snapshot.GetDocumentCount();
     int word_count = 0;
     for (int id = 0; id < document_count; ++id) {
-        const auto [words, status] = search_server.MatchDocument(policy, query, id);
+        const auto [words, status] = snapshot.MatchDocument(policy, query, id);
         word_count += static_cast<int>(words.size());
     }
     cout << word_count << endl;
 }
-#define TEST_MATCH(policy) TestMatch(#policy, search_server, query, execution::policy)
+#define TEST_MATCH(policy) TestMatch(#policy, search_server.GetSnapshot(), query, execution::policy)
+
+template <typename ExecutionPolicy>
+void TestMatchAll(string_view mark, const SearchServer::Snapshot& snapshot, const string& query,
+                  ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    const MatchResults results = snapshot.MatchAllDocuments(policy, query);
+    cout << results.words.size() << endl;
+}
+#define TEST_MATCH_ALL(policy) TestMatchAll("MatchAllDocuments "s + #policy, search_server.GetSnapshot(), query, policy)
 
 template <typename ExecutionPolicy>
 void TestRemove(string_view mark, SearchServer search_server, ExecutionPolicy&& policy) {
@@ -33,6 +46,7 @@ void TestRemove(string_view mark, SearchServer search_server, ExecutionPolicy&&
     for (int id = 0; id < document_count; ++id) {
         search_server.RemoveDocument(policy, id);
     }
+    search_server.Compact();
     cout << search_server.GetDocumentCount() << endl;
 }
 #define TEST_REMOVE(policy) TestRemove(#policy, search_server, execution::policy)
@@ -58,6 +72,21 @@ void TestFindTopDocuments(string_view mark, const SearchServer& search_server, c
 }
 #define TEST_FTD(policy) TestFindTopDocuments(#policy, search_server, queries, execution::policy)
 
+template <typename ExecutionPolicy>
+void TestAddDocuments(string_view mark, const string& stop_words, const vector<string>& documents,
+                      ExecutionPolicy&& policy) {
+    vector<DocumentInput> batch;
+    batch.reserve(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    LOG_DURATION(mark);
+    SearchServer search_server(stop_words);
+    search_server.AddDocuments(policy, batch);
+    cout << search_server.GetDocumentCount() << endl;
+}
+#define TEST_ADD(policy) TestAddDocuments(#policy, dictionary[0], documents, execution::policy)
+
 int main() {
     TestSearchServer ();
     cout << endl;
@@ -73,8 +102,32 @@ int main() {
         }
         const auto queries = GenerateQueries(generator, dictionary, 10'000, 7);
         cout << "Testing ProcessQueries speed: "s << endl;
+        // прежняя версия: каждый запрос ищется независимо
+        const auto independent = [](const SearchServer &server, const vector<string> &batch) {
+            vector<vector<Document>> result(batch.size());
+            transform(execution::par, batch.begin(), batch.end(), result.begin(), [&server](const string &query) {
+                return server.FindTopDocuments(query);
+            });
+            return result;
+        };
+        TEST_PQ(independent);
         TEST_PQ(ProcessQueries);
         TEST_PQ(ProcessQueriesJoined);
+        // выдачи обрабатываются по мере готовности и не собираются в общий результат
+        const auto streaming = [](const SearchServer &server, const vector<string> &batch) {
+            vector<size_t> counts;
+            ProcessQueriesStreaming(server, batch, [&counts](size_t, vector<Document> documents) {
+                counts.push_back(documents.size());
+            });
+            return counts;
+        };
+        TEST_PQ(streaming);
+    }
+    cout << endl;
+    // TestPostingLists
+    {
+        cout << "Testing posting lists memory and scan speed: "s << endl;
+        ProfilePostingLists();
     }
     cout << endl;
     // TestRemove
@@ -85,6 +138,7 @@ int main() {
         for (size_t i = 0; i < documents.size(); ++i) {
             search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
         }
+        search_server.WaitForMerges();
         cout << "Testing Remove speed: "s << endl;
         TEST_REMOVE(seq);
         TEST_REMOVE(par);
@@ -102,6 +156,9 @@ int main() {
         cout << "Testing Match speed: "s << endl;
         TEST_MATCH(seq);
         TEST_MATCH(par);
+        TEST_MATCH_ALL(execution::seq);
+        TEST_MATCH_ALL(execution::par);
+        TEST_MATCH_ALL(adaptive_execution);
     }
 
     cout << endl;
@@ -117,6 +174,293 @@ int main() {
             cout << "Testing FindTopDocuments speed: "s << endl;
             TEST_FTD(seq);
             TEST_FTD(par);
+            TestFindTopDocuments("adaptive"s, search_server, queries, adaptive_execution);
+            const QueryPlanner::Stats stats = search_server.GetQueryPlannerStats();
+            cout << "sequential: "s << stats.sequential_queries << ", parallel: "s << stats.parallel_queries << endl;
+    }
+
+    cout << endl;
+    // Test AddDocuments
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 100'000, 50);
+        cout << "Testing AddDocuments speed: "s << endl;
+        {
+            LOG_DURATION("one by one"s);
+            SearchServer search_server(dictionary[0]);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+            cout << search_server.GetDocumentCount() << endl;
+        }
+        TEST_ADD(seq);
+        TEST_ADD(par);
+    }
+
+    cout << endl;
+    // Test tokenizer
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 100'000, 100);
+        cout << "Testing tokenizer speed: "s << endl;
+        {
+            // прежний способ: поиск пробелов через find, вектор слов и отдельная проверка каждого байта слов
+            LOG_DURATION("find and validate"s);
+            size_t word_count = 0;
+            for (const string &document : documents) {
+                vector<string_view> words;
+                string_view text = document;
+                while (!text.empty()) {
+                    const size_t space = text.find(' ');
+                    if (space != 0) {
+                        words.push_back(text.substr(0, space));
+                    }
+                    text.remove_prefix(space == string_view::npos ? text.size() : space + 1);
+                }
+                for (const string_view word : words) {
+                    word_count += none_of(word.begin(), word.end(), [](char c) {
+                        return static_cast<unsigned char>(c) < ' ';
+                    });
+                }
+            }
+            cout << word_count << endl;
+        }
+        for (const TextScanner &scanner : GetSupportedTextScanners()) {
+            LOG_DURATION(scanner.name);
+            size_t word_count = 0;
+            for (const string &document : documents) {
+                ForEachWord(document, [&word_count](string_view) {
+                    ++word_count;
+                }, scanner);
+            }
+            cout << word_count << endl;
+        }
+    }
+
+    cout << endl;
+    // Test stop words
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 20'000, 100);
+        vector<string_view> stop_word_list;
+        for (size_t i = 0; i < dictionary.size(); i += 50) {
+            stop_word_list.push_back(dictionary[i]);
+        }
+        const set<string, less<>> tree(stop_word_list.begin(), stop_word_list.end());
+        const StopWordSet stop_words(stop_word_list);
+        cout << "Testing stop words lookup speed ("s << stop_words.size() << " stop words): "s << endl;
+        {
+            LOG_DURATION("set"s);
+            size_t found = 0;
+            for (const string &document : documents) {
+                ForEachWord(document, [&tree, &found](string_view word) {
+                    found += tree.count(word);
+                });
+            }
+            cout << found << endl;
+        }
+        {
+            LOG_DURATION("StopWordSet"s);
+            size_t found = 0;
+            for (const string &document : documents) {
+                ForEachWord(document, [&stop_words, &found](string_view word) {
+                    found += stop_words.Contains(word);
+                });
+            }
+            cout << found << endl;
+        }
+    }
+
+    cout << endl;
+    // Test AddDocument allocations: слова документов уже есть в словаре, поэтому кол-во выделений памяти
+    // на документ не должно зависеть от кол-ва его слов
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        string all_words;
+        for (const string &word : dictionary) {
+            all_words += word + ' ';
+        }
+        cout << "Testing AddDocument allocations with known words: "s << endl;
+        SearchServer search_server(dictionary[0]);
+        search_server.AddDocument(0, all_words);
+        int id = 1;
+        for (const int word_count : {50, 500}) {
+            const auto documents = GenerateQueries(generator, dictionary, 5'000, word_count);
+            const LogAllocations allocations(to_string(word_count) + " words per document"s);
+            for (const string &document : documents) {
+                search_server.AddDocument(id++, document, DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+            cout << static_cast<double>(allocations.Count()) / static_cast<double>(documents.size())
+                 << " allocations per document"s << endl;
+        }
+    }
+
+    cout << endl;
+    // Test query cache: поток повторяющихся запросов и MatchDocument одного запроса по всем документам
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+        const auto distinct_queries = GenerateQueries(generator, dictionary, 100, 7);
+        vector<string> queries;
+        for (size_t i = 0; i < 20'000; ++i) {
+            const size_t index = uniform_int_distribution<size_t>(0, distinct_queries.size() - 1)(generator);
+            queries.push_back(distinct_queries[index]);
+        }
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        search_server.WaitForMerges();
+        const string query = distinct_queries[0];
+        cout << "Testing query cache: "s << endl;
+        for (const size_t capacity : {size_t{0}, QUERY_CACHE_CAPACITY}) {
+            search_server.SetQueryCacheCapacity(capacity);
+            const string mark = capacity == 0 ? "without cache"s : "with cache"s;
+            TestFindTopDocuments(mark + " FindTopDocuments"s, search_server, queries, execution::seq);
+            TestMatch(mark + " MatchDocument"s, search_server.GetSnapshot(), query, execution::seq);
+        }
+        const QueryCache::Stats stats = search_server.GetQueryCacheStats();
+        cout << "hits: "s << stats.hits << ", misses: "s << stats.misses << endl;
+    }
+
+    cout << endl;
+    // Test result cache: частые запросы повторяются, а редкие встречаются по разу и не должны вытеснять частые
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 50'000, 50);
+        const auto head_queries = GenerateQueries(generator, dictionary, 200, 5);
+        const auto tail_queries = GenerateQueries(generator, dictionary, 10'000, 5);
+        vector<string> queries;
+        for (size_t i = 0; i < 20'000; ++i) {
+            if (i % 2 == 0) {
+                queries.push_back(tail_queries[i / 2]);
+            } else {
+                const size_t index = uniform_int_distribution<size_t>(0, head_queries.size() - 1)(generator);
+                queries.push_back(head_queries[index]);
+            }
+        }
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        search_server.WaitForMerges();
+        // запросы приходят пакетами, кэш выдачи переиспользует выдачи предыдущих пакетов
+        const auto process_batches = [](const SearchServer &server, const vector<string> &all_queries) {
+            vector<vector<Document>> result;
+            for (size_t begin = 0; begin < all_queries.size(); begin += 1000) {
+                const vector<string> batch(all_queries.begin() + static_cast<ptrdiff_t>(begin),
+                                           all_queries.begin() + static_cast<ptrdiff_t>(min(begin + 1000,
+                                                                                            all_queries.size())));
+                for (auto &documents : ProcessQueries(server, batch)) {
+                    result.push_back(move(documents));
+                }
+            }
+            return result;
+        };
+        cout << "Testing result cache: "s << endl;
+        TestProcessQueries("without cache"s, process_batches, search_server, queries);
+        search_server.SetResultCacheCapacity(1 << 20);
+        TestProcessQueries("with cache"s, process_batches, search_server, queries);
+        const ResultCache::Stats stats = search_server.GetResultCacheStats();
+        cout << "hits: "s << stats.hits << ", misses: "s << stats.misses << ", evictions: "s << stats.evictions
+             << ", rejections: "s << stats.rejections << endl;
+    }
+
+    cout << endl;
+    // Test FindTopDocuments allocations: после первого запроса потока временные буферы запроса берутся
+    // из его пула, разбор повторного запроса - из кэша, и в памяти выделяется только выдача
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 50'000, 50);
+        const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        search_server.WaitForMerges();
+        cout << "Testing FindTopDocuments allocations: "s << endl;
+        for (const string &query : queries) {
+            search_server.FindTopDocuments(query);
+            search_server.FindTopDocuments(execution::par, query);
+        }
+        for (const bool parallel : {false, true}) {
+            const LogAllocations allocations(parallel ? "par"s : "seq"s);
+            for (const string &query : queries) {
+                if (parallel) {
+                    search_server.FindTopDocuments(execution::par, query);
+                } else {
+                    search_server.FindTopDocuments(query);
+                }
+            }
+            cout << static_cast<double>(allocations.Count()) / static_cast<double>(queries.size())
+                 << " allocations per query"s << endl;
+        }
+    }
+
+    cout << endl;
+    // Test OpenIndex
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 100'000, 50);
+        const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+        vector<DocumentInput> batch;
+        batch.reserve(documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        const string path = "search_server_benchmark_index.bin"s;
+        cout << "Testing OpenIndex speed: "s << endl;
+        {
+            LOG_DURATION("build and save"s);
+            SearchServer search_server(dictionary[0]);
+            search_server.AddDocuments(execution::par, batch);
+            search_server.WaitForMerges();
+            search_server.SaveIndex(path);
+        }
+        {
+            LOG_DURATION("open"s);
+            const SearchServer search_server = SearchServer::OpenIndex(path);
+            cout << search_server.GetDocumentCount() << endl;
+        }
+        {
+            LOG_DURATION("open and search"s);
+            const SearchServer search_server = SearchServer::OpenIndex(path);
+            TEST_FTD(seq);
+        }
+        remove(path.c_str());
+    }
+
+    cout << endl;
+    // Test write-ahead log
+    {
+        const auto dictionary = GenerateDictionary(generator, 10000, 25);
+        const auto documents = GenerateQueries(generator, dictionary, 2'000, 50);
+        const string path = "search_server_benchmark_log.bin"s;
+        // group commit size 1 - fsync на каждый документ, 0 - только при закрытии журнала
+        cout << "Testing AddDocument speed with write-ahead log: "s << endl;
+        {
+            LOG_DURATION("no log"s);
+            SearchServer search_server(dictionary[0]);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+        }
+        for (const size_t group_commit_size : {size_t{1}, size_t{64}, size_t{0}}) {
+            remove(path.c_str());
+            LOG_DURATION("group commit size "s + to_string(group_commit_size));
+            SearchServer search_server(dictionary[0]);
+            search_server.AttachLog(path, LogOptions{group_commit_size});
+            for (size_t i = 0; i < documents.size(); ++i) {
+                search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+        }
+        {
+            LOG_DURATION("replay"s);
+            SearchServer search_server(dictionary[0]);
+            search_server.AttachLog(path);
+            cout << search_server.GetDocumentCount() << endl;
+        }
+        remove(path.c_str());
     }
 
     return 0;
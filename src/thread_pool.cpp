@@ -0,0 +1,240 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+// задача, поделённая на части, и её части в очередях
+struct ThreadPool::Storage {
+    // задача живёт в стеке вызвавшего Run потока, пока не выполнены все её части
+    struct Job {
+        void (*invoke)(void*, size_t, size_t);
+        void *context;
+        atomic<size_t> remaining; // кол-во невыполненных частей
+        mutex error_mutex;
+        exception_ptr error; // первое исключение частей
+    };
+    struct Task {
+        Job *job;
+        size_t begin;
+        size_t end;
+    };
+    struct Queue {
+        mutex tasks_mutex;
+        deque<Task> tasks;
+    };
+
+    ThreadPoolOptions options;
+    size_t parallelism = 1;
+    // очереди рабочих потоков и последняя общая очередь для частей задач внешних потоков
+    vector<Queue> queues;
+    vector<thread> threads;
+    once_flag start;
+    mutex wake_mutex;
+    condition_variable wake; // появились части в очередях или выполнена последняя часть задачи
+    atomic<size_t> queued{0}; // кол-во частей в очередях
+    bool stop = false;
+
+    explicit Storage(const ThreadPoolOptions &pool_options);
+    ~Storage();
+
+    // запускает рабочие потоки
+    void Start();
+    void Work(size_t queue);
+    // выполняет часть из своей очереди или из чужой; false, если частей нет
+    bool TryRunTask(size_t queue);
+    void RunTask(const Task &task);
+    void Notify();
+};
+
+namespace {
+
+// пул и очередь рабочего потока, в котором выполняется код; у внешних потоков пула нет
+thread_local const void *current_storage = nullptr;
+thread_local size_t current_queue = 0;
+
+} // namespace
+
+ThreadPool::Storage::Storage(const ThreadPoolOptions &pool_options)
+    : options(pool_options), queues(pool_options.thread_count + 1) {
+    parallelism = options.thread_count + 1;
+    if (options.max_parallelism != 0) {
+        parallelism = min(parallelism, options.max_parallelism);
+    }
+}
+
+ThreadPool::Storage::~Storage() {
+    {
+        const lock_guard lock(wake_mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (thread &worker : threads) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Storage::Start() {
+    threads.reserve(options.thread_count);
+    for (size_t i = 0; i < options.thread_count; ++i) {
+        threads.emplace_back([this, i] {
+            Work(i);
+        });
+#ifdef __linux__
+        if (options.pin_threads) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % max(1u, thread::hardware_concurrency()), &cpus);
+            pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpus), &cpus);
+        }
+#endif
+    }
+}
+
+void ThreadPool::Storage::Work(size_t queue) {
+    current_storage = this;
+    current_queue = queue;
+    while (true) {
+        if (TryRunTask(queue)) {
+            continue;
+        }
+        unique_lock lock(wake_mutex);
+        wake.wait(lock, [this] {
+            return stop || queued.load() != 0;
+        });
+        if (stop) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::Storage::TryRunTask(size_t queue) {
+    if (queued.load() == 0) {
+        return false;
+    }
+    // свою очередь разбираем с конца, где лежат последние и потому ещё горячие в кэше части,
+    // чужие - с начала, где лежат самые крупные из оставшихся
+    for (size_t i = 0; i < queues.size(); ++i) {
+        Queue &victim = queues[(queue + i) % queues.size()];
+        unique_lock lock(victim.tasks_mutex);
+        if (victim.tasks.empty()) {
+            continue;
+        }
+        Task task;
+        if (i == 0) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+        } else {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+        }
+        queued.fetch_sub(1);
+        lock.unlock();
+        RunTask(task);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::Storage::RunTask(const Task &task) {
+    Job &job = *task.job;
+    try {
+        job.invoke(job.context, task.begin, task.end);
+    } catch (...) {
+        const lock_guard lock(job.error_mutex);
+        if (!job.error) {
+            job.error = current_exception();
+        }
+    }
+    // после последней части задача может быть сразу разрушена, поэтому к ней больше не обращаемся
+    if (job.remaining.fetch_sub(1) == 1) {
+        Notify();
+    }
+}
+
+void ThreadPool::Storage::Notify() {
+    // блокировка не даёт уведомлению проскочить между проверкой условия ждущим потоком и его засыпанием
+    {
+        const lock_guard lock(wake_mutex);
+    }
+    wake.notify_all();
+}
+
+ThreadPool::ThreadPool(ThreadPoolOptions options) : options_(options) {
+    view_.storage_ = make_shared<Storage>(options_);
+}
+
+ThreadPool::ThreadPool(const ThreadPool &other) : ThreadPool(other.options_) {}
+
+ThreadPool& ThreadPool::operator=(const ThreadPool &other) {
+    if (this != &other) {
+        ThreadPool copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+const ThreadPoolOptions& ThreadPool::GetOptions() const {
+    return options_;
+}
+
+const ThreadPool::View& ThreadPool::GetView() const {
+    return view_;
+}
+
+size_t ThreadPool::View::GetParallelism() const {
+    return storage_ == nullptr ? 1 : storage_->parallelism;
+}
+
+void ThreadPool::View::Run(size_t count, size_t part_count, void (*invoke)(void*, size_t, size_t),
+                           void *context) const {
+    if (storage_ == nullptr || storage_->options.thread_count == 0 || part_count <= 1) {
+        invoke(context, 0, count);
+        return;
+    }
+    Storage &storage = *storage_;
+    call_once(storage.start, [&storage] {
+        storage.Start();
+    });
+    // части кладутся в очередь рабочего потока, если Run вызван из него, иначе в общую
+    const size_t queue = current_storage == &storage ? current_queue : storage.queues.size() - 1;
+    Storage::Job job{invoke, context, {part_count}, {}, nullptr};
+    const auto part_begin = [count, part_count](size_t part) {
+        return count / part_count * part + min(part, count % part_count);
+    };
+    {
+        Storage::Queue &own = storage.queues[queue];
+        const lock_guard lock(own.tasks_mutex);
+        for (size_t part = part_count - 1; part > 0; --part) {
+            own.tasks.push_back(Storage::Task{&job, part_begin(part), part_begin(part + 1)});
+        }
+        // счётчик растёт только вместе с частями в очереди, иначе проснувшийся поток не найдёт частей
+        // и будет крутиться, пока их не положат
+        storage.queued.fetch_add(part_count - 1);
+    }
+    storage.Notify();
+
+    // первую часть выполняем сами, а затем, пока задача не выполнена, помогаем с любыми частями
+    storage.RunTask(Storage::Task{&job, 0, part_begin(1)});
+    while (job.remaining.load() != 0) {
+        if (!storage.TryRunTask(queue)) {
+            unique_lock lock(storage.wake_mutex);
+            storage.wake.wait(lock, [&storage, &job] {
+                return job.remaining.load() == 0 || storage.queued.load() != 0;
+            });
+        }
+    }
+    if (job.error) {
+        rethrow_exception(job.error);
+    }
+}
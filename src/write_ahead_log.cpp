@@ -0,0 +1,350 @@
+#include "write_ahead_log.h"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const char LOG_FILE_MAGIC[8] = {'S', 'R', 'V', 'L', 'O', 'G', '\0', '\0'};
+const uint32_t LOG_FORMAT_VERSION = 1;
+
+// заголовок в начале файла журнала
+struct LogHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t reserved;
+};
+
+// заголовок записи: за ним payload_size байт записи, по которым считается checksum
+struct RecordHeader {
+    uint32_t payload_size;
+    uint32_t checksum;
+};
+
+// дописывает значение в буфер записи
+template <typename T>
+void PutValue(vector<char> &buffer, const T &value) {
+    const size_t size = buffer.size();
+    buffer.resize(size + sizeof(T));
+    memcpy(buffer.data() + size, &value, sizeof(T));
+}
+
+// читает значение из записи, сдвигая position; false, если запись кончилась
+template <typename T>
+bool GetValue(const vector<char> &buffer, size_t &position, T &value) {
+    if (buffer.size() - position < sizeof(T)) {
+        return false;
+    }
+    memcpy(&value, buffer.data() + position, sizeof(T));
+    position += sizeof(T);
+    return true;
+}
+
+// разбирает запись журнала; false, если запись некорректна
+bool DecodeRecord(const vector<char> &buffer, LogRecord &record) {
+    size_t position = 0;
+    uint32_t type = 0;
+    if (!GetValue(buffer, position, record.sequence) || !GetValue(buffer, position, type)) {
+        return false;
+    }
+    record.type = static_cast<LogRecord::Type>(type);
+    switch (record.type) {
+    case LogRecord::Type::ADD_DOCUMENT: {
+        int32_t status = 0;
+        uint32_t rating_count = 0;
+        uint32_t text_size = 0;
+        if (!GetValue(buffer, position, record.document_id) || !GetValue(buffer, position, status) ||
+            !GetValue(buffer, position, rating_count) ||
+            rating_count > (buffer.size() - position) / sizeof(int) ||
+            status < static_cast<int32_t>(DocumentStatus::ACTUAL) ||
+            status > static_cast<int32_t>(DocumentStatus::REMOVED)) {
+            return false;
+        }
+        record.status = static_cast<DocumentStatus>(status);
+        record.ratings.resize(rating_count);
+        for (int &rating : record.ratings) {
+            GetValue(buffer, position, rating);
+        }
+        if (!GetValue(buffer, position, text_size) || text_size != buffer.size() - position) {
+            return false;
+        }
+        record.text.assign(buffer.data() + position, text_size);
+        return true;
+    }
+    case LogRecord::Type::REMOVE_DOCUMENT:
+        return GetValue(buffer, position, record.document_id) && position == buffer.size();
+    case LogRecord::Type::SET_SEGMENT_DOCUMENT_COUNT:
+        return GetValue(buffer, position, record.value) && position == buffer.size();
+    }
+    return false;
+}
+
+// сбрасывает записанные в файл данные на диск
+bool SyncFile(FILE *file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+#if defined(_WIN32)
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// создаёт пустой журнал из одного заголовка
+FILE* CreateLog(const string &path) {
+    FILE *const file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+    LogHeader header{};
+    memcpy(header.magic, LOG_FILE_MAGIC, sizeof(header.magic));
+    header.format_version = LOG_FORMAT_VERSION;
+    if (fwrite(&header, sizeof(header), 1, file) != 1 || !SyncFile(file)) {
+        fclose(file);
+        return nullptr;
+    }
+    return file;
+}
+
+} // namespace
+
+uint32_t ComputeCrc32c(const void *data, size_t size, uint32_t crc) {
+    static const array<uint32_t, 256> table = [] {
+        array<uint32_t, 256> result{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value >> 1) ^ ((value & 1) != 0 ? 0x82F63B78u : 0);
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+WriteAheadLog::WriteAheadLog(const WriteAheadLog &) {}
+
+WriteAheadLog::WriteAheadLog(WriteAheadLog &&other) noexcept
+    : path_(move(other.path_)), file_(exchange(other.file_, nullptr)), options_(other.options_),
+      unsynced_(exchange(other.unsynced_, 0)), size_(exchange(other.size_, 0)),
+      broken_(exchange(other.broken_, false)) {}
+
+WriteAheadLog& WriteAheadLog::operator=(const WriteAheadLog &other) {
+    // состояние, которому соответствовал журнал, заменяется, поэтому журнал закрывается
+    if (this != &other) {
+        Close();
+    }
+    return *this;
+}
+
+WriteAheadLog& WriteAheadLog::operator=(WriteAheadLog &&other) {
+    if (this != &other) {
+        Close();
+        path_ = move(other.path_);
+        file_ = exchange(other.file_, nullptr);
+        options_ = other.options_;
+        unsynced_ = exchange(other.unsynced_, 0);
+        size_ = exchange(other.size_, 0);
+        broken_ = exchange(other.broken_, false);
+    }
+    return *this;
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    try {
+        Close();
+    } catch (...) {
+        // ошибку сброса на диск из деструктора не сообщить; записи уже переданы ОС
+    }
+}
+
+void WriteAheadLog::Open(const string &path, LogOptions options,
+                         const function<void(const LogRecord &record)> &replay) {
+    Close();
+    path_ = path;
+    options_ = options;
+    // журнал короче заголовка мог остаться от сбоя при создании или очистке, он считается пустым
+    error_code error;
+    const uintmax_t file_size = filesystem::file_size(path, error);
+    if (error || file_size < sizeof(LogHeader)) {
+        file_ = CreateLog(path);
+        Check(file_ != nullptr);
+        size_ = sizeof(LogHeader);
+        return;
+    }
+
+    ifstream in(path, ios::binary);
+    LogHeader header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || memcmp(header.magic, LOG_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.format_version != LOG_FORMAT_VERSION) {
+        throw runtime_error("Not a log file: "s + path);
+    }
+    // проигрываем записи до конца файла или до первой оборванной или повреждённой записи
+    uintmax_t valid_end = sizeof(LogHeader);
+    uint64_t last_sequence = 0;
+    vector<char> payload;
+    LogRecord record;
+    for (RecordHeader record_header{};
+         in.read(reinterpret_cast<char*>(&record_header), sizeof(record_header));) {
+        if (record_header.payload_size > file_size - valid_end - sizeof(record_header)) {
+            break;
+        }
+        payload.resize(record_header.payload_size);
+        if (!in.read(payload.data(), static_cast<streamsize>(payload.size())) ||
+            ComputeCrc32c(payload.data(), payload.size()) != record_header.checksum ||
+            !DecodeRecord(payload, record) || record.sequence <= last_sequence) {
+            break;
+        }
+        replay(record);
+        last_sequence = record.sequence;
+        valid_end += sizeof(record_header) + payload.size();
+    }
+    in.close();
+    if (valid_end < file_size) {
+        filesystem::resize_file(path, valid_end);
+    }
+    file_ = fopen(path.c_str(), "ab");
+    Check(file_ != nullptr);
+    size_ = valid_end;
+}
+
+bool WriteAheadLog::IsOpen() const {
+    return file_ != nullptr || broken_;
+}
+
+void WriteAheadLog::Append(const LogRecord &record) {
+    Append(vector<LogRecord>{record});
+}
+
+void WriteAheadLog::Append(const vector<LogRecord> &records) {
+    Check(!broken_);
+    const uint64_t size = size_;
+    try {
+        for (const LogRecord &record : records) {
+            WriteRecord(record);
+        }
+        Commit(records.size());
+    } catch (...) {
+        size_ = size;
+        Rollback();
+        throw;
+    }
+}
+
+void WriteAheadLog::WriteRecord(const LogRecord &record) {
+    buffer_.clear();
+    PutValue(buffer_, record.sequence);
+    PutValue(buffer_, static_cast<uint32_t>(record.type));
+    switch (record.type) {
+    case LogRecord::Type::ADD_DOCUMENT:
+        PutValue(buffer_, record.document_id);
+        PutValue(buffer_, static_cast<int32_t>(record.status));
+        PutValue(buffer_, static_cast<uint32_t>(record.ratings.size()));
+        for (const int rating : record.ratings) {
+            PutValue(buffer_, rating);
+        }
+        PutValue(buffer_, static_cast<uint32_t>(record.text.size()));
+        buffer_.insert(buffer_.end(), record.text.begin(), record.text.end());
+        break;
+    case LogRecord::Type::REMOVE_DOCUMENT:
+        PutValue(buffer_, record.document_id);
+        break;
+    case LogRecord::Type::SET_SEGMENT_DOCUMENT_COUNT:
+        PutValue(buffer_, record.value);
+        break;
+    }
+    const RecordHeader header{static_cast<uint32_t>(buffer_.size()), ComputeCrc32c(buffer_.data(), buffer_.size())};
+    WriteBytes(&header, sizeof(header));
+    WriteBytes(buffer_.data(), buffer_.size());
+    size_ += sizeof(header) + buffer_.size();
+}
+
+void WriteAheadLog::Commit(size_t count) {
+    // записи отдаются ОС сразу, а fsync выполняется на группу записей
+    Check(fflush(file_) == 0);
+    unsynced_ += count;
+    if (options_.group_commit_size != 0 && unsynced_ >= options_.group_commit_size) {
+        Sync();
+    }
+}
+
+void WriteAheadLog::Rollback() {
+    // записи пакета, которые уже успели попасть в файл, отбрасываются вместе с оборванной: иначе следующие
+    // записи легли бы после неё и пропали бы при проигрывании. Буфер файла закрытие допишет или отбросит,
+    // а лишнее срезает обрезка
+    fclose(file_);
+    file_ = nullptr;
+    error_code error;
+    filesystem::resize_file(path_, size_, error);
+    if (!error) {
+        file_ = fopen(path_.c_str(), "ab");
+    }
+    broken_ = file_ == nullptr;
+}
+
+void WriteAheadLog::Sync() {
+    Check(!broken_);
+    if (file_ == nullptr) {
+        return;
+    }
+    Check(SyncFile(file_));
+    unsynced_ = 0;
+}
+
+void WriteAheadLog::Reset() {
+    // очистка заново создаёт и файл, который не удалось обрезать после неудачной записи
+    if (file_ == nullptr && !broken_) {
+        return;
+    }
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+    file_ = CreateLog(path_);
+    unsynced_ = 0;
+    size_ = sizeof(LogHeader);
+    broken_ = file_ == nullptr;
+    Check(file_ != nullptr);
+}
+
+void WriteAheadLog::Close() {
+    broken_ = false;
+    if (file_ == nullptr) {
+        return;
+    }
+    FILE *const file = file_;
+    file_ = nullptr;
+    const bool synced = SyncFile(file);
+    fclose(file);
+    unsynced_ = 0;
+    Check(synced);
+}
+
+void WriteAheadLog::WriteBytes(const void *data, size_t size) {
+    Check(size == 0 || fwrite(data, size, 1, file_) == 1);
+}
+
+void WriteAheadLog::Check(bool condition) const {
+    if (!condition) {
+        throw runtime_error("Can't write log file "s + path_);
+    }
+}